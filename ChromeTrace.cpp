@@ -0,0 +1,414 @@
+#include "ChromeTrace.h"
+
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+
+// Chrome timestamps are microseconds, native logs count nanoseconds.
+static constexpr uint64_t TICKS_PER_US = 1000;
+
+namespace {
+
+// The tokenizer never builds values: it walks the text with memchr, which
+// is vectorized, and only decodes the few fields an event needs.
+struct Reader {
+    const char * p;
+    const char * end;
+    bool failed = false;
+
+    void skip_ws() {
+        while (p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) {
+            ++p;
+        }
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (p < end && *p == c) {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+
+    // p at the opening quote; returns the raw contents, escapes included
+    std::string_view string() {
+        const char * begin = ++p;
+        for (;;) {
+            const char * quote = (const char *) memchr(p, '"', end - p);
+            if (quote == nullptr) {
+                failed = true;
+                p = end;
+                return {};
+            }
+            // escaped if preceded by an odd number of backslashes
+            const char * q = quote;
+            while (q > begin && q[-1] == '\\') {
+                --q;
+            }
+            p = quote + 1;
+            if ((quote - q) % 2 == 0) {
+                return std::string_view(begin, quote - begin);
+            }
+        }
+    }
+
+    void skip_value() {
+        skip_ws();
+        if (p >= end) {
+            failed = true;
+            return;
+        }
+        if (*p == '"') {
+            string();
+            return;
+        }
+        if (*p != '{' && *p != '[') {
+            // number, true, false or null
+            while (p < end && *p != ',' && *p != '}' && *p != ']') {
+                ++p;
+            }
+            return;
+        }
+        int depth = 0;
+        while (p < end) {
+            const char c = *p;
+            if (c == '"') {
+                string();
+                continue;
+            }
+            ++p;
+            if (c == '{' || c == '[') {
+                ++depth;
+            } else if ((c == '}' || c == ']') && --depth == 0) {
+                return;
+            }
+        }
+        failed = true;
+    }
+
+    // Microseconds with an optional fraction, as ticks. Exponents are rare
+    // enough to go through strtod.
+    uint64_t time() {
+        skip_ws();
+        const char * begin = p;
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p++ - '0');
+        }
+        value *= TICKS_PER_US;
+        if (p < end && *p == '.') {
+            ++p;
+            uint64_t scale = TICKS_PER_US;
+            while (p < end && *p >= '0' && *p <= '9') {
+                scale /= 10;
+                value += (*p++ - '0') * scale;
+            }
+        }
+        if (p < end && (*p == 'e' || *p == 'E' || *p == '-')) {
+            const double us = strtod(begin, nullptr);
+            skip_value();
+            return us > 0.0 ? (uint64_t) (us * TICKS_PER_US) : 0;
+        }
+        return value;
+    }
+
+    // pid and tid are numbers, but some producers write strings
+    uint64_t id() {
+        skip_ws();
+        if (p < end && *p == '"') {
+            const std::string_view text = string();
+            uint64_t hash = 14695981039346656037ull;
+            for (char c : text) {
+                hash = (hash ^ (uint8_t) c) * 1099511628211ull;
+            }
+            return hash;
+        }
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + (*p++ - '0');
+        }
+        skip_value();
+        return value;
+    }
+};
+
+struct Event {
+    char phase = 0;
+    bool has_dur = false;
+    uint64_t pid = 0;
+    uint64_t tid = 0;
+    uint64_t ts = 0;
+    uint64_t dur = 0;
+    std::string_view name;
+    // the args object, only decoded for counters
+    const char * args = nullptr;
+};
+
+}
+
+// The common escapes are decoded, \u sequences are kept as written.
+static void unescape(std::string_view text, std::string & out) {
+    out.clear();
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+            out += text[i];
+            continue;
+        }
+        const char c = text[++i];
+        switch (c) {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': out += "\\u"; break;
+            default: out += c; break;
+        }
+    }
+}
+
+bool is_chrome_trace(const char * begin, const char * end) {
+    while (begin < end && (*begin == ' ' || *begin == '\n' || *begin == '\r' || *begin == '\t')) {
+        ++begin;
+    }
+    return begin < end && (*begin == '{' || *begin == '[');
+}
+
+// The numeric members of an args object, other values are skipped.
+static void read_args(Reader & reader, std::vector< std::pair<std::string_view, double> > & values) {
+    values.clear();
+    if (!reader.consume('{')) {
+        return;
+    }
+    while (reader.consume('"')) {
+        --reader.p;
+        const std::string_view key = reader.string();
+        if (!reader.consume(':')) {
+            return;
+        }
+        reader.skip_ws();
+        char * next = nullptr;
+        const double value = strtod(reader.p, &next);
+        if (next != reader.p && next <= reader.end) {
+            values.emplace_back(key, value);
+            reader.p = next;
+        } else {
+            reader.skip_value();
+        }
+        reader.consume(',');
+    }
+}
+
+ChromeReader::ChromeReader(std::vector<std::string> & names, std::vector<CounterTrack> & counters, LongestTasks & longest)
+    : m_names(names), m_counters(counters), m_longest(longest), m_first_counter(counters.size()) {
+}
+
+// Names are looked up through one reused string, so names already seen
+// cost no allocation.
+uint32_t ChromeReader::intern(std::string_view name) {
+    if (name.find('\\') != std::string_view::npos) {
+        unescape(name, m_lookup);
+    } else {
+        m_lookup.assign(name.data(), name.size());
+    }
+    auto it = m_name_index.find(m_lookup);
+    if (it != m_name_index.end()) {
+        return it->second;
+    }
+    m_names.push_back(m_lookup);
+    m_name_index.emplace(m_lookup, (uint32_t) m_names.size() - 1);
+    return (uint32_t) m_names.size() - 1;
+}
+
+// Counter tracks are keyed by pid, name and args member; a series is named
+// after its members only once it has more than one, see finish().
+void ChromeReader::add_sample(uint64_t pid, uint64_t ts, std::string_view name, const char * args, const char * end) {
+    Reader reader{ args, end };
+    read_args(reader, m_values);
+    unescape(name, m_track_name);
+    for (const auto & value : m_values) {
+        m_track_key.assign((const char *) &pid, sizeof(pid));
+        m_track_key += m_track_name;
+        m_track_key += '\0';
+        m_track_key.append(value.first);
+        auto it = m_counter_index.emplace(m_track_key, m_counters.size()).first;
+        if (it->second == m_counters.size()) {
+            m_counters.emplace_back();
+            m_counters.back().name = m_track_name;
+            m_counters.back().proc = pid;
+            m_counter_members.emplace_back(value.first);
+        }
+        m_counters[it->second].times.push_back(ts);
+        m_counters[it->second].values.push_back(value.second);
+    }
+}
+
+bool ChromeReader::read(const char * begin, const char * end, bool last, std::vector<Entry> & tasks, size_t & used,
+                        const std::function<bool(const char *)> & progress) {
+    Reader reader{ begin, end };
+    used = 0;
+    if (m_done) {
+        used = end - begin;
+        return true;
+    }
+
+    // find the event array
+    if (!m_started) {
+        if (reader.consume('{')) {
+            bool found = false;
+            while (!found && !reader.failed && reader.consume('"')) {
+                --reader.p;
+                const std::string_view key = reader.string();
+                if (!reader.consume(':')) {
+                    break;
+                }
+                if (key == "traceEvents") {
+                    found = true;
+                } else {
+                    reader.skip_value();
+                    reader.consume(',');
+                }
+            }
+            if (!found) {
+                // the object may go on in the next piece
+                if (!last && reader.p >= end) {
+                    return true;
+                }
+                std::cerr << "No traceEvents array" << std::endl;
+                return false;
+            }
+        }
+        if (!reader.consume('[')) {
+            if (!last && reader.p >= end) {
+                return true;
+            }
+            std::cerr << "Parse error!" << std::endl;
+            return false;
+        }
+        m_started = true;
+        used = reader.p - begin;
+    } else {
+        // the comma after the last event of the previous piece
+        reader.consume(',');
+    }
+
+    // pids and tids are hashed together as the key of the thread
+    auto thread_key = [](const Event & event) {
+        return event.pid * 0x9e3779b97f4a7c15ull ^ event.tid;
+    };
+
+    while (reader.consume('{')) {
+        const char * event_begin = reader.p - 1;
+        if (++m_events % 0x10000 == 0 && progress && !progress(reader.p)) {
+            return false;
+        }
+        Event event;
+        while (reader.consume('"')) {
+            --reader.p;
+            const std::string_view key = reader.string();
+            if (!reader.consume(':')) {
+                reader.failed = true;
+                break;
+            }
+            reader.skip_ws();
+            if (key == "ph" && reader.p < end && *reader.p == '"') {
+                const std::string_view phase = reader.string();
+                event.phase = phase.empty() ? 0 : phase[0];
+            } else if (key == "name" && reader.p < end && *reader.p == '"') {
+                event.name = reader.string();
+            } else if (key == "ts") {
+                event.ts = reader.time();
+            } else if (key == "dur") {
+                event.dur = reader.time();
+                event.has_dur = true;
+            } else if (key == "pid") {
+                event.pid = reader.id();
+            } else if (key == "tid") {
+                event.tid = reader.id();
+            } else if (key == "args") {
+                event.args = reader.p;
+                reader.skip_value();
+            } else {
+                reader.skip_value();
+            }
+            reader.consume(',');
+        }
+        if (reader.failed || !reader.consume('}')) {
+            // cut off by the end of the piece, read again with the next
+            if (!last && reader.p >= end) {
+                used = event_begin - begin;
+                return true;
+            }
+            std::cerr << "Parse error!" << std::endl;
+            return false;
+        }
+        reader.consume(',');
+        used = reader.p - begin;
+
+        Entry e;
+        e.proc = event.pid;
+        e.thread = event.tid;
+        if (event.phase == 'X' && event.has_dur) {
+            e.start = event.ts;
+            e.length = event.dur;
+            e.name_index = intern(event.name);
+            m_longest.add(e);
+            tasks.push_back(e);
+        } else if (event.phase == 'B') {
+            m_open[thread_key(event)].push_back({ event.ts, intern(event.name) });
+        } else if (event.phase == 'E') {
+            auto it = m_open.find(thread_key(event));
+            if (it == m_open.end() || it->second.empty()) {
+                continue;
+            }
+            const Open & o = it->second.back();
+            e.start = o.start;
+            e.length = event.ts > o.start ? event.ts - o.start : 0;
+            e.name_index = o.name_index;
+            m_longest.add(e);
+            tasks.push_back(e);
+            it->second.pop_back();
+        } else if (event.phase == 'C' && event.args != nullptr) {
+            add_sample(event.pid, event.ts, event.name, event.args, end);
+        }
+    }
+    // anything but another event ends the array
+    m_done = reader.p < end;
+    used = end - begin;
+    if (progress) {
+        progress(reader.p);
+    }
+    return true;
+}
+
+void ChromeReader::finish() {
+    // series with several members get the member in each track's name, so a
+    // member that only shows up in later samples still renames the first
+    std::unordered_map<std::string, size_t> series_members;
+    for (size_t i = m_first_counter; i < m_counters.size(); ++i) {
+        m_track_key.assign((const char *) &m_counters[i].proc, sizeof(m_counters[i].proc));
+        m_track_key += m_counters[i].name;
+        ++series_members[m_track_key];
+    }
+    for (size_t i = m_first_counter; i < m_counters.size(); ++i) {
+        m_track_key.assign((const char *) &m_counters[i].proc, sizeof(m_counters[i].proc));
+        m_track_key += m_counters[i].name;
+        if (series_members[m_track_key] > 1) {
+            m_counters[i].name += ' ';
+            m_counters[i].name += m_counter_members[i - m_first_counter];
+        }
+    }
+}
+
+bool read_chrome_trace(const char * begin, const char * end, std::vector<Entry> & tasks, std::vector<std::string> & names,
+                       std::vector<CounterTrack> & counters, LongestTasks & longest, const std::function<bool(const char *)> & progress) {
+    ChromeReader reader(names, counters, longest);
+    size_t used = 0;
+    if (!reader.read(begin, end, true, tasks, used, progress)) {
+        return false;
+    }
+    reader.finish();
+    return true;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Counters.h"
+#include "Longest.h"
+#include "Trace.h"
+
+// Chrome trace-event JSON, either a bare array of events or an object
+// with a "traceEvents" array. "X" complete events and "B"/"E" pairs become
+// tasks; pid and tid become proc and thread. Every numeric member of the
+// args of "C" counter events is a counter track of its pid, named after the
+// event, plus the member's key if the event's samples have several members.
+// Everything else is skipped.
+
+// true if the text starts like JSON rather than a native log
+bool is_chrome_trace(const char * begin, const char * end);
+
+// Appends the tasks, names and counter samples of the events in
+// [begin, end); counters carry their original pid as proc. progress is
+// called now and then with the current position and stops reading if it
+// returns false. Every task is also offered to longest.
+bool read_chrome_trace(const char * begin, const char * end, std::vector<Entry> & tasks, std::vector<std::string> & names,
+                       std::vector<CounterTrack> & counters, LongestTasks & longest, const std::function<bool(const char *)> & progress);
+
+// Reads a trace a piece at a time, for files too large to hold in memory;
+// names, counter tracks and open "B" events carry over from one piece to
+// the next.
+class ChromeReader {
+public:
+    ChromeReader(std::vector<std::string> & names, std::vector<CounterTrack> & counters, LongestTasks & longest);
+
+    // Appends the tasks of the events in [begin, end). Unless last is set,
+    // an event cut off by end is left unread: used is how much of the text
+    // was read, and the rest has to be passed again with more text after
+    // it. progress as for read_chrome_trace().
+    bool read(const char * begin, const char * end, bool last, std::vector<Entry> & tasks, size_t & used,
+              const std::function<bool(const char *)> & progress = nullptr);
+    // Names the counter tracks, once all samples have been read.
+    void finish();
+
+private:
+    struct Open {
+        uint64_t start;
+        uint32_t name_index;
+    };
+
+    uint32_t intern(std::string_view name);
+    void add_sample(uint64_t pid, uint64_t ts, std::string_view name, const char * args, const char * end);
+
+    std::vector<std::string> & m_names;
+    std::vector<CounterTrack> & m_counters;
+    LongestTasks & m_longest;
+    std::unordered_map<std::string, uint32_t> m_name_index;
+    std::string m_lookup;
+    // "B" events waiting for their "E", per thread
+    std::unordered_map<uint64_t, std::vector<Open>> m_open;
+    // counter tracks by pid, name and member, and the member of each
+    std::unordered_map<std::string, size_t> m_counter_index;
+    std::vector<std::string> m_counter_members;
+    size_t m_first_counter;
+    std::vector< std::pair<std::string_view, double> > m_values;
+    std::string m_track_key;
+    std::string m_track_name;
+    size_t m_events = 0;
+    bool m_started = false;
+    bool m_done = false;
+};
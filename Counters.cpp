@@ -0,0 +1,137 @@
+#include "Counters.h"
+#include "Layout.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <numeric>
+
+std::vector<CounterTrack> g_counters;
+
+// the graph fills most of the track's two row heights
+static const float graph_extent = 0.9f;
+
+uint32_t counter_slot(size_t counter) {
+    return (uint32_t) (rowdata.size() + g_tasksperproc.size() + counter);
+}
+
+void build_counter_pyramids() {
+    parallel_for(0, g_counters.size(), [](size_t i) {
+        CounterTrack & track = g_counters[i];
+        if (!std::is_sorted(track.times.begin(), track.times.end())) {
+            std::vector<size_t> order(track.times.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&track](size_t a, size_t b) {
+                return track.times[a] < track.times[b];
+            });
+            std::vector<uint64_t> times(order.size());
+            std::vector<double> values(order.size());
+            for (size_t j = 0; j < order.size(); ++j) {
+                times[j] = track.times[order[j]];
+                values[j] = track.values[order[j]];
+            }
+            track.times.swap(times);
+            track.values.swap(values);
+        }
+
+        track.mins.clear();
+        track.maxs.clear();
+        const std::vector<double> * below_min = &track.values;
+        const std::vector<double> * below_max = &track.values;
+        while (below_min->size() > 1) {
+            const size_t count = (below_min->size() + CounterTrack::FANOUT - 1) / CounterTrack::FANOUT;
+            std::vector<double> mins(count);
+            std::vector<double> maxs(count);
+            for (size_t b = 0; b < count; ++b) {
+                const size_t first = b * CounterTrack::FANOUT;
+                const size_t last = std::min(first + CounterTrack::FANOUT, below_min->size());
+                mins[b] = *std::min_element(below_min->begin() + first, below_min->begin() + last);
+                maxs[b] = *std::max_element(below_max->begin() + first, below_max->begin() + last);
+            }
+            track.mins.push_back(std::move(mins));
+            track.maxs.push_back(std::move(maxs));
+            below_min = &track.mins.back();
+            below_max = &track.maxs.back();
+        }
+        if (!track.values.empty()) {
+            track.min = track.mins.empty() ? track.values[0] : track.mins.back()[0];
+            track.max = track.maxs.empty() ? track.values[0] : track.maxs.back()[0];
+        }
+    });
+}
+
+// Climbs while whole blocks fit into the range and descends again at its
+// end, like a segment tree walk.
+void counter_range(const CounterTrack & track, size_t first, size_t last, double & min, double & max) {
+    min = track.values[first];
+    max = track.values[first];
+    size_t level = 0;     // 0: samples, l: mins[l - 1]
+    size_t size = 1;
+    while (first < last) {
+        if (level < track.mins.size() && first % (size * CounterTrack::FANOUT) == 0 && first + size * CounterTrack::FANOUT <= last) {
+            ++level;
+            size *= CounterTrack::FANOUT;
+            continue;
+        }
+        if (first + size > last) {
+            --level;
+            size /= CounterTrack::FANOUT;
+            continue;
+        }
+        const double lo = level == 0 ? track.values[first] : track.mins[level - 1][first / size];
+        const double hi = level == 0 ? track.values[first] : track.maxs[level - 1][first / size];
+        min = std::min(min, lo);
+        max = std::max(max, hi);
+        first += size;
+    }
+}
+
+void counter_points(size_t counter, uint64_t t0, uint64_t t1, size_t width, std::vector<counter_point_t> & points) {
+    const CounterTrack & track = g_counters[counter];
+    if (track.times.empty() || width == 0) {
+        return;
+    }
+    const uint32_t slot = counter_slot(counter);
+    const double range = track.max > track.min ? track.max - track.min : 1.0;
+    auto y = [&](double value) {
+        // larger values higher up
+        return graph_extent - 2.0f * graph_extent * (float) ((value - track.min) / range);
+    };
+
+    // one sample beyond each edge, so the lines leave the window
+    size_t first = std::lower_bound(track.times.begin(), track.times.end(), t0) - track.times.begin();
+    size_t last = std::upper_bound(track.times.begin(), track.times.end(), t1) - track.times.begin();
+    first = first > 0 ? first - 1 : 0;
+    last = std::min(last + 1, track.times.size());
+
+    if (last - first <= 2 * width) {
+        for (size_t i = first; i < last; ++i) {
+            points.push_back({ { 1e-3f * (float) track.times[i], y(track.values[i]) }, slot, 0 });
+        }
+        return;
+    }
+    // the samples of each pixel's column as a vertical stroke; columns are
+    // split on time, so bursts of samples stay in their own pixels. The edge
+    // samples join the first and last columns.
+    const double per_pixel = t1 > t0 ? (double) (t1 - t0) / (double) width : 0.0;
+    auto boundary = [&](size_t pixel, size_t from) {
+        if (pixel == width) {
+            return last;
+        }
+        const uint64_t t = t0 + (uint64_t) (pixel * per_pixel);
+        return (size_t) (std::lower_bound(track.times.begin() + from, track.times.begin() + last, t) - track.times.begin());
+    };
+    size_t b = first;
+    for (size_t pixel = 0; pixel < width; ++pixel) {
+        const size_t a = pixel == 0 ? first : b;
+        b = std::max(a, boundary(pixel + 1, a));
+        if (a >= b) {
+            continue;
+        }
+        double min, max;
+        counter_range(track, a, b, min, max);
+        const float x = 1e-3f * (float) track.times[a];
+        points.push_back({ { x, y(min) }, slot, 0 });
+        points.push_back({ { x, y(max) }, slot, 0 });
+    }
+}
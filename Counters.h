@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "VertexData.h"
+
+// Numeric counters sampled over time, drawn as a line graph track under
+// their process. Samples are kept as columns; a min/max pyramid over them
+// lets a view of any zoom level be drawn with about two points per pixel.
+
+struct CounterTrack {
+    static constexpr size_t FANOUT = 8;
+
+    std::string name;
+    uint64_t proc = 0;
+    std::vector<uint64_t> times;    // ascending after build_counter_pyramids()
+    std::vector<double> values;
+    // level l holds the extremes of blocks of FANOUT^(l+1) samples
+    std::vector< std::vector<double> > mins;
+    std::vector< std::vector<double> > maxs;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+// Defined in Counters.cpp, filled by the readers.
+extern std::vector<CounterTrack> g_counters;
+
+// Layout slot of a counter's track, after the summary slots.
+uint32_t counter_slot(size_t counter);
+
+// Sorts every track's samples and builds its pyramid, tracks in parallel.
+void build_counter_pyramids();
+
+// Extremes of samples [first, last) of the track, from O(FANOUT * levels)
+// pyramid entries.
+void counter_range(const CounterTrack & track, size_t first, size_t last, double & min, double & max);
+
+// Points of the track's graph between t0 and t1 for a view width pixels
+// wide: the samples themselves if there are few enough, else the minimum
+// and maximum of each pixel's samples. y is relative to the track's slot.
+void counter_points(size_t counter, uint64_t t0, uint64_t t1, size_t width, std::vector<counter_point_t> & points);
@@ -0,0 +1,128 @@
+#include "Diff.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <unordered_map>
+
+std::vector<NameDiff> g_name_diff;
+
+// The lengths are bucketed by name with a counting sort, then every name
+// picks its percentiles on its own thread.
+std::vector<NameSummary> summarize_names(const std::vector<Entry> & tasks, const std::vector<std::string> & names) {
+    std::vector<size_t> first(names.size() + 1, 0);
+    for (const Entry & e : tasks) {
+        ++first[e.name_index + 1];
+    }
+    for (size_t i = 0; i < names.size(); ++i) {
+        first[i + 1] += first[i];
+    }
+    std::vector<uint64_t> lengths(tasks.size());
+    std::vector<size_t> next(first.begin(), first.end() - 1);
+    for (const Entry & e : tasks) {
+        lengths[next[e.name_index]++] = e.length;
+    }
+
+    std::vector<NameSummary> summaries(names.size());
+    parallel_for(0, names.size(), [&](size_t name_index) {
+        NameSummary & summary = summaries[name_index];
+        summary.name = names[name_index];
+        const auto begin = lengths.begin() + first[name_index];
+        const auto end = lengths.begin() + first[name_index + 1];
+        summary.count = end - begin;
+        if (summary.count == 0) {
+            return;
+        }
+        for (auto it = begin; it != end; ++it) {
+            summary.total += *it;
+        }
+        // each call leaves the elements before its result no larger, so
+        // the next, lower percentile only reorders those
+        auto limit = end;
+        auto percentile = [&](uint64_t p) {
+            const auto nth = begin + (summary.count - 1) * p / 100;
+            std::nth_element(begin, nth, limit);
+            limit = nth + 1;
+            return *nth;
+        };
+        summary.p99 = percentile(99);
+        summary.p90 = percentile(90);
+        summary.p50 = percentile(50);
+    });
+
+    summaries.erase(std::remove_if(summaries.begin(), summaries.end(), [](const NameSummary & summary) {
+        return summary.count == 0;
+    }), summaries.end());
+    return summaries;
+}
+
+std::vector<NameDiff> diff_names(const std::vector<NameSummary> & baseline, const std::vector<NameSummary> & candidate) {
+    std::vector<NameDiff> diff;
+    std::unordered_map<std::string, size_t> index;
+    for (const NameSummary & summary : baseline) {
+        index[summary.name] = diff.size();
+        NameDiff entry;
+        entry.baseline = summary;
+        entry.candidate.name = summary.name;
+        diff.push_back(entry);
+    }
+    for (const NameSummary & summary : candidate) {
+        auto it = index.find(summary.name);
+        if (it == index.end()) {
+            NameDiff entry;
+            entry.baseline.name = summary.name;
+            entry.candidate = summary;
+            diff.push_back(entry);
+        } else {
+            diff[it->second].candidate = summary;
+        }
+    }
+    for (NameDiff & entry : diff) {
+        entry.delta = (int64_t) entry.candidate.total - (int64_t) entry.baseline.total;
+    }
+    std::sort(diff.begin(), diff.end(), [](const NameDiff & a, const NameDiff & b) {
+        return a.delta > b.delta;
+    });
+    return diff;
+}
+
+static std::string format_delta(int64_t delta) {
+    return delta < 0 ? "-" + format((uint64_t) -delta) : "+" + format((uint64_t) delta);
+}
+
+void print_name_diff(const std::vector<NameDiff> & diff, size_t max_names, std::ostream & out) {
+    int64_t delta = 0;
+    for (const NameDiff & entry : diff) {
+        delta += entry.delta;
+    }
+    out << diff.size() << " names, total " << format_delta(delta) << std::endl;
+    out << std::left << std::setw(40) << "name"
+        << std::right << std::setw(12) << "delta"
+        << std::setw(10) << "total" << std::setw(10) << "count"
+        << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::endl;
+
+    // the largest regressions and the largest improvements
+    // baseline on the first line, candidate below it
+    auto print_summary = [&out](const std::string & label, const std::string & delta, const NameSummary & summary) {
+        out << std::left << std::setw(40) << label
+            << std::right << std::setw(12) << delta
+            << std::setw(10) << format(summary.total) << std::setw(10) << summary.count
+            << std::setw(10) << format(summary.p50) << std::setw(10) << format(summary.p90)
+            << std::setw(10) << format(summary.p99) << std::endl;
+    };
+    auto print = [&](const NameDiff & entry) {
+        print_summary(entry.baseline.name, format_delta(entry.delta), entry.baseline);
+        print_summary(std::string(), std::string(), entry.candidate);
+    };
+    const size_t head = std::min(diff.size(), max_names - max_names / 4);
+    for (size_t i = 0; i < head; ++i) {
+        print(diff[i]);
+    }
+    const size_t tail = std::min(diff.size() - head, max_names / 4);
+    if (head + tail < diff.size()) {
+        out << "..." << std::endl;
+    }
+    for (size_t i = diff.size() - tail; i < diff.size(); ++i) {
+        print(diff[i]);
+    }
+}
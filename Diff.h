@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+// Comparing a baseline trace with a candidate. Each trace is summarised
+// per name while it is ingested; the diff joins the two summaries by name
+// string and never goes back to the tasks.
+
+struct NameSummary {
+    std::string name;
+    uint64_t total = 0;
+    uint64_t count = 0;
+    uint64_t p50 = 0;
+    uint64_t p90 = 0;
+    uint64_t p99 = 0;
+};
+
+struct NameDiff {
+    NameSummary baseline;   // empty if the name is new in the candidate
+    NameSummary candidate;  // empty if the name is gone
+    int64_t delta = 0;      // candidate total - baseline total
+};
+
+// One summary per name that has tasks.
+std::vector<NameSummary> summarize_names(const std::vector<Entry> & tasks, const std::vector<std::string> & names);
+
+// Largest regression first, improvements last.
+std::vector<NameDiff> diff_names(const std::vector<NameSummary> & baseline, const std::vector<NameSummary> & candidate);
+
+void print_name_diff(const std::vector<NameDiff> & diff, size_t max_names, std::ostream & out);
+
+// Set by parse_diff().
+extern std::vector<NameDiff> g_name_diff;
@@ -0,0 +1,392 @@
+#include "Export.h"
+#include "Counters.h"
+#include "RangeStats.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Native ticks are nanoseconds, Chrome timestamps microseconds.
+static constexpr uint64_t TICKS_PER_US = 1000;
+
+namespace {
+
+// fwrite in large blocks; the exporters append small pieces.
+class OutputFile {
+public:
+    explicit OutputFile(const char * filename) : m_file(fopen(filename, "wb")) {
+        m_buffer.reserve(BUFFER_SIZE);
+    }
+    ~OutputFile() {
+        close();
+    }
+
+    bool is_open() const { return m_file != nullptr; }
+
+    void write(const char * data, size_t size) {
+        if (m_buffer.size() + size > BUFFER_SIZE) {
+            flush();
+        }
+        m_buffer.insert(m_buffer.end(), data, data + size);
+    }
+    void write(const std::string & text) { write(text.data(), text.size()); }
+    void write(char c) { write(&c, 1); }
+    void write_uint(uint64_t value, int base = 10) {
+        char digits[24];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value, base);
+        write(digits, result.ptr - digits);
+    }
+    // shortest text that reads back as the same value
+    void write_double(double value) {
+        char digits[32];
+        const auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        write(digits, result.ptr - digits);
+    }
+
+    // false if any write failed
+    bool close() {
+        if (m_file == nullptr) {
+            return m_ok;
+        }
+        flush();
+        m_ok = fclose(m_file) == 0 && m_ok;
+        m_file = nullptr;
+        return m_ok;
+    }
+
+private:
+    static constexpr size_t BUFFER_SIZE = 4 << 20;
+
+    void flush() {
+        if (!m_buffer.empty() && fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size()) {
+            m_ok = false;
+        }
+        m_buffer.clear();
+    }
+
+    FILE * m_file;
+    std::vector<char> m_buffer;
+    bool m_ok = true;
+};
+
+}
+
+// Clips the task to [t0, t1); false if nothing of it is left.
+static bool crop(const Entry & e, uint64_t t0, uint64_t t1, uint64_t & start, uint64_t & end) {
+    start = std::max(e.start, t0);
+    end = std::min(e.start + e.length, t1);
+    return end > start || (e.length == 0 && e.start >= t0 && e.start < t1);
+}
+
+static std::string json_string(const std::string & text) {
+    std::string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((unsigned char) c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+bool export_chrome_trace(const char * filename, uint64_t t0, uint64_t t1) {
+    OutputFile out(filename);
+    if (!out.is_open()) {
+        std::cerr << "Cannot write " << filename << std::endl;
+        return false;
+    }
+    // the names are escaped once rather than per task
+    std::vector<std::string> names(g_names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        names[i] = json_string(g_names[i]);
+    }
+    auto write_time = [&out](uint64_t ticks) {
+        out.write_uint(ticks / TICKS_PER_US);
+        const uint64_t fraction = ticks % TICKS_PER_US;
+        if (fraction != 0) {
+            char digits[4] = { '.', char('0' + fraction / 100), char('0' + fraction / 10 % 10), char('0' + fraction % 10) };
+            out.write(digits, sizeof(digits));
+        }
+    };
+
+    out.write("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
+        for (size_t thread = 0; thread < g_tasksperproc[proc].size(); ++thread) {
+            for (const Entry * e : g_tasksperproc[proc][thread]) {
+                if (e->start >= t1) {
+                    break;
+                }
+                uint64_t start, end;
+                if (!crop(*e, t0, t1, start, end)) {
+                    continue;
+                }
+                out.write(first ? "{\"ph\":\"X\",\"name\":" : ",\n{\"ph\":\"X\",\"name\":");
+                first = false;
+                out.write(names[e->name_index]);
+                out.write(",\"pid\":");
+                out.write_uint(proc);
+                out.write(",\"tid\":");
+                out.write_uint(thread);
+                out.write(",\"ts\":");
+                write_time(start);
+                out.write(",\"dur\":");
+                write_time(end - start);
+                out.write('}');
+            }
+        }
+    }
+    out.write("\n]}\n");
+    return out.close();
+}
+
+// Protobuf wire format, written by hand: a tag is (field << 3) | wire
+// type, integers are varints and nested messages are length-prefixed.
+static void put_varint(std::string & out, uint64_t value) {
+    while (value >= 0x80) {
+        out += char(value | 0x80);
+        value >>= 7;
+    }
+    out += char(value);
+}
+static void put_uint(std::string & out, uint32_t field, uint64_t value) {
+    put_varint(out, field << 3);
+    put_varint(out, value);
+}
+static void put_bytes(std::string & out, uint32_t field, const std::string & bytes) {
+    put_varint(out, (field << 3) | 2);
+    put_varint(out, bytes.size());
+    out += bytes;
+}
+
+// Field numbers from perfetto/trace/trace_packet.proto and the
+// track_event protos.
+enum : uint32_t {
+    TRACE_PACKET = 1,
+    PACKET_TIMESTAMP = 8,
+    PACKET_SEQUENCE_ID = 10,
+    PACKET_TRACK_EVENT = 11,
+    PACKET_INTERNED_DATA = 12,
+    PACKET_SEQUENCE_FLAGS = 13,
+    PACKET_TRACK_DESCRIPTOR = 60,
+    INTERNED_EVENT_NAMES = 2,
+    EVENT_NAME_IID = 1,
+    EVENT_NAME_NAME = 2,
+    TRACK_UUID = 1,
+    TRACK_NAME = 2,
+    TRACK_PROCESS = 3,
+    TRACK_THREAD = 4,
+    TRACK_PARENT_UUID = 5,
+    PROCESS_PID = 1,
+    THREAD_PID = 1,
+    THREAD_TID = 2,
+    EVENT_TYPE = 9,
+    EVENT_NAME_INTERNED = 10,
+    EVENT_TRACK_UUID = 11,
+    SLICE_BEGIN = 1,
+    SLICE_END = 2,
+    SEQ_INCREMENTAL_STATE_CLEARED = 1,
+    SEQ_NEEDS_INCREMENTAL_STATE = 2,
+    SEQUENCE_ID = 1,
+};
+
+bool export_perfetto(const char * filename, uint64_t t0, uint64_t t1) {
+    OutputFile out(filename);
+    if (!out.is_open()) {
+        std::cerr << "Cannot write " << filename << std::endl;
+        return false;
+    }
+    // reused for every packet, so they stop allocating after the first few
+    std::string packet, message, inner, header;
+    auto write_packet = [&]() {
+        header.clear();
+        put_varint(header, (TRACE_PACKET << 3) | 2);
+        put_varint(header, packet.size());
+        out.write(header);
+        out.write(packet);
+        packet.clear();
+    };
+
+    // names, interned as iid = name_index + 1
+    for (size_t i = 0; i < g_names.size(); ++i) {
+        inner.clear();
+        put_uint(inner, EVENT_NAME_IID, i + 1);
+        put_bytes(inner, EVENT_NAME_NAME, g_names[i]);
+        put_bytes(message, INTERNED_EVENT_NAMES, inner);
+    }
+    put_uint(packet, PACKET_SEQUENCE_ID, SEQUENCE_ID);
+    put_uint(packet, PACKET_SEQUENCE_FLAGS, SEQ_INCREMENTAL_STATE_CLEARED);
+    put_bytes(packet, PACKET_INTERNED_DATA, message);
+    write_packet();
+
+    // rows of every thread, threads numbered as in g_tasksperproc
+    std::vector<size_t> thread_base(1, 0);
+    for (const auto & threads : g_tasksperproc) {
+        thread_base.push_back(thread_base.back() + threads.size());
+    }
+    std::vector< std::vector<size_t> > thread_rows(thread_base.back());
+    for (size_t row = 0; row < g_rowtasks.size(); ++row) {
+        thread_rows[thread_base[rowdata[row].first] + rowdata[row].second].push_back(row);
+    }
+
+    uint64_t tid = 0;
+    for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
+        const uint64_t process_uuid = (proc + 1) << 32;
+        message.clear();
+        put_uint(message, TRACK_UUID, process_uuid);
+        inner.clear();
+        put_uint(inner, PROCESS_PID, proc + 1);
+        put_bytes(message, TRACK_PROCESS, inner);
+        put_bytes(packet, PACKET_TRACK_DESCRIPTOR, message);
+        write_packet();
+
+        for (size_t thread = 0; thread < g_tasksperproc[proc].size(); ++thread) {
+            // tids are unique across processes in Perfetto
+            const uint64_t thread_uuid = process_uuid | (thread + 1);
+            message.clear();
+            put_uint(message, TRACK_UUID, thread_uuid);
+            put_uint(message, TRACK_PARENT_UUID, process_uuid);
+            inner.clear();
+            put_uint(inner, THREAD_PID, proc + 1);
+            put_uint(inner, THREAD_TID, ++tid);
+            put_bytes(message, TRACK_THREAD, inner);
+            put_bytes(packet, PACKET_TRACK_DESCRIPTOR, message);
+            write_packet();
+
+            auto slice = [&](uint64_t track_uuid, uint64_t time, uint32_t type, const Entry * e) {
+                message.clear();
+                put_uint(message, EVENT_TYPE, type);
+                put_uint(message, EVENT_TRACK_UUID, track_uuid);
+                if (e != nullptr) {
+                    put_uint(message, EVENT_NAME_INTERNED, e->name_index + 1);
+                }
+                put_uint(packet, PACKET_TIMESTAMP, time);
+                put_uint(packet, PACKET_SEQUENCE_ID, SEQUENCE_ID);
+                put_uint(packet, PACKET_SEQUENCE_FLAGS, SEQ_NEEDS_INCREMENTAL_STATE);
+                put_bytes(packet, PACKET_TRACK_EVENT, message);
+                write_packet();
+            };
+            // Tasks may overlap without nesting, which slices on one track
+            // cannot express, so every depth row gets its own track: the
+            // thread's for depth 0, a child track below it for the others.
+            // The tasks of a row never overlap, so each ends before the next
+            // begins.
+            for (size_t row : thread_rows[thread_base[proc] + thread]) {
+                size_t first, last;
+                row_window(row, t0, t1, first, last);
+                if (first == last) {
+                    continue;
+                }
+                uint64_t track_uuid = thread_uuid;
+                if (rowdepth[row] != 0) {
+                    track_uuid = (1ull << 63) | row;
+                    message.clear();
+                    put_uint(message, TRACK_UUID, track_uuid);
+                    put_bytes(message, TRACK_NAME, "depth " + std::to_string(rowdepth[row]));
+                    put_uint(message, TRACK_PARENT_UUID, thread_uuid);
+                    put_bytes(packet, PACKET_TRACK_DESCRIPTOR, message);
+                    write_packet();
+                }
+                for (size_t i = first; i < last; ++i) {
+                    const Entry * e = g_rowtasks[row][i];
+                    uint64_t start, end;
+                    if (!crop(*e, t0, t1, start, end)) {
+                        continue;
+                    }
+                    slice(track_uuid, start, SLICE_BEGIN, e);
+                    slice(track_uuid, end, SLICE_END, nullptr);
+                }
+            }
+        }
+    }
+    return out.close();
+}
+
+// Rows keep their tasks free of overlaps, so two binary searches per row
+// find the tasks of the range; only those and their names are visited.
+bool export_log(const char * filename, uint64_t t0, uint64_t t1) {
+    std::vector< std::pair<size_t, size_t> > windows(g_rowtasks.size());
+    std::vector<uint8_t> used(g_names.size(), 0);
+    size_t count = 0;
+    for (size_t row = 0; row < g_rowtasks.size(); ++row) {
+        row_window(row, t0, t1, windows[row].first, windows[row].second);
+        for (size_t i = windows[row].first; i < windows[row].second; ++i) {
+            used[g_rowtasks[row][i]->name_index] = 1;
+        }
+        count += windows[row].second - windows[row].first;
+    }
+    if (count == 0) {
+        std::cerr << "No tasks in the range" << std::endl;
+        return false;
+    }
+
+    OutputFile out(filename);
+    if (!out.is_open()) {
+        std::cerr << "Cannot write " << filename << std::endl;
+        return false;
+    }
+    // names first, keyed by their index
+    for (size_t i = 0; i < g_names.size(); ++i) {
+        if (used[i]) {
+            out.write('.');
+            out.write_uint(i, 16);
+            out.write(' ');
+            out.write(g_names[i]);
+            out.write('\n');
+        }
+    }
+    // the format has no processes, so every (proc, thread) gets its own
+    // thread id; the rows of a thread are adjacent
+    uint64_t thread = 0;
+    for (size_t row = 0; row < g_rowtasks.size(); ++row) {
+        if (row > 0 && rowdata[row] != rowdata[row - 1]) {
+            ++thread;
+        }
+        for (size_t i = windows[row].first; i < windows[row].second; ++i) {
+            const Entry * e = g_rowtasks[row][i];
+            out.write_uint(thread);
+            out.write('\t');
+            out.write_uint(e->start);
+            out.write('\t');
+            out.write_uint(e->length);
+            out.write('\t');
+            out.write_uint(e->name_index, 16);
+            out.write('\n');
+        }
+    }
+    // counters named after the task names, with their samples in the range
+    for (size_t counter = 0; counter < g_counters.size(); ++counter) {
+        const CounterTrack & track = g_counters[counter];
+        const size_t first = std::lower_bound(track.times.begin(), track.times.end(), t0) - track.times.begin();
+        const size_t last = std::lower_bound(track.times.begin(), track.times.end(), t1) - track.times.begin();
+        if (first == last) {
+            continue;
+        }
+        const uint64_t id = g_names.size() + counter;
+        out.write('.');
+        out.write_uint(id, 16);
+        out.write(' ');
+        out.write(track.name);
+        out.write('\n');
+        for (size_t i = first; i < last; ++i) {
+            out.write('$');
+            out.write_uint(id, 16);
+            out.write('\t');
+            out.write_uint(track.times[i]);
+            out.write('\t');
+            out.write_double(track.values[i]);
+            out.write('\n');
+        }
+    }
+    return out.close();
+}
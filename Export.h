@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstdint>
+
+// Writes the loaded trace, or the tasks intersecting [t0, t1) clipped to
+// it, straight from g_tasksperproc through a large output buffer.
+
+// Chrome trace-event JSON of "X" events, loadable by chrome://tracing and
+// the Perfetto UI.
+bool export_chrome_trace(const char * filename, uint64_t t0, uint64_t t1);
+
+// Perfetto protobuf: one track per thread under one per process, and one
+// more below the thread for each deeper row of its lanes; names interned
+// once, and begin/end slice events.
+bool export_perfetto(const char * filename, uint64_t t0, uint64_t t1);
+
+// A native log of the tasks intersecting [t0, t1), whole, the names they
+// use and the counter samples in the range. Loads like any other log.
+bool export_log(const char * filename, uint64_t t0, uint64_t t1);
@@ -0,0 +1,66 @@
+#include "Filter.h"
+#include "Layout.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <algorithm>
+
+bool TaskFilter::active() const {
+    return min_length > 0 || max_length < UINT64_MAX ||
+           std::find(hidden_names.begin(), hidden_names.end(), 1) != hidden_names.end();
+}
+
+// Calls visit(first vertex) for every task of the slot the filter lets through.
+template <typename Visit>
+static void visit_slot(const TaskFilter & filter, size_t slot, Visit visit) {
+    if (slot < g_rowtasks.size()) {
+        for (const Entry * e : g_rowtasks[slot]) {
+            if (filter.visible(e->name_index, e->length)) {
+                visit(e->vert_index);
+            }
+        }
+        return;
+    }
+    for (uint32_t task = g_slot_tasks[slot]; task < g_slot_tasks[slot + 1]; ++task) {
+        visit(task * 3);
+    }
+}
+
+// Two passes over the slots: count the visible tasks of every slot, then
+// let every slot write its indices at the offset the counts before it add
+// up to.
+size_t build_filtered_indices(const TaskFilter & filter, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri,
+                              std::vector<uint32_t> & slot_tasks) {
+    const size_t slots = g_slot_tasks.empty() ? 0 : g_slot_tasks.size() - 1;
+
+    slot_tasks.assign(slots + 1, 0);
+    parallel_for(0, slots, [&](size_t slot) {
+        uint32_t count = 0;
+        visit_slot(filter, slot, [&count](uint32_t) { ++count; });
+        slot_tasks[slot + 1] = count;
+    });
+    for (size_t slot = 0; slot < slots; ++slot) {
+        slot_tasks[slot + 1] += slot_tasks[slot];
+    }
+
+    const size_t visible = slot_tasks[slots];
+    indices_line.resize(visible * 6);
+    indices_tri.resize(visible * 3);
+
+    parallel_for(0, slots, [&](size_t slot) {
+        uint32_t * line = indices_line.data() + (size_t) slot_tasks[slot] * 6;
+        uint32_t * tri = indices_tri.data() + (size_t) slot_tasks[slot] * 3;
+        visit_slot(filter, slot, [&](uint32_t idx) {
+            *line++ = idx;
+            *line++ = idx + 1;
+            *line++ = idx + 1;
+            *line++ = idx + 2;
+            *line++ = idx + 2;
+            *line++ = idx;
+            *tri++ = idx;
+            *tri++ = idx + 1;
+            *tri++ = idx + 2;
+        });
+    });
+    return visible;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Which tasks are drawn. Hidden tasks keep their vertices on the GPU; only
+// the index lists that reference them are rebuilt without them.
+struct TaskFilter {
+    std::vector<uint8_t> hidden_names;      // by name_index; missing entries are shown
+    uint64_t min_length = 0;
+    uint64_t max_length = UINT64_MAX;
+
+    bool active() const;
+    bool visible(uint32_t name_index, uint64_t length) const {
+        return length >= min_length && length <= max_length &&
+               (name_index >= hidden_names.size() || hidden_names[name_index] == 0);
+    }
+};
+
+// Line and triangle indices of the visible tasks, in the layout generate_triangles()
+// uses (six line and three triangle indices per task), with the tasks of a
+// layout slot kept together; slot_tasks receives the first task of every
+// slot, as g_slot_tasks does for the full lists. Summary rows are never
+// filtered. Runs on all cores. Returns the number of visible tasks.
+size_t build_filtered_indices(const TaskFilter & filter, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri,
+                              std::vector<uint32_t> & slot_tasks);
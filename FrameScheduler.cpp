@@ -0,0 +1,88 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <iomanip>
+
+static double to_ms(FrameScheduler::clock::duration d) {
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+void FrameScheduler::set_refresh_rate(double hz) {
+    if (hz < 1.0) {
+        return;
+    }
+    m_period = std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(1.0 / hz));
+}
+
+void FrameScheduler::request(clock::time_point now) {
+    ++m_stats.requests;
+    if (m_dirty) {
+        return;
+    }
+    m_dirty = true;
+    m_first_request = now;
+}
+
+bool FrameScheduler::due(clock::time_point now) const {
+    return m_dirty && now >= m_next_frame;
+}
+
+void FrameScheduler::frame_rendered(clock::time_point now) {
+    // only back-to-back frames say something about pacing, not idle gaps
+    if (m_has_frame && now - m_last_frame < 4 * m_period) {
+        const double interval = to_ms(now - m_last_frame);
+        if (m_stats.intervals == 0) {
+            m_stats.interval_min = interval;
+            m_stats.interval_max = interval;
+        }
+        m_stats.interval_min = std::min(m_stats.interval_min, interval);
+        m_stats.interval_max = std::max(m_stats.interval_max, interval);
+        m_stats.interval_sum += interval;
+        ++m_stats.intervals;
+    }
+    const double latency = to_ms(now - m_first_request);
+    m_stats.latency_sum += latency;
+    m_stats.latency_max = std::max(m_stats.latency_max, latency);
+    ++m_stats.frames;
+
+    m_dirty = false;
+    m_has_frame = true;
+    m_last_frame = now;
+    m_next_frame = now + m_period;
+}
+
+void FrameScheduler::frame_busy(clock::time_point now) {
+    ++m_stats.busy;
+    m_next_frame = now + std::chrono::milliseconds(1);
+}
+
+uint32_t FrameScheduler::timeout_ms(clock::time_point now) const {
+    if (!m_dirty) {
+        return NO_TIMEOUT;
+    }
+    if (now >= m_next_frame) {
+        return 0;
+    }
+    return (uint32_t) std::chrono::duration_cast<std::chrono::milliseconds>(m_next_frame - now + std::chrono::microseconds(999)).count();
+}
+
+void FrameScheduler::report(std::ostream & out) {
+    const Stats & s = m_stats;
+    out << std::fixed << std::setprecision(2)
+        << "frames=" << s.frames
+        << " requests=" << s.requests
+        << " coalesced=" << (s.requests > s.frames ? s.requests - s.frames : 0)
+        << " busy=" << s.busy
+        << " vsync=" << to_ms(m_period) << "ms";
+    if (s.intervals > 0) {
+        out << " interval[min/avg/max]=" << s.interval_min
+            << "/" << s.interval_sum / s.intervals
+            << "/" << s.interval_max << "ms";
+    }
+    if (s.frames > 0) {
+        out << " latency[avg/max]=" << s.latency_sum / s.frames
+            << "/" << s.latency_max << "ms";
+    }
+    out << std::endl;
+    m_stats = Stats();
+}
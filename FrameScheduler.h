@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+// Decides when to render. Input only marks the view as changed; all changes
+// that arrive before the next vsync slot are coalesced into one frame, and
+// nothing is rendered while the view is unchanged.
+class FrameScheduler {
+public:
+    using clock = std::chrono::steady_clock;
+
+    static constexpr uint32_t NO_TIMEOUT = UINT32_MAX;
+
+    void set_refresh_rate(double hz);
+
+    // the view changed and needs a new frame
+    void request(clock::time_point now);
+
+    bool due(clock::time_point now) const;
+    void frame_rendered(clock::time_point now);
+    // the renderer had no free frame, try again shortly
+    void frame_busy(clock::time_point now);
+
+    // how long the message pump may sleep, NO_TIMEOUT when idle
+    uint32_t timeout_ms(clock::time_point now) const;
+
+    // prints frame pacing statistics and starts a new measurement
+    void report(std::ostream & out);
+
+private:
+    struct Stats {
+        uint64_t requests = 0;
+        uint64_t frames = 0;
+        uint64_t busy = 0;
+        uint64_t intervals = 0;
+        double interval_sum = 0.0;
+        double interval_min = 0.0;
+        double interval_max = 0.0;
+        double latency_sum = 0.0;
+        double latency_max = 0.0;
+    };
+
+    clock::duration m_period = std::chrono::microseconds(16667);
+    clock::time_point m_next_frame;
+    clock::time_point m_last_frame;
+    clock::time_point m_first_request;
+    bool m_dirty = false;
+    bool m_has_frame = false;
+    Stats m_stats;
+};
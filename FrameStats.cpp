@@ -0,0 +1,85 @@
+#include "FrameStats.h"
+
+#include <fstream>
+
+FrameRecord & FrameStats::add(uint64_t frame) {
+    FrameRecord & record = m_records[m_count % CAPACITY];
+    record = FrameRecord();
+    record.frame = frame;
+    ++m_count;
+    return record;
+}
+
+FrameRecord * FrameStats::find(uint64_t frame) {
+    for (size_t i = 0; i < size(); ++i) {
+        FrameRecord & record = m_records[(m_count - 1 - i) % CAPACITY];
+        if (record.frame == frame) {
+            return &record;
+        }
+        if (record.frame < frame) {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+const FrameRecord & FrameStats::recent(size_t i) const {
+    return m_records[(m_count - 1 - i) % CAPACITY];
+}
+
+FrameRecord FrameStats::average(size_t n) const {
+    double FrameRecord::* fields[] = {
+        &FrameRecord::acquire_ms, &FrameRecord::record_ms, &FrameRecord::submit_ms, &FrameRecord::present_ms,
+        &FrameRecord::gpu_lines_ms, &FrameRecord::gpu_triangles_ms, &FrameRecord::input_latency_ms
+    };
+    FrameRecord avg;
+    n = n < size() ? n : size();
+    for (double FrameRecord::* field : fields) {
+        double sum = 0.0;
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) {
+            if (recent(i).*field >= 0.0) {
+                sum += recent(i).*field;
+                ++count;
+            }
+        }
+        avg.*field = count > 0 ? sum / count : -1.0;
+    }
+    return avg;
+}
+
+bool FrameStats::write_csv(const char * filename) const {
+    std::ofstream out(filename);
+    if (out.fail()) {
+        return false;
+    }
+    out << "frame,acquire_ms,record_ms,submit_ms,present_ms,gpu_lines_ms,gpu_triangles_ms,input_latency_ms\n";
+    for (size_t i = size(); i-- > 0; ) {
+        const FrameRecord & r = recent(i);
+        out << r.frame << ',' << r.acquire_ms << ',' << r.record_ms << ',' << r.submit_ms << ',' << r.present_ms
+            << ',' << r.gpu_lines_ms << ',' << r.gpu_triangles_ms << ',' << r.input_latency_ms << '\n';
+    }
+    return !out.fail();
+}
+
+bool FrameStats::write_json(const char * filename) const {
+    std::ofstream out(filename);
+    if (out.fail()) {
+        return false;
+    }
+    out << "[\n";
+    for (size_t i = size(); i-- > 0; ) {
+        const FrameRecord & r = recent(i);
+        out << "  {\"frame\":" << r.frame
+            << ",\"acquire_ms\":" << r.acquire_ms
+            << ",\"record_ms\":" << r.record_ms
+            << ",\"submit_ms\":" << r.submit_ms
+            << ",\"present_ms\":" << r.present_ms
+            << ",\"gpu_lines_ms\":" << r.gpu_lines_ms
+            << ",\"gpu_triangles_ms\":" << r.gpu_triangles_ms
+            << ",\"input_latency_ms\":" << r.input_latency_ms
+            << (i > 0 ? "},\n" : "}\n");
+    }
+    out << "]\n";
+    return !out.fail();
+}
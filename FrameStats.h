@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Timings of one presented frame, in milliseconds. Values that are not
+// known (yet) are negative; GPU times arrive a few frames late.
+struct FrameRecord {
+    uint64_t frame = 0;
+    double acquire_ms = -1.0;
+    double record_ms = -1.0;
+    double submit_ms = -1.0;
+    double present_ms = -1.0;
+    double gpu_lines_ms = -1.0;
+    double gpu_triangles_ms = -1.0;
+    double input_latency_ms = -1.0;
+};
+
+// Rolling window of the most recent frames.
+class FrameStats {
+public:
+    static constexpr size_t CAPACITY = 1024;
+
+    FrameRecord & add(uint64_t frame);
+    // nullptr if the frame has already rolled out of the window
+    FrameRecord * find(uint64_t frame);
+
+    size_t size() const { return m_count < CAPACITY ? (size_t) m_count : CAPACITY; }
+    // i = 0 is the most recent frame
+    const FrameRecord & recent(size_t i) const;
+    // averages of the known values over the most recent n frames
+    FrameRecord average(size_t n) const;
+
+    bool write_csv(const char * filename) const;
+    bool write_json(const char * filename) const;
+
+private:
+    std::vector<FrameRecord> m_records = std::vector<FrameRecord>(CAPACITY);
+    uint64_t m_count = 0;
+};
@@ -0,0 +1,164 @@
+#include "Gaps.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+std::vector<ThreadGaps> g_thread_gaps;
+
+static size_t bucket(uint64_t length) {
+    size_t b = 0;
+    while (length > 1 && b + 1 < ThreadGaps::BUCKETS) {
+        length >>= 1;
+        ++b;
+    }
+    return b;
+}
+
+// The tasks of a thread are sorted by start; nested ones end within their
+// parent, so the covered time is a running maximum of the ends.
+template <typename Visit>
+static void sweep(const std::vector<Entry *> & tasks, Visit visit_gap) {
+    uint64_t covered = tasks.empty() ? 0 : tasks[0]->start;
+    for (const Entry * e : tasks) {
+        if (e->start > covered) {
+            visit_gap(Gap{ covered, e->start - covered });
+        }
+        covered = std::max(covered, e->start + e->length);
+    }
+}
+
+void build_gap_stats() {
+    g_thread_gaps.clear();
+    for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
+        for (size_t thread = 0; thread < g_tasksperproc[proc].size(); ++thread) {
+            ThreadGaps gaps;
+            gaps.proc = proc;
+            gaps.thread = thread;
+            g_thread_gaps.push_back(gaps);
+        }
+    }
+    parallel_for(0, g_thread_gaps.size(), [](size_t i) {
+        ThreadGaps & gaps = g_thread_gaps[i];
+        const std::vector<Entry *> & tasks = g_tasksperproc[gaps.proc][gaps.thread];
+        if (tasks.empty()) {
+            return;
+        }
+        gaps.begin = tasks[0]->start;
+        gaps.end = gaps.begin;
+        for (const Entry * e : tasks) {
+            gaps.end = std::max(gaps.end, e->start + e->length);
+        }
+        uint64_t idle = 0;
+        auto shorter = [](const Gap & a, const Gap & b) { return a.length > b.length; };
+        sweep(tasks, [&](const Gap & gap) {
+            idle += gap.length;
+            ++gaps.histogram[bucket(gap.length)];
+            // a min-heap of the longest few
+            if (gaps.longest.size() < ThreadGaps::LONGEST) {
+                gaps.longest.push_back(gap);
+                std::push_heap(gaps.longest.begin(), gaps.longest.end(), shorter);
+            } else if (gap.length > gaps.longest.front().length) {
+                std::pop_heap(gaps.longest.begin(), gaps.longest.end(), shorter);
+                gaps.longest.back() = gap;
+                std::push_heap(gaps.longest.begin(), gaps.longest.end(), shorter);
+            }
+        });
+        std::sort_heap(gaps.longest.begin(), gaps.longest.end(), shorter);
+        gaps.busy = gaps.end - gaps.begin - idle;
+    });
+}
+
+static double utilization(const ThreadGaps & gaps) {
+    return gaps.end > gaps.begin ? (double) gaps.busy / (double) (gaps.end - gaps.begin) : 0.0;
+}
+
+// Formats into a local stream, so the caller's keeps its flags.
+void print_gap_stats(std::ostream & out, bool details) {
+    std::ostringstream text;
+    for (size_t first = 0; first < g_thread_gaps.size();) {
+        size_t last = first;
+        uint64_t busy = 0;
+        uint64_t max_busy = 0;
+        while (last < g_thread_gaps.size() && g_thread_gaps[last].proc == g_thread_gaps[first].proc) {
+            busy += g_thread_gaps[last].busy;
+            max_busy = std::max(max_busy, g_thread_gaps[last].busy);
+            ++last;
+        }
+        const double mean = (double) busy / (double) (last - first);
+        text << "proc " << g_thread_gaps[first].proc << ": " << last - first << " threads, busy " << format(busy)
+            << ", imbalance " << std::setprecision(2) << std::fixed << (mean > 0.0 ? max_busy / mean : 0.0) << std::endl;
+
+        // least utilized first
+        std::vector<const ThreadGaps *> threads;
+        for (size_t i = first; i < last; ++i) {
+            threads.push_back(&g_thread_gaps[i]);
+        }
+        std::sort(threads.begin(), threads.end(), [](const ThreadGaps * a, const ThreadGaps * b) {
+            return utilization(*a) < utilization(*b);
+        });
+        for (size_t i = 0; i < threads.size() && (details || i < 4); ++i) {
+            const ThreadGaps & gaps = *threads[i];
+            text << "  thread " << std::setw(4) << gaps.thread
+                << std::setw(8) << std::setprecision(1) << 100.0 * utilization(gaps) << "%"
+                << std::setw(12) << format(gaps.busy);
+            if (!gaps.longest.empty()) {
+                text << "  longest gap " << format(gaps.longest[0].length) << " at " << format(gaps.longest[0].start);
+            }
+            text << std::endl;
+            if (!details) {
+                continue;
+            }
+            for (size_t g = 1; g < gaps.longest.size(); ++g) {
+                text << "                                    " << format(gaps.longest[g].length) << " at " << format(gaps.longest[g].start) << std::endl;
+            }
+            text << "    gaps >= 2^b ticks:";
+            for (size_t b = 0; b < ThreadGaps::BUCKETS; ++b) {
+                if (gaps.histogram[b] != 0) {
+                    text << " " << b << ":" << gaps.histogram[b];
+                }
+            }
+            text << std::endl;
+        }
+        first = last;
+    }
+    out << text.str() << std::flush;
+}
+
+std::vector<gap_t> gaps_above(uint64_t min_length, size_t max_gaps) {
+    // each thread's gaps go on the first of its rows
+    std::vector<size_t> thread_base(g_tasksperproc.size() + 1, 0);
+    for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
+        thread_base[proc + 1] = thread_base[proc] + g_tasksperproc[proc].size();
+    }
+    std::vector<uint32_t> first_row(thread_base.back(), 0);
+    for (size_t row = rowdata.size(); row-- > 0;) {
+        first_row[thread_base[rowdata[row].first] + rowdata[row].second] = (uint32_t) row;
+    }
+
+    std::vector< std::vector<Gap> > found(g_thread_gaps.size());
+    parallel_for(0, g_thread_gaps.size(), [&](size_t i) {
+        sweep(g_tasksperproc[g_thread_gaps[i].proc][g_thread_gaps[i].thread], [&](const Gap & gap) {
+            if (gap.length >= min_length) {
+                found[i].push_back(gap);
+            }
+        });
+    });
+
+    std::vector<gap_t> gaps;
+    for (size_t i = 0; i < found.size(); ++i) {
+        const uint32_t row = first_row[thread_base[g_thread_gaps[i].proc] + g_thread_gaps[i].thread];
+        for (const Gap & gap : found[i]) {
+            gaps.push_back({ 1e-3f * (float) gap.start, 1e-3f * (float) (gap.start + gap.length), row, 0 });
+        }
+    }
+    if (gaps.size() > max_gaps) {
+        std::nth_element(gaps.begin(), gaps.begin() + max_gaps, gaps.end(), [](const gap_t & a, const gap_t & b) {
+            return a.x1 - a.x0 > b.x1 - b.x0;
+        });
+        gaps.resize(max_gaps);
+    }
+    return gaps;
+}
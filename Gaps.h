@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "VertexData.h"
+
+// Idle time between the tasks of each thread: whatever no task of the
+// thread covers between its first start and its last end.
+
+struct Gap {
+    uint64_t start = 0;
+    uint64_t length = 0;
+};
+
+struct ThreadGaps {
+    static constexpr size_t LONGEST = 5;
+    static constexpr size_t BUCKETS = 40;   // bucket b: lengths in [2^b, 2^(b+1))
+
+    uint64_t proc = 0;
+    uint64_t thread = 0;
+    uint64_t begin = 0;         // first start
+    uint64_t end = 0;           // last end
+    uint64_t busy = 0;          // covered by at least one task
+    std::vector<Gap> longest;   // longest first
+    uint64_t histogram[BUCKETS] = {};
+};
+
+// One entry per thread, in g_tasksperproc order.
+extern std::vector<ThreadGaps> g_thread_gaps;
+
+// One parallel sweep over every thread's tasks.
+void build_gap_stats();
+
+// Per process: load imbalance (max thread busy time over the mean) and
+// the least utilized threads; with details, every thread's longest gaps
+// and histogram as well.
+void print_gap_stats(std::ostream & out, bool details);
+
+// Gaps of at least min_length as quads on the first row of their thread,
+// the longest max_gaps of them.
+std::vector<gap_t> gaps_above(uint64_t min_length, size_t max_gaps);
@@ -0,0 +1,121 @@
+#include "Layout.h"
+#include "Counters.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <limits>
+
+std::vector<uint32_t> g_slot_tasks;
+std::vector<uint8_t> g_collapsed;
+
+static const float rowheight = 1.0f;
+static const float barheight = 0.8f;
+static const float thread_distance = 0.5f;
+static const float proc_distance = 2.5f;
+
+static std::vector<float> g_slot_y;
+// visible slots top to bottom and their centre lines
+static std::vector<uint32_t> g_order;
+static std::vector<float> g_order_y;
+
+size_t slot_count() {
+    return rowdata.size() + g_tasksperproc.size() + g_counters.size();
+}
+
+uint32_t summary_slot(size_t proc) {
+    return (uint32_t) (rowdata.size() + proc);
+}
+
+void update_layout() {
+    g_collapsed.resize(g_tasksperproc.size(), 0);
+    g_slot_y.assign(slot_count(), std::numeric_limits<float>::quiet_NaN());
+    g_order.clear();
+    g_order_y.clear();
+
+    auto place = [](uint32_t slot, float y) {
+        g_slot_y[slot] = y;
+        g_order.push_back(slot);
+        g_order_y.push_back(y);
+    };
+
+    // rows are grouped by process and thread, in order
+    float y = 0.5f;
+    size_t row = 0;
+    for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
+        if (g_collapsed[proc]) {
+            place(summary_slot(proc), y);
+            for (; row < rowdata.size() && rowdata[row].first == proc; ++row) {
+                rowpos[row] = y;
+            }
+            y += rowheight + proc_distance;
+            continue;
+        }
+        while (row < rowdata.size() && rowdata[row].first == proc) {
+            const uint64_t thread = rowdata[row].second;
+            for (; row < rowdata.size() && rowdata[row].first == proc && rowdata[row].second == thread; ++row) {
+                rowpos[row] = y;
+                place((uint32_t) row, y);
+                y += rowheight;
+            }
+            y += thread_distance;
+        }
+        // counter graphs span two rows below the threads
+        for (size_t counter = 0; counter < g_counters.size(); ++counter) {
+            if (g_counters[counter].proc == proc) {
+                place(counter_slot(counter), y + rowheight / 2.0f);
+                y += 2.0f * rowheight + thread_distance;
+            }
+        }
+        y += proc_distance;
+    }
+}
+
+bool row_visible(size_t row) {
+    return row < rowdata.size() && !g_collapsed[rowdata[row].first];
+}
+
+const std::vector<float> & slot_offsets() {
+    return g_slot_y;
+}
+
+void layout_bounds(float & y0, float & y1) {
+    if (g_order_y.empty()) {
+        y0 = 0.0f;
+        y1 = 0.0f;
+        return;
+    }
+    y0 = g_order_y.front() - barheight / 2.0f;
+    y1 = g_order_y.back() + barheight / 2.0f;
+}
+
+void visible_task_ranges(float y0, float y1, const std::vector<uint32_t> & slot_tasks, size_t max_ranges,
+                         std::vector< std::pair<uint32_t, uint32_t> > & ranges) {
+    ranges.clear();
+    const size_t first = std::lower_bound(g_order_y.begin(), g_order_y.end(), y0 - barheight / 2.0f) - g_order_y.begin();
+    const size_t last = std::upper_bound(g_order_y.begin(), g_order_y.end(), y1 + barheight / 2.0f) - g_order_y.begin();
+    for (size_t i = first; i < last; ++i) {
+        const uint32_t slot = g_order[i];
+        if (slot + 1 >= slot_tasks.size()) {
+            continue;
+        }
+        const uint32_t begin = slot_tasks[slot];
+        const uint32_t end = slot_tasks[slot + 1];
+        if (begin == end) {
+            continue;
+        }
+        if (!ranges.empty() && ranges.back().first + ranges.back().second == begin) {
+            ranges.back().second += end - begin;
+        } else {
+            ranges.push_back(std::make_pair(begin, end - begin));
+        }
+    }
+    if (ranges.size() > max_ranges) {
+        uint32_t begin = UINT32_MAX;
+        uint32_t end = 0;
+        for (const auto & range : ranges) {
+            begin = std::min(begin, range.first);
+            end = std::max(end, range.first + range.second);
+        }
+        ranges.assign(1, std::make_pair(begin, end - begin));
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+// Vertical placement of the rows. Every row of Trace.h has a layout slot,
+// followed by one slot per process for the summary row that stands in for
+// its threads while the process is collapsed, and one slot per counter
+// track of Counters.h. Vertices carry their slot and are offset by the
+// slot's y on the GPU, so collapsing processes only uploads a new table of
+// offsets; the geometry stays as it is.
+
+// vertices placed by their own y, as the preview's are
+const uint32_t NO_SLOT = UINT32_MAX;
+// name_index of the bars of a summary row
+const uint32_t SUMMARY_NAME = UINT32_MAX;
+
+// First task (vertex index / 3) of every slot in the uploaded geometry,
+// plus the end. Filled by generate_triangles().
+extern std::vector<uint32_t> g_slot_tasks;
+// per process
+extern std::vector<uint8_t> g_collapsed;
+
+size_t slot_count();
+uint32_t summary_slot(size_t proc);
+
+// Places the slots top to bottom according to g_collapsed and moves rowpos
+// along; the rows of a collapsed process take the position of its summary.
+void update_layout();
+bool row_visible(size_t row);
+// y of every slot, NaN for hidden ones, for Render::set_rows()
+const std::vector<float> & slot_offsets();
+// top and bottom edge of the rows
+void layout_bounds(float & y0, float & y1);
+
+// Ranges (first task, task count) of the slots visible between y0 and y1,
+// in index lists that keep the tasks of a slot together as slot_tasks
+// describes. Adjacent ranges are merged; if more than max_ranges remain,
+// a single range spans all of them.
+void visible_task_ranges(float y0, float y1, const std::vector<uint32_t> & slot_tasks, size_t max_ranges,
+                         std::vector< std::pair<uint32_t, uint32_t> > & ranges);
@@ -0,0 +1,111 @@
+#include "Longest.h"
+
+std::vector<TaskRef> g_longest;
+std::vector< std::vector<TaskRef> > g_longest_by_name;
+
+// the order of build_trace()
+static bool before(const TaskKey & a, const TaskKey & b) {
+    if (a.proc != b.proc) {
+        return a.proc < b.proc;
+    }
+    if (a.thread != b.thread) {
+        return a.thread < b.thread;
+    }
+    if (a.start != b.start) {
+        return a.start < b.start;
+    }
+    return a.length > b.length;
+}
+
+static bool same(const TaskKey & a, const TaskKey & b) {
+    return a.proc == b.proc && a.thread == b.thread && a.start == b.start && a.length == b.length;
+}
+
+static TaskKey key_of(const Entry & e) {
+    return TaskKey{ e.proc, e.thread, e.start, e.length };
+}
+
+// A task on both an overall and a per-name list is kept once; tasks that
+// are merely identical were pushed once per list they made, so the larger
+// count of the two stands.
+std::vector<TaskKey> LongestTasks::candidates() const {
+    std::vector<TaskKey> by_name;
+    for (const std::vector<Item> & heap : m_by_name) {
+        for (const Item & item : heap) {
+            by_name.push_back(item.key);
+        }
+    }
+    std::vector<TaskKey> overall;
+    for (const Item & item : m_overall) {
+        overall.push_back(item.key);
+    }
+    std::sort(by_name.begin(), by_name.end(), before);
+    std::sort(overall.begin(), overall.end(), before);
+    std::vector<TaskKey> keys;
+    std::set_union(by_name.begin(), by_name.end(), overall.begin(), overall.end(), std::back_inserter(keys), before);
+    return keys;
+}
+
+std::vector<Entry *> find_tasks(std::vector<Entry> & tasks, std::vector<TaskKey> keys) {
+    std::sort(keys.begin(), keys.end(), before);
+    std::vector<Entry *> found;
+    size_t previous = tasks.size();
+    for (size_t k = 0; k < keys.size(); ++k) {
+        // a repeated key takes the next of the identical tasks
+        size_t i = k > 0 && same(keys[k], keys[k - 1]) && previous < tasks.size() ? previous + 1 :
+            std::lower_bound(tasks.begin(), tasks.end(), keys[k], [](const Entry & e, const TaskKey & key) {
+                return before(key_of(e), key);
+            }) - tasks.begin();
+        if (i < tasks.size() && same(key_of(tasks[i]), keys[k])) {
+            found.push_back(&tasks[i]);
+            previous = i;
+        } else {
+            previous = tasks.size();
+        }
+    }
+    return found;
+}
+
+void build_longest(const std::vector<Entry *> & candidates) {
+    std::vector<Entry *> sorted = candidates;
+    std::sort(sorted.begin(), sorted.end(), [](const Entry * a, const Entry * b) {
+        return a->length > b->length;
+    });
+
+    // the rows of a thread follow its first row, one per depth
+    std::vector<size_t> thread_base(g_tasksperproc.size() + 1, 0);
+    for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
+        thread_base[proc + 1] = thread_base[proc] + g_tasksperproc[proc].size();
+    }
+    std::vector<uint32_t> first_row(thread_base.back(), 0);
+    for (size_t row = rowdata.size(); row-- > 0;) {
+        first_row[thread_base[rowdata[row].first] + rowdata[row].second] = (uint32_t) row;
+    }
+    auto locate = [&](const Entry * e) {
+        const uint32_t row = first_row[thread_base[e->proc] + e->thread] + e->depth;
+        const std::vector<Entry *> & tasks = g_rowtasks[row];
+        auto it = std::lower_bound(tasks.begin(), tasks.end(), e->start, [](const Entry * t, uint64_t start) {
+            return t->start < start;
+        });
+        while (it != tasks.end() && *it != e) {
+            ++it;
+        }
+        return it != tasks.end() ? TaskRef{ row, (uint32_t) (it - tasks.begin()) } : TaskRef{ UINT32_MAX, 0 };
+    };
+
+    g_longest.clear();
+    g_longest_by_name.assign(g_names.size(), std::vector<TaskRef>());
+    for (const Entry * e : sorted) {
+        const TaskRef ref = locate(e);
+        if (ref.row == UINT32_MAX) {
+            continue;
+        }
+        if (g_longest.size() < LongestTasks::OVERALL) {
+            g_longest.push_back(ref);
+        }
+        std::vector<TaskRef> & by_name = g_longest_by_name[e->name_index];
+        if (by_name.size() < LongestTasks::PER_NAME) {
+            by_name.push_back(ref);
+        }
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Search.h"
+#include "Trace.h"
+
+// A task by the fields g_alltasks is sorted on, with the reader's
+// original proc and thread. Unlike an index it stays valid while the tasks
+// are sorted and merged.
+struct TaskKey {
+    uint64_t proc;
+    uint64_t thread;
+    uint64_t start;
+    uint64_t length;
+};
+
+// The longest tasks, overall and per name, ready as soon as loading is
+// done. Readers feed every task to a LongestTasks while parsing, which
+// costs one comparison for all but a few tasks; the candidates it keeps
+// are found again in the sorted task array.
+class LongestTasks {
+public:
+    static constexpr size_t PER_NAME = 16;
+    static constexpr size_t OVERALL = 256;
+
+    void add(const Entry & e) {
+        if (e.name_index >= m_by_name.size()) {
+            m_by_name.resize(e.name_index + 1);
+        }
+        const TaskKey key{ e.proc, e.thread, e.start, e.length };
+        push(m_by_name[e.name_index], PER_NAME, key);
+        push(m_overall, OVERALL, key);
+    }
+
+    // every task on one of the lists or more, each once
+    std::vector<TaskKey> candidates() const;
+
+private:
+    struct Item {
+        TaskKey key;
+        bool operator<(const Item & other) const { return key.length > other.key.length; }
+    };
+
+    // min-heaps of the longest tasks so far
+    static void push(std::vector<Item> & heap, size_t capacity, const TaskKey & key) {
+        if (heap.size() == capacity) {
+            if (key.length <= heap.front().key.length) {
+                return;
+            }
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = Item{ key };
+        } else {
+            heap.push_back(Item{ key });
+        }
+        std::push_heap(heap.begin(), heap.end());
+    }
+
+    std::vector< std::vector<Item> > m_by_name;
+    std::vector<Item> m_overall;
+};
+
+// Longest first. Set by build_longest() once the rows exist.
+extern std::vector<TaskRef> g_longest;
+extern std::vector< std::vector<TaskRef> > g_longest_by_name;
+
+// The tasks of the keys, in tasks sorted by proc, thread, start and
+// decreasing length as build_trace() sorts them; keys of identical tasks
+// find as many of them. Binary searches, before proc and thread are
+// renumbered.
+std::vector<Entry *> find_tasks(std::vector<Entry> & tasks, std::vector<TaskKey> keys);
+
+// Picks the lists from the candidates, which may come from several
+// readers, and locates them in the rows.
+void build_longest(const std::vector<Entry *> & candidates);
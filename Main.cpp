@@ -1,17 +1,109 @@
 #include "Renderer.h"
+#include "FrameScheduler.h"
+#include "Counters.h"
+#include "Diff.h"
+#include "Export.h"
+#include "Filter.h"
+#include "FrameStats.h"
+#include "Gaps.h"
+#include "Layout.h"
+#include "Longest.h"
+#include "Minimap.h"
+#include "Palette.h"
+#include "Query.h"
+#include "Picking.h"
+#include "RangeStats.h"
+#include "Search.h"
+#include "TileCache.h"
+#include "Tiles.h"
+#include "Trace.h"
 
 #define NOMINMAX
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <windowsx.h>
+#include <mmsystem.h>
 #include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
 #include <unordered_map>
 #include <iostream>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <functional>
 
 const wchar_t * title = L"PerfViewer";
 const wchar_t * window_class = L"PerfViewer";
 
+#define WM_APP_PARSED       (WM_APP + 1)
+#define WM_APP_RENDER_READY (WM_APP + 2)
+#define WM_APP_PREVIEW      (WM_APP + 3)
+#define WM_APP_COMMAND      (WM_APP + 4)
+const UINT_PTR PROGRESS_TIMER = 1;
+const UINT_PTR MODAL_FRAME_TIMER = 2;
+const UINT_PTR STATS_TIMER = 3;
+
+#pragma comment( lib, "winmm.lib" )
+
 Render g_render;
+FrameScheduler g_scheduler;
+FrameStats g_frame_stats;
+
+// oldest mouse input not yet reflected in a presented frame
+FrameScheduler::clock::time_point g_input_time;
+bool g_input_pending = false;
+
+struct PresentModeName {
+    const char * name;
+    VkPresentModeKHR mode;
+};
+const PresentModeName present_modes[] = {
+    { "fifo",      VK_PRESENT_MODE_FIFO_KHR },
+    { "mailbox",   VK_PRESENT_MODE_MAILBOX_KHR },
+    { "immediate", VK_PRESENT_MODE_IMMEDIATE_KHR },
+};
+
+// Parsing and Vulkan setup run on their own threads; the geometry is uploaded
+// on the window thread once both have finished. Preview chunks published by
+// the parser are queued until the renderer can take them.
+struct Loader {
+    std::vector<vertex_t> vertices;
+    std::vector<uint32_t> indices_line;
+    std::vector<uint32_t> indices_tri;
+    std::mutex preview_mutex;
+    std::vector<geometry_t> previews;
+    bool parsed = false;
+    bool initialized = false;
+    bool has_bounds = false;
+    bool view_touched = false;
+};
+Loader g_loader;
+bool g_ready = false;
+ColorMode g_color_mode = ColorMode::name;
+TaskFilter g_filter;
+// first task of every layout slot in the filtered index lists
+std::vector<uint32_t> g_filtered_slot_tasks;
+bool g_filtered = false;
+MinimapImage g_minimap;
+// The heatmap replaces the tasks when they get denser than a few per pixel,
+// unless it is forced either way.
+enum class HeatMode { automatic, on, off };
+HeatMode g_heat_mode = HeatMode::automatic;
+// most idle gaps highlighted at once, the longest win
+const size_t MAX_GAPS = 1 << 20;
+// the tasks last printed by the longest command, for jump
+std::vector<TaskRef> g_listed;
+// Tile files are browsed through a fixed pool of GPU memory instead of
+// being loaded; see Tiles.h.
+bool g_tiled = false;
+TileFile g_tile_file;
+TileCache g_tile_cache;
+const uint64_t TILE_POOL_BYTES = 512ull << 20;
+const uint32_t TILE_LOADER_THREADS = 2;
 
 bool selection = false;
 RECT g_rect;
@@ -23,31 +115,29 @@ uint64_t g_selrowidx = 0;
 uint64_t g_seltask = 0;
 
 float selectionx0, selectionx1;
-float g_seltime;
-
-struct Entry {
-    uint64_t proc = 0;
-    uint64_t thread = 0;
-    uint64_t start = 0;
-    uint64_t length = 0;
-    uint32_t name_index = 0;
-    uint32_t vert_index = 0;
-};
+const Entry * g_hover = nullptr;
 
-extern std::vector< float > rowpos;
-extern std::vector< std::pair< uint64_t, uint64_t > > rowdata;
-extern std::vector< std::vector< std::vector< Entry * > > > g_tasksperproc;
-extern std::string format(uint64_t a);
-extern std::vector<std::string> g_names;
+// shift + left drag selects a time range
+bool g_range_drag = false;
+uint64_t g_range_start = 0;
+uint64_t g_range_end = 0;
 
-void select_task(unsigned long long proc, unsigned long long thread, size_t pos) {
-    std::vector<Entry *> &tasks(g_tasksperproc[proc][thread]);
+// names matched by the last search, empty if there is none
+std::vector<uint32_t> g_search;
+
+extern std::atomic<int> g_load_progress;
+extern std::atomic<const char *> g_load_stage;
+extern std::atomic<bool> g_load_cancel;
+
+void select_task(size_t row, size_t pos) {
+    std::vector<Entry *> &tasks(g_rowtasks[row]);
+    g_selrowidx = row;
     g_seltask = pos;
     selection = true;
 
     const int index = tasks[pos]->name_index;
     const std::string & name = g_names[index];
-    std::cout << "(" << proc << ", " << thread
+    std::cout << "(" << rowdata[row].first << ", " << rowdata[row].second << ", depth " << rowdepth[row]
         << ") [ " << format(tasks[pos]->start)
         << ", " << format(tasks[pos]->length) << " ]"
         << " name=[" << name << "]"
@@ -58,43 +148,403 @@ void select_task(unsigned long long proc, unsigned long long thread, size_t pos)
     selectionx1 = (float) (tasks[pos]->start + tasks[pos]->length);
 }
 
-void find_task(size_t rowidx, float time, uint64_t &proc, uint64_t &thread, size_t &pos) {
-    if (rowdata.size() <= rowidx)
+static std::vector<Entry *> & row_tasks(size_t row) {
+    return g_rowtasks[row];
+}
+
+static void set_task_bit(std::vector<uint32_t> & bits, const Entry & e) {
+    const uint32_t task = e.vert_index / 3;
+    bits[task >> 5] |= 1u << (task & 31);
+}
+
+// Highlights every task pred accepts. Only the bitset goes to the GPU, the
+// geometry is left alone.
+template <typename Pred>
+static size_t highlight_tasks(Pred pred) {
+    std::vector<uint32_t> bits((g_alltasks.size() + 31) / 32, 0);
+    size_t count = 0;
+    for (const Entry & e : g_alltasks) {
+        if (!pred(e)) {
+            continue;
+        }
+        set_task_bit(bits, e);
+        ++count;
+    }
+    if (count == 0) {
+        bits.clear();
+    }
+    g_render.set_highlight(bits);
+    return count;
+}
+
+// Same for a set of names, through the inverted index instead of a scan.
+static size_t highlight_names(const std::vector<uint32_t> & name_indices) {
+    std::vector<uint32_t> bits;
+    const size_t count = count_occurrences(name_indices);
+    if (count > 0) {
+        bits.resize((g_alltasks.size() + 31) / 32, 0);
+        for (uint32_t name_index : name_indices) {
+            for (const TaskRef & ref : g_name_tasks[name_index]) {
+                set_task_bit(bits, *row_tasks(ref.row)[ref.pos]);
+            }
+        }
+    }
+    g_render.set_highlight(bits);
+    return count;
+}
+
+static const Entry * selected_task() {
+    if (!selection || g_selrowidx >= rowdata.size()) {
+        return nullptr;
+    }
+    const std::vector<Entry *> & tasks(row_tasks(g_selrowidx));
+    return g_seltask < tasks.size() ? tasks[g_seltask] : nullptr;
+}
+
+// Selects the task of row closest to time; false if the row is empty or collapsed.
+static bool select_in_row(size_t row, uint64_t time) {
+    size_t pos;
+    if (!row_visible(row) || !pick_task(row, time, pos)) {
+        return false;
+    }
+    select_task(row, pos);
+    return true;
+}
+
+// middle of the selected task, where up/down look for a task in the next row
+static uint64_t selected_time() {
+    const Entry * task = selected_task();
+    return task != nullptr ? task->start + task->length / 2 : 0;
+}
+
+// Shows the task under the mouse in the title bar, only when it changes.
+static void hover(HWND hwnd, float x, float y) {
+    const Entry * task = nullptr;
+    const size_t row = pick_row(y);
+    const uint64_t time = x_to_time(x);
+    size_t pos;
+    if (row != NO_ROW && row_distance(row, y) < 0.5f && pick_task(row, time, pos)) {
+        const Entry * e = row_tasks(row)[pos];
+        if (e->start <= time && time < e->start + e->length) {
+            task = e;
+        }
+    }
+    if (task == g_hover) {
         return;
+    }
+    g_hover = task;
+    if (task == nullptr) {
+        SetWindowTextW(hwnd, title);
+        return;
+    }
+    const std::string text = "PerfViewer - " + g_names[task->name_index] + " [ " + format(task->start) + ", " + format(task->length) + " ]";
+    SetWindowTextA(hwnd, text.c_str());
+}
 
-    proc = rowdata[rowidx].first;
-    thread = rowdata[rowidx].second;
+static void show_range(HWND hwnd) {
+    const uint64_t t0 = std::min(g_range_start, g_range_end);
+    const uint64_t t1 = std::max(g_range_start, g_range_end);
+    const RangeStats stats = range_stats(t0, t1, false);
+    uint64_t busy = 0;
+    for (const ThreadStats & thread : stats.threads) {
+        busy += thread.busy;
+    }
+    char text[256];
+    snprintf(text, sizeof(text), "PerfViewer - range %s + %s  busy %.1f%%", format(t0).c_str(), format(t1 - t0).c_str(),
+        t1 > t0 && !stats.threads.empty() ? 100.0 * busy / ((double) (t1 - t0) * stats.threads.size()) : 0.0);
+    SetWindowTextA(hwnd, text);
+}
 
-    std::vector<Entry *> &tasks(g_tasksperproc[proc][thread]);
+// Collapses or expands processes; only the slot offsets go to the GPU.
+static void set_collapsed(size_t proc, bool collapsed) {
+    for (size_t i = 0; i < g_collapsed.size(); ++i) {
+        if (proc == SIZE_MAX || i == proc) {
+            g_collapsed[i] = collapsed ? 1 : 0;
+        }
+    }
+    update_layout();
+    g_render.set_slots(slot_offsets());
+}
 
-    size_t a = 0;
-    size_t b = tasks.size()-1;
-    pos = (a+b)/2;
+// Selects the task and centres the view on it, keeping the zoom.
+static void focus_task(TaskRef ref) {
+    if (!row_visible(ref.row)) {
+        set_collapsed(rowdata[ref.row].first, false);
+    }
+    select_task(ref.row, ref.pos);
+    g_render.m_x = -g_render.m_sx * 1e-3f * (selectionx0 + selectionx1) / 2.0f;
+    g_render.m_y = -g_render.m_sy * rowpos[ref.row];
+    g_loader.view_touched = true;
+}
 
-    while (b >= a) {
-        pos = (a+b)/2;
-        if (1e-3f*tasks[pos]->start > time) {
-            if (pos == 0)
-                break;
-            b = pos-1;
-            continue;
+// Steps through the tasks named like the last search, or like the selected
+// task if there is no search.
+static void jump_to_occurrence(bool forward) {
+    std::vector<uint32_t> selected_name;
+    const std::vector<uint32_t> * names = &g_search;
+    if (names->empty()) {
+        const Entry * task = selected_task();
+        if (task == nullptr) {
+            return;
         }
-        if (1e-3f*tasks[pos]->start + 1e-3f*tasks[pos]->length < time) {
-            a = pos+1;
-            continue;
+        selected_name.push_back(task->name_index);
+        names = &selected_name;
+    }
+    TaskRef from{ (uint32_t) g_selrowidx, (uint32_t) g_seltask };
+    if (!selection) {
+        // nothing lies beyond either end, so this wraps to the first or last task
+        from = forward ? TaskRef{ UINT32_MAX, UINT32_MAX } : TaskRef{ 0, 0 };
+    }
+    TaskRef next;
+    if (next_occurrence(*names, from, forward, next)) {
+        focus_task(next);
+    }
+}
+
+static void apply_palette() {
+    bool by_process = false;
+    const std::vector<color_t> colors = build_palette(g_color_mode, by_process);
+    g_render.set_palette(colors, by_process);
+}
+
+static void apply_filter() {
+    if (!g_filter.active()) {
+        g_filtered = false;
+        g_render.reset_indices();
+        std::cout << "showing all " << g_alltasks.size() << " tasks" << std::endl;
+        return;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<uint32_t> indices_line;
+    std::vector<uint32_t> indices_tri;
+    const size_t visible = build_filtered_indices(g_filter, indices_line, indices_tri, g_filtered_slot_tasks);
+    g_filtered = true;
+    g_render.set_indices(indices_line, indices_tri);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "showing " << visible << " of " << g_alltasks.size() << " tasks (" << ms << " ms)" << std::endl;
+}
+
+static void hide_names(const std::vector<uint32_t> & names, bool hide) {
+    g_filter.hidden_names.resize(g_names.size(), 0);
+    for (uint32_t name_index : names) {
+        g_filter.hidden_names[name_index] = hide ? 1 : 0;
+    }
+    apply_filter();
+}
+
+// A time in the units format() prints, i.e. a millionth of the trace's
+// ticks. false if text is not a number.
+static bool parse_time(const std::string & text, uint64_t & time) {
+    char * end = nullptr;
+    const double value = strtod(text.c_str(), &end);
+    if (text.empty() || *end != '\0' || value < 0.0) {
+        return false;
+    }
+    time = (uint64_t) llround(value * 1e6);
+    return true;
+}
+
+// "rrggbb" as a colour, false if it is not six hex digits
+static bool parse_color(const std::string & text, color_t & color) {
+    if (text.size() != 6 || text.find_first_not_of("0123456789abcdefABCDEF") != std::string::npos) {
+        return false;
+    }
+    const unsigned long rgb = std::stoul(text, nullptr, 16);
+    color = color_t{ ((rgb >> 16) & 0xff) / 255.0f, ((rgb >> 8) & 0xff) / 255.0f, (rgb & 0xff) / 255.0f };
+    return true;
+}
+
+// Console commands:
+//   find <text>             tasks whose name contains text
+//   regex <expr>            tasks whose name matches expr
+//   clear                   drop the search and the highlight
+//   color <text> <rrggbb>   custom colour for the names containing text
+//   color clear             drop the custom colours
+//   hide <text>             hide the names containing text
+//   show <text>             show them again
+//   length <min> [<max>]    hide tasks outside [min, max]
+//   filter clear            show every task
+//   collapse <proc>|all     show the process as one busy row
+//   expand <proc>|all       show its threads again
+static void run_command(const std::string & line) {
+    const size_t split = line.find(' ');
+    const std::string command = line.substr(0, split);
+    const std::string argument = split == std::string::npos ? std::string() : line.substr(split + 1);
+
+    if (command == "clear") {
+        g_search.clear();
+        g_render.set_highlight({});
+        return;
+    }
+    if ((command == "find" || command == "regex") && !argument.empty()) {
+        const auto start = std::chrono::steady_clock::now();
+        g_search = search_names(g_names, argument, command == "regex");
+        const size_t count = highlight_names(g_search);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << g_search.size() << " names, " << count << " tasks (" << ms << " ms)" << std::endl;
+        for (size_t i = 0; i < g_search.size() && i < 10; ++i) {
+            std::cout << "  " << g_names[g_search[i]] << " x " << g_name_tasks[g_search[i]].size() << std::endl;
         }
-        break;
+        selection = false;
+        jump_to_occurrence(true);
+        return;
     }
-    if (pos > 0) {
-        if (fabs(time - 1e-3f*tasks[pos-1]->start + 1e-3f*tasks[pos-1]->length) <
-            fabs(time - 1e-3f*tasks[pos]->start))
-            pos = pos - 1;
+    if (command == "color" && !argument.empty()) {
+        if (argument == "clear") {
+            clear_custom_colors();
+            apply_palette();
+            return;
+        }
+        const size_t last = argument.rfind(' ');
+        color_t color;
+        if (last != std::string::npos && parse_color(argument.substr(last + 1), color)) {
+            const std::vector<uint32_t> names = search_names(g_names, argument.substr(0, last), false);
+            for (uint32_t name_index : names) {
+                set_custom_color(name_index, color);
+            }
+            g_color_mode = ColorMode::custom;
+            apply_palette();
+            std::cout << "coloured " << names.size() << " names" << std::endl;
+            return;
+        }
     }
-    if (pos < tasks.size()-1) {
-        if (fabs(time - 1e-3f*tasks[pos+1]->start) <
-            fabs(time - (1e-3f*tasks[pos]->start+1e-3f*tasks[pos]->length)))
-            pos = pos + 1;
+    if ((command == "hide" || command == "show") && !argument.empty()) {
+        hide_names(search_names(g_names, argument, false), command == "hide");
+        return;
+    }
+    if (command == "length" && !argument.empty()) {
+        const size_t space = argument.find(' ');
+        uint64_t min_length = 0;
+        uint64_t max_length = UINT64_MAX;
+        if (parse_time(argument.substr(0, space), min_length) &&
+            (space == std::string::npos || parse_time(argument.substr(space + 1), max_length))) {
+            g_filter.min_length = min_length;
+            g_filter.max_length = max_length;
+            apply_filter();
+            return;
+        }
     }
+    if (command == "filter" && argument == "clear") {
+        g_filter = TaskFilter();
+        apply_filter();
+        return;
+    }
+    if ((command == "collapse" || command == "expand") && !argument.empty()) {
+        size_t proc = SIZE_MAX;
+        if (argument == "all" || (sscanf(argument.c_str(), "%zu", &proc) == 1 && proc < g_collapsed.size())) {
+            set_collapsed(proc, command == "collapse");
+            return;
+        }
+    }
+    if (command == "diff") {
+        size_t count = 40;
+        if (argument.empty() || (sscanf(argument.c_str(), "%zu", &count) == 1 && count > 0)) {
+            if (g_name_diff.empty()) {
+                std::cout << "no diff, start with --diff=<candidate>" << std::endl;
+            } else {
+                print_name_diff(g_name_diff, count, std::cout);
+            }
+            return;
+        }
+    }
+    if (command == "export" && !argument.empty()) {
+        // the selected time range if there is one, else everything
+        uint64_t t0 = std::min(g_range_start, g_range_end);
+        uint64_t t1 = std::max(g_range_start, g_range_end);
+        if (t1 <= t0) {
+            t0 = 0;
+            t1 = UINT64_MAX;
+        }
+        const bool json = argument.size() >= 5 && argument.compare(argument.size() - 5, 5, ".json") == 0;
+        const auto start = std::chrono::steady_clock::now();
+        if (json ? export_chrome_trace(argument.c_str(), t0, t1) : export_perfetto(argument.c_str(), t0, t1)) {
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "wrote " << argument << " (" << ms << " ms)" << std::endl;
+        }
+        return;
+    }
+    if (command == "crop" && !argument.empty()) {
+        const uint64_t t0 = std::min(g_range_start, g_range_end);
+        const uint64_t t1 = std::max(g_range_start, g_range_end);
+        if (t1 <= t0) {
+            std::cout << "select a range with shift + drag first" << std::endl;
+            return;
+        }
+        if (export_log(argument.c_str(), t0, t1)) {
+            std::cout << "wrote " << argument << std::endl;
+        }
+        return;
+    }
+    if (command == "query" && !argument.empty()) {
+        Query query;
+        std::string error;
+        if (!parse_query(argument, query, error)) {
+            std::cout << error << std::endl;
+            return;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const QueryResult result = run_query(query);
+        const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        print_query_result(query, result, std::cout);
+        std::cout << "(" << ms << " ms)" << std::endl;
+        return;
+    }
+    if ((command == "gaps" || command == "longest" || command == "jump") && g_tiled) {
+        // tile files keep no tasks in memory to measure
+        std::cout << command << " needs a loaded trace, not a tile file" << std::endl;
+        return;
+    }
+    if (command == "gaps") {
+        if (argument.empty()) {
+            print_gap_stats(std::cout, true);
+            return;
+        }
+        if (argument == "off") {
+            g_render.set_gaps({});
+            return;
+        }
+        uint64_t min_length = 0;
+        if (parse_time(argument, min_length) && min_length > 0) {
+            const std::vector<gap_t> gaps = gaps_above(min_length, MAX_GAPS);
+            g_render.set_gaps(gaps);
+            std::cout << gaps.size() << " gaps highlighted" << std::endl;
+            return;
+        }
+    }
+    if (command == "longest") {
+        // overall, or merged from the lists of the matching names
+        g_listed.clear();
+        if (argument.empty()) {
+            g_listed = g_longest;
+        } else {
+            for (uint32_t name_index : search_names(g_names, argument, false)) {
+                g_listed.insert(g_listed.end(), g_longest_by_name[name_index].begin(), g_longest_by_name[name_index].end());
+            }
+            std::sort(g_listed.begin(), g_listed.end(), [](const TaskRef & a, const TaskRef & b) {
+                return g_rowtasks[a.row][a.pos]->length > g_rowtasks[b.row][b.pos]->length;
+            });
+        }
+        if (g_listed.size() > 20) {
+            g_listed.resize(20);
+        }
+        for (size_t i = 0; i < g_listed.size(); ++i) {
+            const Entry * e = g_rowtasks[g_listed[i].row][g_listed[i].pos];
+            std::cout << std::setw(4) << i << std::setw(12) << format(e->length) << "  " << g_names[e->name_index]
+                      << " (" << e->proc << ", " << e->thread << ") at " << format(e->start) << std::endl;
+        }
+        return;
+    }
+    if (command == "jump" && !argument.empty()) {
+        size_t i = 0;
+        if (sscanf(argument.c_str(), "%zu", &i) == 1 && i < g_listed.size()) {
+            focus_task(g_listed[i]);
+            return;
+        }
+    }
+    std::cout << "commands: find <text>, regex <expr>, clear, color <text> <rrggbb>, color clear, "
+                 "hide <text>, show <text>, length <min> [<max>], filter clear, collapse <proc>|all, expand <proc>|all, "
+                 "diff [<names>], export <file.json|file.pftrace>, crop <file>, query <expr>, gaps [<min>|off], "
+                 "longest [<text>], jump <n>" << std::endl;
 }
 
 static void get_coords(int x, int y, float & fx, float & fy) {
@@ -106,8 +556,364 @@ static void get_coords(int x, int y, float & fx, float & fy) {
     fy = (yPos - g_render.m_y)/g_render.m_sy;
 }
 
+static void extend_bounds(const std::vector<vertex_t> & vertices) {
+    if (!g_loader.has_bounds) {
+        g_bounds[0] = vertices[0].pos.x;
+        g_bounds[1] = vertices[0].pos.y;
+        g_bounds[2] = vertices[0].pos.x;
+        g_bounds[3] = vertices[0].pos.y;
+        g_loader.has_bounds = true;
+    }
+    for ( const vertex_t & v : vertices ) {
+        if (v.pos.x < g_bounds[0]) {
+            g_bounds[0] = v.pos.x;
+        }
+        if (v.pos.y < g_bounds[1]) {
+            g_bounds[1] = v.pos.y;
+        }
+        if (v.pos.x > g_bounds[2]) {
+            g_bounds[2] = v.pos.x;
+        }
+        if (v.pos.y > g_bounds[3]) {
+            g_bounds[3] = v.pos.y;
+        }
+    }
+}
+
+static void reset_view() {
+    g_render.m_x = -0.9f;
+    g_render.m_y = -0.9f;
+    g_render.m_sx = 1.8f/std::max(g_bounds[2]-g_bounds[0], 1e-6f);
+    g_render.m_sy = 1.8f/std::max(g_bounds[3]-g_bounds[1], 1e-6f);
+}
+
+static bool can_draw() {
+    return g_loader.initialized && g_render.has_geometry();
+}
+
+// Input only marks the view as changed; the frame is rendered by tick().
+static void request_frame(HWND hwnd) {
+    if (!can_draw()) {
+        InvalidateRect(hwnd, NULL, FALSE);
+        return;
+    }
+    g_scheduler.request(FrameScheduler::clock::now());
+}
+
+static void note_input() {
+    if (!g_input_pending) {
+        g_input_time = FrameScheduler::clock::now();
+        g_input_pending = true;
+    }
+}
+
+// Only the rows between the top and bottom of the window are drawn.
+static void update_visible_rows() {
+    const float y0 = (-1.0f - g_render.m_y) / g_render.m_sy;
+    const float y1 = (1.0f - g_render.m_y) / g_render.m_sy;
+    std::vector< std::pair<uint32_t, uint32_t> > ranges;
+    visible_task_ranges(std::min(y0, y1), std::max(y0, y1), g_filtered ? g_filtered_slot_tasks : g_slot_tasks, Render::MAX_DRAW_RANGES, ranges);
+    g_render.set_visible_tasks(ranges);
+
+    if (g_heat_mode != HeatMode::automatic) {
+        g_render.set_heatmap(g_heat_mode == HeatMode::on);
+        return;
+    }
+    // estimated from the visible rows and the fraction of the trace in view
+    uint64_t tasks = 0;
+    for (const auto & range : ranges) {
+        tasks += range.second;
+    }
+    const float x0 = (-1.0f - g_render.m_x) / g_render.m_sx;
+    const float x1 = (1.0f - g_render.m_x) / g_render.m_sx;
+    const float span = (float) (1e-3 * (double) (g_minimap.t1 - g_minimap.t0));
+    const float fraction = span > 0.0f ? std::min(1.0f, std::fabs(x1 - x0) / span) : 1.0f;
+    const float width = (float) std::max<LONG>(g_rect.right - g_rect.left, 1);
+    const float tasks_per_pixel = (float) tasks * fraction / width;
+    // hysteresis keeps it from flickering around the threshold
+    if (tasks_per_pixel > 4.0f) {
+        g_render.set_heatmap(true);
+    } else if (tasks_per_pixel < 2.0f) {
+        g_render.set_heatmap(false);
+    }
+}
+
+// The counter graphs are resampled for the view whenever it moves
+// horizontally or the window is resized.
+static void update_counters() {
+    static float last_x0 = 0.0f;
+    static float last_x1 = 0.0f;
+    static LONG last_width = 0;
+    const float x0 = (-1.0f - g_render.m_x) / g_render.m_sx;
+    const float x1 = (1.0f - g_render.m_x) / g_render.m_sx;
+    const LONG width = std::max<LONG>(g_rect.right - g_rect.left, 1);
+    if (g_counters.empty() || (x0 == last_x0 && x1 == last_x1 && width == last_width)) {
+        return;
+    }
+    last_x0 = x0;
+    last_x1 = x1;
+    last_width = width;
+
+    const uint64_t t0 = (uint64_t) std::max(0.0, 1e3 * std::min(x0, x1));
+    const uint64_t t1 = (uint64_t) std::max(0.0, 1e3 * std::max(x0, x1));
+    // kept between calls so panning does not reallocate it
+    static std::vector<counter_point_t> points;
+    points.clear();
+    for (size_t counter = 0; counter < g_counters.size(); ++counter) {
+        counter_points(counter, t0, t1, (size_t) width, points);
+    }
+    g_render.set_counter_points(points);
+}
+
+// Tiles around the view are paged into the pool as it moves.
+static void update_tiles() {
+    const float x0 = (-1.0f - g_render.m_x) / g_render.m_sx;
+    const float x1 = (1.0f - g_render.m_x) / g_render.m_sx;
+    const uint64_t t0 = (uint64_t) std::max(0.0, 1e3 * std::min(x0, x1));
+    const uint64_t t1 = (uint64_t) std::max(0.0, 1e3 * std::max(x0, x1));
+    std::vector<uint32_t> draw;
+    g_tile_cache.update(t0, t1, [](uint32_t slot, const geometry_t & geometry, bool & overwritten) {
+        return g_render.upload_tile(slot, geometry, overwritten);
+    }, draw);
+    g_render.set_tile_draws(draw);
+}
+
+static void update_minimap_view() {
+    float view[4];
+    minimap_view(g_minimap, (-1.0f - g_render.m_x) / g_render.m_sx, (1.0f - g_render.m_x) / g_render.m_sx,
+                 (-1.0f - g_render.m_y) / g_render.m_sy, (1.0f - g_render.m_y) / g_render.m_sy, view);
+    g_render.set_minimap_view(view);
+}
+
+static void tick() {
+    const auto now = FrameScheduler::clock::now();
+    if (!g_scheduler.due(now)) {
+        return;
+    }
+    if (g_ready) {
+        update_visible_rows();
+        update_counters();
+        if (g_tiled) {
+            update_tiles();
+        }
+        if (g_render.minimap()) {
+            update_minimap_view();
+        }
+    }
+    const uint64_t frame_id = g_render.frame_id();
+    if (!g_render.draw()) {
+        g_scheduler.frame_busy(now);
+        return;
+    }
+    g_scheduler.frame_rendered(now);
+    // keep drawing while geometry or tiles are on their way
+    if (g_render.uploads_pending() || (g_tiled && g_tile_cache.busy())) {
+        g_scheduler.request(now);
+    }
+
+    // input to present: until the frame showing the input has been queued for presentation
+    if (g_input_pending && g_render.frame_id() != frame_id) {
+        FrameRecord * record = g_frame_stats.find(g_render.frame_id());
+        if (record != nullptr) {
+            record->input_latency_ms = std::chrono::duration<double, std::milli>(FrameScheduler::clock::now() - g_input_time).count();
+        }
+        g_input_pending = false;
+    }
+}
+
+static const char * present_mode_name(VkPresentModeKHR mode) {
+    for (const PresentModeName & present_mode : present_modes) {
+        if (present_mode.mode == mode) {
+            return present_mode.name;
+        }
+    }
+    return "unknown";
+}
+
+static void show_frame_stats(HWND hwnd) {
+    const FrameRecord avg = g_frame_stats.average(60);
+    char text[256];
+    snprintf(text, sizeof(text), "PerfViewer - %s  cpu %.2f ms  gpu lines %.2f ms  triangles %.2f ms  latency %.1f ms",
+        present_mode_name(g_render.present_mode()),
+        std::max(avg.acquire_ms, 0.0) + std::max(avg.record_ms, 0.0) + std::max(avg.submit_ms, 0.0) + std::max(avg.present_ms, 0.0),
+        avg.gpu_lines_ms, avg.gpu_triangles_ms, avg.input_latency_ms);
+    SetWindowTextA(hwnd, text);
+}
+
+static void upload_previews(HWND hwnd) {
+    if (!g_loader.initialized || g_ready) {
+        return;
+    }
+    std::vector<geometry_t> previews;
+    {
+        std::lock_guard<std::mutex> lock(g_loader.preview_mutex);
+        previews.swap(g_loader.previews);
+    }
+    if (previews.empty()) {
+        return;
+    }
+    const bool first = !g_render.has_geometry();
+    for (const geometry_t & geometry : previews) {
+        if (!g_render.upload_preview(geometry)) {
+            continue;
+        }
+        extend_bounds(geometry.vertices);
+    }
+    if (first && g_render.has_geometry()) {
+        reset_view();
+    }
+    request_frame(hwnd);
+}
+
+// The pool never grows past TILE_POOL_BYTES. Its slots fit the largest
+// tile if a few dozen of them still fit the pool, the view always needs
+// that many; larger tiles are cut down to their longest records.
+static void finish_tiled_loading(HWND hwnd) {
+    const uint64_t record_size = 3 * sizeof(vertex_t) + 9 * sizeof(uint32_t);
+    const uint64_t max_records = std::min<uint64_t>(std::max<uint64_t>(g_tile_file.max_records(), 1),
+                                                    TILE_POOL_BYTES / (4 * TileCache::VIEW_TILES) / record_size);
+    const uint64_t slot_size = max_records * record_size;
+    const uint32_t slots = (uint32_t) (TILE_POOL_BYTES / slot_size);
+    if (!g_render.set_slots(slot_offsets()) || !g_render.setup_tile_pool(slots, slot_size)) {
+        PostQuitMessage(1);
+        return;
+    }
+    g_tile_cache.start(&g_tile_file, slots, (size_t) max_records, TILE_LOADER_THREADS);
+    std::cout << "tile pool " << slots << " x " << (slot_size >> 10) << " KB" << std::endl;
+
+    g_bounds[0] = 0.0f;
+    g_bounds[2] = 1e-3f * (float) g_tile_file.end_time();
+    layout_bounds(g_bounds[1], g_bounds[3]);
+    reset_view();
+    g_ready = true;
+    request_frame(hwnd);
+}
+
+static void finish_loading(HWND hwnd) {
+    if (!g_loader.parsed || !g_loader.initialized) {
+        return;
+    }
+    if (g_tiled) {
+        finish_tiled_loading(hwnd);
+        return;
+    }
+    // the preview layout is provisional, so only keep the view if the user moved it
+    g_loader.has_bounds = false;
+    extend_bounds(g_loader.vertices);
+    // vertex y is relative to the row
+    layout_bounds(g_bounds[1], g_bounds[3]);
+    if (!g_loader.view_touched) {
+        reset_view();
+    }
+
+    // offsets first, so they have landed by the time the geometry is drawn;
+    // the renderer keeps the geometry until it has streamed it all
+    if (!g_render.set_slots(slot_offsets()) ||
+        !g_render.upload(std::move(g_loader.vertices), std::move(g_loader.indices_line), std::move(g_loader.indices_tri))) {
+        PostQuitMessage(1);
+        return;
+    }
+    g_loader.vertices = std::vector<vertex_t>();
+    g_loader.indices_line = std::vector<uint32_t>();
+    g_loader.indices_tri = std::vector<uint32_t>();
+    {
+        std::lock_guard<std::mutex> lock(g_loader.preview_mutex);
+        g_loader.previews.clear();
+    }
+
+    g_ready = true;
+
+    const auto start = std::chrono::steady_clock::now();
+    g_minimap = build_minimap(1024, 128);
+    g_render.set_minimap(g_minimap.coverage, g_minimap.width);
+    const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "minimap " << g_minimap.width << "x" << g_minimap.height << " (" << ms << " ms)" << std::endl;
+
+    request_frame(hwnd);
+}
+
+static void paint_progress(HWND hwnd) {
+    PAINTSTRUCT ps;
+    HDC hdc = BeginPaint(hwnd, &ps);
+
+    RECT rect;
+    GetClientRect(hwnd, &rect);
+    FillRect(hdc, &rect, (HBRUSH) GetStockObject(WHITE_BRUSH));
+
+    const int width = rect.right - rect.left;
+    const int height = rect.bottom - rect.top;
+    const RECT bar{ width/4, height/2 - 8, 3*width/4, height/2 + 8 };
+    RECT filled = bar;
+    filled.right = bar.left + (bar.right - bar.left) * g_load_progress / 100;
+    FillRect(hdc, &filled, (HBRUSH) GetStockObject(GRAY_BRUSH));
+    FrameRect(hdc, &bar, (HBRUSH) GetStockObject(BLACK_BRUSH));
+
+    RECT text_rect{ bar.left, bar.bottom + 4, bar.right, bar.bottom + 24 };
+    DrawTextA(hdc, g_load_stage.load(), -1, &text_rect, DT_CENTER | DT_SINGLELINE);
+
+    EndPaint(hwnd, &ps);
+}
+
 LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam) {
     switch (message) {
+        case WM_APP_PARSED:
+            if (!wParam) {
+                PostQuitMessage(0);
+                break;
+            }
+            g_loader.parsed = true;
+            finish_loading(hwnd);
+            break;
+        case WM_APP_RENDER_READY:
+            if (!wParam) {
+                PostQuitMessage(1);
+                break;
+            }
+            g_loader.initialized = true;
+            // the previews are coloured by name as well
+            apply_palette();
+            upload_previews(hwnd);
+            finish_loading(hwnd);
+            break;
+        case WM_APP_PREVIEW:
+            upload_previews(hwnd);
+            break;
+        case WM_APP_COMMAND: {
+            std::string * line = (std::string *) lParam;
+            if (g_ready) {
+                run_command(*line);
+                request_frame(hwnd);
+            } else {
+                std::cout << "still loading" << std::endl;
+            }
+            delete line;
+            return 0;
+        }
+        case WM_TIMER: {
+            if (wParam == MODAL_FRAME_TIMER) {
+                tick();
+                return 0;
+            }
+            if (wParam == STATS_TIMER) {
+                show_frame_stats(hwnd);
+                return 0;
+            }
+            if (wParam != PROGRESS_TIMER)
+                break;
+            if (g_ready) {
+                // keep repainting until the last copy has landed on the GPU
+                if (!g_render.uploads_pending()) {
+                    KillTimer(hwnd, PROGRESS_TIMER);
+                    SetWindowTextW(hwnd, title);
+                }
+                request_frame(hwnd);
+                return 0;
+            }
+            const std::wstring progress = std::wstring(title) + L" - loading " + std::to_wstring(g_load_progress.load()) + L"%";
+            SetWindowTextW(hwnd, progress.c_str());
+            request_frame(hwnd);
+            return 0;
+        }
         case WM_CLOSE:
             PostQuitMessage(0);
             break;
@@ -119,73 +925,203 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
             return 1;
         case WM_SIZE:
             GetClientRect(hwnd, &g_rect);
-            g_render.draw();
+            request_frame(hwnd);
+            break;
+        case WM_ENTERSIZEMOVE:
+            // the modal sizing loop starves the main loop, so tick from a timer
+            SetTimer(hwnd, MODAL_FRAME_TIMER, 8, nullptr);
+            break;
+        case WM_EXITSIZEMOVE:
+            KillTimer(hwnd, MODAL_FRAME_TIMER);
             break;
         case WM_PAINT:
-            g_render.draw();
+            if (!can_draw()) {
+                paint_progress(hwnd);
+                return 0;
+            }
+            request_frame(hwnd);
             ValidateRect(hwnd, NULL);
             return 0;
         case WM_CHAR: {
+            if (!can_draw())
+                break;
             switch (wParam) {
                 case '*': {
-                    g_render.m_x = -0.9f;
-                    g_render.m_y = -0.9f;
-                    g_render.m_sx = 1.8f/(g_bounds[2]-g_bounds[0]);
-                    g_render.m_sy = 1.8f/(g_bounds[3]-g_bounds[1]);
+                    reset_view();
+                    break;
+                }
+                case 'f': {
+                    g_scheduler.report(std::cout);
+                    break;
+                }
+                case 'o': {
+                    g_render.set_overlay(!g_render.overlay());
+                    if (g_render.overlay()) {
+                        SetTimer(hwnd, STATS_TIMER, 250, nullptr);
+                    } else {
+                        KillTimer(hwnd, STATS_TIMER);
+                        SetWindowTextW(hwnd, title);
+                    }
+                    break;
+                }
+                case 'd': {
+                    if (g_frame_stats.write_csv("frames.csv") && g_frame_stats.write_json("frames.json")) {
+                        std::cout << "wrote " << g_frame_stats.size() << " frames to frames.csv and frames.json" << std::endl;
+                    }
+                    break;
+                }
+                case 'v': {
+                    const size_t count = sizeof(present_modes)/sizeof(present_modes[0]);
+                    size_t i = 0;
+                    while (i < count && present_modes[i].mode != g_render.present_mode()) {
+                        ++i;
+                    }
+                    // the next mode the surface supports, or the fallback would be picked again
+                    const std::vector<VkPresentModeKHR> & supported = g_render.present_modes();
+                    for (size_t step = 1; step <= count; ++step) {
+                        const VkPresentModeKHR mode = present_modes[(i + step) % count].mode;
+                        if (supported.empty() || std::find(supported.begin(), supported.end(), mode) != supported.end()) {
+                            g_render.set_present_mode(mode);
+                            break;
+                        }
+                    }
+                    std::cout << "present mode " << present_mode_name(g_render.present_mode()) << std::endl;
+                    break;
+                }
+                case 'm': {
+                    g_render.show_minimap(!g_render.minimap());
+                    break;
+                }
+                case 'g': {
+                    g_heat_mode = g_heat_mode == HeatMode::automatic ? HeatMode::on
+                                : g_heat_mode == HeatMode::on ? HeatMode::off : HeatMode::automatic;
+                    std::cout << "heatmap " << (g_heat_mode == HeatMode::automatic ? "auto" : g_heat_mode == HeatMode::on ? "on" : "off") << std::endl;
+                    break;
+                }
+                case 'k': {
+                    // the duration ranking needs the whole trace
+                    if (!g_ready)
+                        break;
+                    g_color_mode = next_color_mode(g_color_mode);
+                    apply_palette();
+                    std::cout << "colour by " << color_mode_name(g_color_mode) << std::endl;
                     break;
                 }
             }
-            InvalidateRect(hwnd, NULL, FALSE);
+            request_frame(hwnd);
             break;
         }
         case WM_KEYDOWN: {
+            if (!g_ready)
+                break;
             switch (wParam) {
-                case VK_UP: {
-                    if (g_selrowidx == 0)
+                case 'N': {
+                    // every instance of the selected task's name
+                    const Entry * task = selected_task();
+                    if (task == nullptr)
                         break;
-                    --g_selrowidx;
-                    uint64_t proc;
-                    uint64_t thread;
-                    size_t pos;
-                    find_task(g_selrowidx, (selectionx0 + selectionx1) / 2.0f, proc, thread, pos);
-                    select_task(proc, thread, pos);
+                    const uint32_t name_index = task->name_index;
+                    const size_t count = highlight_names({ name_index });
+                    std::cout << "highlighted " << count << " x [" << g_names[name_index] << "]" << std::endl;
                     break;
                 }
-                case VK_DOWN: {
-                    if (g_selrowidx + 1 >= rowdata.size())
+                case VK_F3: {
+                    jump_to_occurrence(GetKeyState(VK_SHIFT) >= 0);
+                    break;
+                }
+                case 'L': {
+                    // every task at least as long as the selected one
+                    const Entry * task = selected_task();
+                    if (task == nullptr)
                         break;
-                    ++g_selrowidx;
-                    uint64_t proc;
-                    uint64_t thread;
-                    size_t pos;
-                    find_task(g_selrowidx, (selectionx0 + selectionx1) / 2.0f, proc, thread, pos);
-                    select_task(proc, thread, pos);
+                    const uint64_t length = task->length;
+                    const size_t count = highlight_tasks([length](const Entry & e) { return e.length >= length; });
+                    std::cout << "highlighted " << count << " tasks >= " << format(length) << std::endl;
+                    break;
+                }
+                case 'C': {
+                    g_render.set_highlight({});
+                    break;
+                }
+                case 'P': {
+                    // collapse the selected task's process, or expand them all
+                    const Entry * task = selected_task();
+                    if (task != nullptr && row_visible(g_selrowidx)) {
+                        set_collapsed(rowdata[g_selrowidx].first, true);
+                    } else {
+                        set_collapsed(SIZE_MAX, false);
+                    }
+                    break;
+                }
+                case 'H': {
+                    // hide every instance of the selected task's name
+                    const Entry * task = selected_task();
+                    if (task == nullptr)
+                        break;
+                    std::cout << "hiding [" << g_names[task->name_index] << "]" << std::endl;
+                    hide_names({ task->name_index }, true);
+                    break;
+                }
+                case VK_UP: {
+                    // skip rows without tasks
+                    const uint64_t time = selected_time();
+                    for (size_t row = g_selrowidx; row > 0; --row) {
+                        if (select_in_row(row - 1, time))
+                            break;
+                    }
+                    break;
+                }
+                case VK_DOWN: {
+                    const uint64_t time = selected_time();
+                    for (size_t row = g_selrowidx + 1; row < rowdata.size(); ++row) {
+                        if (select_in_row(row, time))
+                            break;
+                    }
                     break;
                 }
                 case VK_LEFT: {
-                    uint64_t proc = rowdata[g_selrowidx].first;
-                    uint64_t thread = rowdata[g_selrowidx].second;
                     if (g_seltask == 0)
                         break;
-                    --g_seltask;
-                    select_task(proc, thread, g_seltask);
+                    select_task(g_selrowidx, g_seltask - 1);
                     break;
                 }
                 case VK_RIGHT: {
-                    uint64_t proc = rowdata[g_selrowidx].first;
-                    uint64_t thread = rowdata[g_selrowidx].second;
-                    std::vector<Entry *> &tasks(g_tasksperproc[proc][thread]);
-                    if (g_seltask+1 == tasks.size())
+                    if (g_seltask+1 >= row_tasks(g_selrowidx).size())
                         break;
-                    ++g_seltask;
-                    select_task(proc, thread, g_seltask);
+                    select_task(g_selrowidx, g_seltask + 1);
+                    break;
+                }
+                case VK_PRIOR: {
+                    // enclosing task: the one in the row above covering the selection
+                    const Entry * task = selected_task();
+                    if (task == nullptr || rowdepth[g_selrowidx] == 0)
+                        break;
+                    select_in_row(g_selrowidx - 1, task->start);
+                    break;
+                }
+                case VK_NEXT: {
+                    // first task nested in the selection, if any
+                    const Entry * task = selected_task();
+                    if (task == nullptr || g_selrowidx + 1 >= rowdata.size() || rowdepth[g_selrowidx + 1] == 0)
+                        break;
+                    size_t pos;
+                    if (!pick_task(g_selrowidx + 1, task->start, pos))
+                        break;
+                    const Entry * child = row_tasks(g_selrowidx + 1)[pos];
+                    if (child->start < task->start)
+                        ++pos;
+                    if (pos < row_tasks(g_selrowidx + 1).size() && row_tasks(g_selrowidx + 1)[pos]->start < task->start + task->length)
+                        select_task(g_selrowidx + 1, pos);
                     break;
                 }
             }
-            InvalidateRect(hwnd, NULL, FALSE);
+            request_frame(hwnd);
             break;
         }
         case WM_MOUSEWHEEL: {
+            if (!can_draw())
+                break;
+            g_loader.view_touched = true;
             POINT p{ GET_X_LPARAM(lParam), GET_Y_LPARAM(lParam) };
             ScreenToClient(hwnd, &p);
 
@@ -201,57 +1137,62 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
             }
 
             g_render.m_x = fx - g_render.m_sx/oldSx*(fx-g_render.m_x);
-            InvalidateRect(hwnd, NULL, FALSE);
+            note_input();
+            request_frame(hwnd);
             break;
         }
         case WM_RBUTTONDOWN:
         case WM_LBUTTONDOWN: {
+            if (!can_draw())
+                break;
             g_button_down_x = GET_X_LPARAM(lParam);
             g_button_down_y = GET_Y_LPARAM(lParam);
             g_start_scale = g_render.m_sx;
 
-            if (message == WM_LBUTTONDOWN) {
+            if (message == WM_LBUTTONDOWN && g_ready && (wParam & MK_SHIFT)) {
                 float xx, yy;
                 get_coords(g_button_down_x, g_button_down_y, xx, yy);
-                size_t bestidx = 0;
-                float best = fabs(rowpos[0] - yy);
-
-                for (size_t i = 0; i < rowpos.size(); ++i) {
-                    float dist = fabs(rowpos[i] - yy);
-                    if (dist < best) {
-                        bestidx = i;
-                        best = dist;
-                    }
+                g_range_start = g_range_end = x_to_time(xx);
+                g_range_drag = true;
+                SetCapture(hwnd);
+                break;
+            }
+            if (message == WM_LBUTTONDOWN && g_ready) {
+                float xx, yy;
+                get_coords(g_button_down_x, g_button_down_y, xx, yy);
+                const size_t row = pick_row(yy);
+                if (row != NO_ROW) {
+                    select_in_row(row, x_to_time(xx));
                 }
-                g_selrowidx = bestidx;
-
-                unsigned long long proc;
-                unsigned long long thread;
-                size_t pos;
-                find_task(g_selrowidx, xx, proc, thread, pos);
-
-                g_seltask = pos;
-                g_seltime = xx;
-
-                //std::cout<<"pos=" << xx << ", " << yy << std::endl;
-                select_task(proc, thread, pos);
             }
-            InvalidateRect(hwnd, NULL, FALSE);
+            note_input();
+            request_frame(hwnd);
             break;
         }
         case WM_MOUSEMOVE: {
+            if (!can_draw())
+                break;
             const int xPos = GET_X_LPARAM(lParam);
             const int yPos = GET_Y_LPARAM(lParam);
             float xx, yy;
             get_coords(xPos, yPos, xx, yy);
 
+            if (g_range_drag) {
+                g_range_end = x_to_time(xx);
+                show_range(hwnd);
+                break;
+            }
+            if (wParam & (MK_LBUTTON | MK_RBUTTON)) {
+                g_loader.view_touched = true;
+            }
             if (wParam & MK_LBUTTON) {
                 const int dx = xPos - g_button_down_x;
                 const int dy = yPos - g_button_down_y;
                 g_button_down_x = xPos;
                 g_button_down_y = yPos;
                 g_render.m_x += 2.0f*dx/(g_rect.right-g_rect.left);
-                InvalidateRect(hwnd, NULL, FALSE);
+                note_input();
+                request_frame(hwnd);
             } else if (wParam & MK_RBUTTON) {
                 const float fx = 2.0f*g_button_down_x/float(g_rect.right-g_rect.left)-1.0f;
                 const int orig = g_button_down_x-50;
@@ -263,7 +1204,22 @@ LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
                     g_render.m_sx = g_start_scale * -(1.0f/(50.0f*dx));
                 }
                 g_render.m_x = fx - g_render.m_sx/oldSx*(fx-g_render.m_x);
-                InvalidateRect(hwnd, NULL, FALSE);
+                note_input();
+                request_frame(hwnd);
+            } else if (g_ready) {
+                hover(hwnd, xx, yy);
+            }
+            break;
+        }
+        case WM_LBUTTONUP: {
+            if (!g_range_drag)
+                break;
+            g_range_drag = false;
+            ReleaseCapture();
+            const uint64_t t0 = std::min(g_range_start, g_range_end);
+            const uint64_t t1 = std::max(g_range_start, g_range_end);
+            if (t1 > t0) {
+                print_range_stats(range_stats(t0, t1, true), std::cout);
             }
             break;
         }
@@ -291,21 +1247,98 @@ ATOM register_class(HINSTANCE hinstance) {
     return RegisterClassExW(&wcex);
 }
 
-extern bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri);
+extern bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri,
+                  const std::function<void(geometry_t &&)> & publish_preview);
+extern bool parse_diff(const char * baseline, const char * candidate, std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri);
 
 int main(int argc, const char * argv[]) {
-    std::vector<vertex_t> vertices;
-    std::vector<uint32_t> indices_line;
-    std::vector<uint32_t> indices_tri;
-
     const char * filename = "g:/dump.log";
-    if (argc>1) {
-        filename = argv[1];
+    // --diff=<candidate> compares the log against a candidate run
+    const char * candidate = nullptr;
+    // --crop=<t0>,<t1>,<output> writes the tasks of [t0, t1) to a new log
+    // and exits without opening a window
+    std::string crop_output;
+    uint64_t crop_t0 = 0;
+    uint64_t crop_t1 = 0;
+    // --query=<expr> prints the result of a query, see Query.h, and exits
+    std::string query_text;
+    // --tiles=<output> converts the log to a tile file, see Tiles.h, and exits
+    std::string tiles_output;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg.rfind("--diff=", 0) == 0) {
+            candidate = argv[i] + 7;
+            continue;
+        }
+        if (arg.rfind("--crop=", 0) == 0) {
+            const size_t first = arg.find(',', 7);
+            const size_t second = first == std::string::npos ? std::string::npos : arg.find(',', first + 1);
+            if (second == std::string::npos || !parse_time(arg.substr(7, first - 7), crop_t0) ||
+                !parse_time(arg.substr(first + 1, second - first - 1), crop_t1) || crop_t1 <= crop_t0 || second + 1 == arg.size()) {
+                std::cerr << "expected --crop=<t0>,<t1>,<output>" << std::endl;
+                return 1;
+            }
+            crop_output = arg.substr(second + 1);
+            continue;
+        }
+        if (arg.rfind("--query=", 0) == 0) {
+            query_text = arg.substr(8);
+            continue;
+        }
+        if (arg.rfind("--tiles=", 0) == 0) {
+            tiles_output = arg.substr(8);
+            continue;
+        }
+        if (arg.rfind("--present=", 0) == 0) {
+            const std::string mode = arg.substr(10);
+            bool found = false;
+            for (const PresentModeName & present_mode : present_modes) {
+                if (mode == present_mode.name) {
+                    g_render.set_present_mode(present_mode.mode);
+                    found = true;
+                }
+            }
+            if (!found) {
+                std::cerr << "unknown present mode " << mode << ", expected fifo, mailbox or immediate" << std::endl;
+                return 1;
+            }
+            continue;
+        }
+        filename = argv[i];
     }
-
-    if (!parse(filename, vertices, indices_line, indices_tri)) {
+    if (!tiles_output.empty()) {
+        if (!convert_tiles(filename, tiles_output.c_str())) {
+            return 1;
+        }
+        std::cout << "wrote " << tiles_output << std::endl;
         return 0;
     }
+    if (!crop_output.empty() || !query_text.empty()) {
+        std::vector<vertex_t> vertices;
+        std::vector<uint32_t> indices_line;
+        std::vector<uint32_t> indices_tri;
+        if (!parse(filename, vertices, indices_line, indices_tri, nullptr)) {
+            return 1;
+        }
+        if (!query_text.empty()) {
+            Query query;
+            std::string error;
+            if (!parse_query(query_text, query, error)) {
+                std::cerr << error << std::endl;
+                return 1;
+            }
+            print_query_result(query, run_query(query), std::cout);
+        }
+        if (!crop_output.empty()) {
+            if (!export_log(crop_output.c_str(), crop_t0, crop_t1)) {
+                return 1;
+            }
+            std::cout << "wrote " << crop_output << std::endl;
+        }
+        return 0;
+    }
+    g_tiled = candidate == nullptr && is_tile_file(filename);
+    g_render.set_stats(&g_frame_stats);
 
     const HINSTANCE hinstance = GetModuleHandle(NULL);
     const ATOM win_class = register_class(hinstance);
@@ -319,46 +1352,84 @@ int main(int argc, const char * argv[]) {
         return 1;
     }
 
-    if (!g_render.init(hinstance, hwnd, vertices, indices_line, indices_tri)) {
-        return 1;
-    }
+    ShowWindow(hwnd, SW_NORMAL);
+    UpdateWindow(hwnd);
+    SetTimer(hwnd, PROGRESS_TIMER, 100, nullptr);
 
-    g_bounds[0] = vertices[0].pos.x;
-    g_bounds[1] = vertices[0].pos.y;
-    g_bounds[2] = vertices[0].pos.x;
-    g_bounds[3] = vertices[0].pos.y;
-    for ( const vertex_t & v : vertices ) {
-        if (v.pos.x < g_bounds[0]) {
-            g_bounds[0] = v.pos.x;
-        }
-        if (v.pos.y < g_bounds[1]) {
-            g_bounds[1] = v.pos.y;
+    std::thread parse_thread([hwnd, filename, candidate]() {
+        if (g_tiled) {
+            const bool ok = g_tile_file.open(filename);
+            if (ok) {
+                load_tile_layout(g_tile_file);
+            }
+            PostMessage(hwnd, WM_APP_PARSED, ok, 0);
+            return;
         }
-        if (v.pos.x > g_bounds[2]) {
-            g_bounds[2] = v.pos.x;
+        if (candidate != nullptr) {
+            const bool ok = parse_diff(filename, candidate, g_loader.vertices, g_loader.indices_line, g_loader.indices_tri);
+            PostMessage(hwnd, WM_APP_PARSED, ok, 0);
+            return;
         }
-        if (v.pos.y > g_bounds[3]) {
-            g_bounds[3] = v.pos.y;
+        auto publish_preview = [hwnd](geometry_t && geometry) {
+            {
+                std::lock_guard<std::mutex> lock(g_loader.preview_mutex);
+                g_loader.previews.push_back(std::move(geometry));
+            }
+            PostMessage(hwnd, WM_APP_PREVIEW, 0, 0);
+        };
+        const bool ok = parse(filename, g_loader.vertices, g_loader.indices_line, g_loader.indices_tri, publish_preview);
+        PostMessage(hwnd, WM_APP_PARSED, ok, 0);
+    });
+    std::thread init_thread([hinstance, hwnd]() {
+        const bool ok = g_render.init(hinstance, hwnd);
+        PostMessage(hwnd, WM_APP_RENDER_READY, ok, 0);
+    });
+
+    // commands typed into the console run on the window thread; the reader
+    // blocks on stdin, so it is left running at exit
+    std::thread console_thread([hwnd]() {
+        std::string line;
+        while (std::getline(std::cin, line)) {
+            PostMessage(hwnd, WM_APP_COMMAND, 0, (LPARAM) new std::string(line));
         }
-    }
-    g_render.m_x = -0.9f;
-    g_render.m_y = -0.9f;
-    g_render.m_sx = 1.8f/(g_bounds[2]-g_bounds[0]);
-    g_render.m_sy = 1.8f/(g_bounds[3]-g_bounds[1]);
+    });
+    console_thread.detach();
 
-    ShowWindow(hwnd, SW_NORMAL);
-    UpdateWindow(hwnd);
+    // pace frames to the display refresh rate
+    DEVMODEW dev_mode{};
+    dev_mode.dmSize = sizeof(dev_mode);
+    if (EnumDisplaySettingsW(nullptr, ENUM_CURRENT_SETTINGS, &dev_mode) && dev_mode.dmDisplayFrequency > 1) {
+        g_scheduler.set_refresh_rate(dev_mode.dmDisplayFrequency);
+    }
+    timeBeginPeriod(1);
 
-    MSG msg;
-    BOOL bRet;
-    while( (bRet = GetMessage( &msg, NULL, 0, 0 )) != 0) { 
-        if (bRet == -1) {
+    int exit_code = 0;
+    bool running = true;
+    while (running) {
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                exit_code = (int) msg.wParam;
+                running = false;
+                break;
+            }
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+        if (!running) {
             break;
-        } else {
-            TranslateMessage(&msg); 
-            DispatchMessage(&msg); 
         }
-    } 
 
-    return 0;
+        tick();
+
+        const uint32_t timeout = g_scheduler.timeout_ms(FrameScheduler::clock::now());
+        MsgWaitForMultipleObjects(0, nullptr, FALSE, timeout == FrameScheduler::NO_TIMEOUT ? INFINITE : timeout, QS_ALLINPUT);
+    }
+    timeEndPeriod(1);
+
+    g_load_cancel = true;
+    parse_thread.join();
+    init_thread.join();
+
+    return exit_code;
 }
@@ -0,0 +1,87 @@
+#include "Minimap.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+
+MinimapImage build_minimap(uint32_t width, uint32_t max_height) {
+    MinimapImage image;
+    if (g_alltasks.empty() || rowdata.empty() || width == 0 || max_height == 0) {
+        return image;
+    }
+    image.t0 = UINT64_MAX;
+    for (const Entry & e : g_alltasks) {
+        image.t0 = std::min(image.t0, e.start);
+        image.t1 = std::max(image.t1, e.start + e.length);
+    }
+    if (image.t1 <= image.t0) {
+        image.t1 = image.t0 + 1;
+    }
+    const size_t rows = rowdata.size();
+    image.width = width;
+    image.height = (uint32_t) std::min<size_t>(rows, max_height);
+    image.coverage.assign((size_t) image.width * image.height, 0.0f);
+
+    const double scale = (double) width / (double) (image.t1 - image.t0);
+    parallel_for(0, image.height, [&](size_t band) {
+        const size_t first = band * rows / image.height;
+        const size_t last = (band + 1) * rows / image.height;
+
+        // partial columns go straight into sum, runs of whole columns into
+        // the difference array
+        std::vector<double> sum(width, 0.0);
+        std::vector<double> diff(width + 1, 0.0);
+        size_t threads = 0;
+        for (size_t row = first; row < last; ++row) {
+            if (rowdepth[row] != 0) {
+                continue;
+            }
+            ++threads;
+            for (const Entry * e : g_rowtasks[row]) {
+                const double a = (double) (e->start - image.t0) * scale;
+                const double b = std::min((double) (e->start + e->length - image.t0) * scale, (double) width);
+                const size_t ia = std::min((size_t) a, (size_t) width - 1);
+                const size_t ib = (size_t) b;
+                if (ia >= ib) {
+                    sum[ia] += b - a;
+                    continue;
+                }
+                sum[ia] += (double) (ia + 1) - a;
+                diff[ia + 1] += 1.0;
+                diff[ib] -= 1.0;
+                if (ib < width) {
+                    sum[ib] += b - (double) ib;
+                }
+            }
+        }
+        if (threads == 0) {
+            return;
+        }
+        float * out = image.coverage.data() + band * width;
+        double run = 0.0;
+        for (size_t x = 0; x < width; ++x) {
+            run += diff[x];
+            out[x] = (float) std::min((sum[x] + run) / (double) threads, 1.0);
+        }
+    });
+    return image;
+}
+
+void minimap_view(const MinimapImage & image, float x0, float x1, float y0, float y1, float view[4]) {
+    const double span = (double) (image.t1 - image.t0);
+    auto u = [&](float x) {
+        return span > 0.0 ? (float) ((1e3 * (double) x - (double) image.t0) / span) : 0.0f;
+    };
+    // the bands follow the row order, which rowpos keeps sorted
+    auto v = [&](float y) {
+        if (rowpos.empty()) {
+            return 0.0f;
+        }
+        return (float) (std::lower_bound(rowpos.begin(), rowpos.end(), y) - rowpos.begin()) / (float) rowpos.size();
+    };
+    view[0] = std::clamp(u(std::min(x0, x1)), 0.0f, 1.0f);
+    view[1] = std::clamp(v(std::min(y0, y1)), 0.0f, 1.0f);
+    view[2] = std::clamp(u(std::max(x0, x1)), 0.0f, 1.0f);
+    view[3] = std::clamp(v(std::max(y0, y1)), 0.0f, 1.0f);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Overview of the whole trace for the minimap strip: for every pixel
+// column and band of rows, the fraction of the time the threads' outermost
+// tasks are busy. Built once after loading; the renderer draws it as a
+// single quad whatever the size of the trace.
+struct MinimapImage {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint64_t t0 = 0;                // time at the left edge
+    uint64_t t1 = 0;                // time at the right edge
+    std::vector<float> coverage;    // width * height, top band first
+};
+
+// Rows are split evenly into at most max_height bands. Bands are
+// computed in parallel.
+MinimapImage build_minimap(uint32_t width, uint32_t max_height);
+
+// The part of the trace between x0..x1 and y0..y1 (trace coordinates) in
+// minimap coordinates, 0..1 in both directions.
+void minimap_view(const MinimapImage & image, float x0, float x1, float y0, float y1, float view[4]);
@@ -0,0 +1,95 @@
+#include "Palette.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+static const color_t base_colors[] = {
+    color_t{.5f,.0f,.0f}, color_t{.0f,.5f,.0f}, color_t{.0f,.0f,.5f},
+    color_t{.5f,.5f,.0f}, color_t{.5f,.0f,.5f}, color_t{.0f,.5f,.5f},
+    color_t{.5f,.5f,.5f}, color_t{.0f,.0f,.0f},
+    color_t{.5f,.3f,.0f}, color_t{.3f,.5f,.0f}, color_t{.0f,.3f,.5f},
+    color_t{.5f,.0f,.3f}, color_t{.0f,.5f,.3f}, color_t{.3f,.0f,.5f},
+    color_t{.5f,.5f,.3f}, color_t{.5f,.3f,.5f}, color_t{.3f,.5f,.5f}
+};
+static const size_t base_color_count = sizeof(base_colors)/sizeof(base_colors[0]);
+
+static std::unordered_map<uint32_t, color_t> g_custom_colors;
+
+const char * color_mode_name(ColorMode mode) {
+    switch (mode) {
+        case ColorMode::name:       return "name";
+        case ColorMode::duration:   return "duration";
+        case ColorMode::process:    return "process";
+        case ColorMode::custom:     return "custom";
+    }
+    return "?";
+}
+
+ColorMode next_color_mode(ColorMode mode) {
+    switch (mode) {
+        case ColorMode::name:       return ColorMode::duration;
+        case ColorMode::duration:   return ColorMode::process;
+        case ColorMode::process:    return ColorMode::custom;
+        case ColorMode::custom:     return ColorMode::name;
+    }
+    return ColorMode::name;
+}
+
+// Names ranked by their mean task length; the rank becomes the position
+// on a blue to red ramp. Names without tasks stay grey.
+static std::vector<color_t> duration_palette() {
+    std::vector<uint64_t> total(g_names.size(), 0);
+    std::vector<uint64_t> count(g_names.size(), 0);
+    for (const Entry & e : g_alltasks) {
+        total[e.name_index] += e.length;
+        ++count[e.name_index];
+    }
+
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < (uint32_t) g_names.size(); ++i) {
+        if (count[i] != 0) {
+            order.push_back(i);
+        }
+    }
+    // compare total_a / count_a with total_b / count_b without dividing
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return (double) total[a] * count[b] < (double) total[b] * count[a];
+    });
+
+    std::vector<color_t> colors(g_names.size(), color_t{ .5f, .5f, .5f });
+    for (size_t rank = 0; rank < order.size(); ++rank) {
+        const float t = order.size() > 1 ? (float) rank / (float) (order.size() - 1) : 1.0f;
+        colors[order[rank]] = color_t{ .8f * t, .1f, .8f * (1.0f - t) };
+    }
+    return colors;
+}
+
+std::vector<color_t> build_palette(ColorMode mode, bool & by_process) {
+    by_process = mode == ColorMode::process;
+    if (mode == ColorMode::duration) {
+        return duration_palette();
+    }
+    if (mode != ColorMode::custom || g_custom_colors.empty()) {
+        // the shader cycles through the table, so the base colours are enough
+        return std::vector<color_t>(base_colors, base_colors + base_color_count);
+    }
+    std::vector<color_t> colors(g_names.size());
+    for (size_t i = 0; i < colors.size(); ++i) {
+        colors[i] = base_colors[i % base_color_count];
+    }
+    for (const auto & custom : g_custom_colors) {
+        if (custom.first < colors.size()) {
+            colors[custom.first] = custom.second;
+        }
+    }
+    return colors;
+}
+
+void set_custom_color(uint32_t name_index, const color_t & color) {
+    g_custom_colors[name_index] = color;
+}
+
+void clear_custom_colors() {
+    g_custom_colors.clear();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "VertexData.h"
+
+#include <cstdint>
+#include <vector>
+
+// What the task colours encode. Every mode is just a different lookup
+// table for Render::set_palette(); the geometry is never rebuilt.
+enum class ColorMode {
+    name,       // fixed colours cycled over the name indices
+    duration,   // percentile of the name's mean task length, blue to red
+    process,    // fixed colours cycled over the processes
+    custom,     // by name, with the colours set through set_custom_color()
+};
+
+const char * color_mode_name(ColorMode mode);
+ColorMode next_color_mode(ColorMode mode);
+
+// Lookup table for the mode. by_process is set if the table is indexed by
+// process instead of by name. The duration mode needs the parsed trace.
+std::vector<color_t> build_palette(ColorMode mode, bool & by_process);
+
+void set_custom_color(uint32_t name_index, const color_t & color);
+void clear_custom_colors();
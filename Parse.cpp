@@ -1,4 +1,14 @@
 #include "VertexData.h"
+#include "ChromeTrace.h"
+#include "Counters.h"
+#include "Diff.h"
+#include "Gaps.h"
+#include "Layout.h"
+#include "Longest.h"
+#include "RangeStats.h"
+#include "Search.h"
+#include "Trace.h"
+#include "Util.h"
 
 #include <string>
 #include <iomanip>
@@ -8,21 +18,23 @@
 #include <vector>
 #include <unordered_map>
 #include <sstream>
-
-struct Entry {
-    uint64_t proc = 0;
-    uint64_t thread = 0;
-    uint64_t start = 0;
-    uint64_t length = 0;
-    uint32_t name_index = 0;
-    uint32_t vert_index = 0;
-};
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
 
 std::vector<Entry> g_alltasks;
 std::vector< std::vector< std::vector< Entry * > > > g_tasksperproc;
 std::vector<std::string> g_names;
 std::vector< float > rowpos;
 std::vector< std::pair< uint64_t, uint64_t > > rowdata;
+std::vector< uint32_t > rowdepth;
+std::vector< std::vector< Entry * > > g_rowtasks;
+
+// load progress, polled by the window while parse() runs on its own thread
+std::atomic<int> g_load_progress = 0;
+std::atomic<const char *> g_load_stage = "reading";
+std::atomic<bool> g_load_cancel = false;
 
 static bool starts_with(const std::string & value1, const std::string & value2) {
     return value1.find(value2) == 0;
@@ -36,26 +48,104 @@ void split(const std::string &s, char delim, std::vector<std::string> &elems) {
     }
 }
 
-static void get_color(Entry &e, color_t &c) {
-    color_t cols[] = { 
-        color_t{.5f,.0f,.0f}, color_t{.0f,.5f,.0f}, color_t{.0f,.0f,.5f},
-        color_t{.5f,.5f,.0f}, color_t{.5f,.0f,.5f}, color_t{.0f,.5f,.5f},
-        color_t{.5f,.5f,.5f}, color_t{.0f,.0f,.0f},
-        color_t{.5f,.3f,.0f}, color_t{.3f,.5f,.0f}, color_t{.0f,.3f,.5f},
-        color_t{.5f,.0f,.3f}, color_t{.0f,.5f,.3f}, color_t{.3f,.0f,.5f},
-        color_t{.5f,.5f,.3f}, color_t{.5f,.3f,.5f}, color_t{.3f,.5f,.5f}
+uint32_t push_task(std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri,
+                   float start, float end, float y0, float y1, uint32_t name_index, uint32_t proc, uint32_t slot) {
+    const uint32_t idx = (uint32_t) vertices.size();
+    vertices.push_back({ {start, y0}, name_index, proc, slot });
+    vertices.push_back({ {end, (y0 + y1) / 2.0f}, name_index, proc, slot });
+    vertices.push_back({ {start, y1}, name_index, proc, slot });
+
+    indices_line.push_back(idx);
+    indices_line.push_back(idx+1);
+    indices_line.push_back(idx+1);
+    indices_line.push_back(idx+2);
+    indices_line.push_back(idx+2);
+    indices_line.push_back(idx);
+
+    indices_tri.push_back(idx);
+    indices_tri.push_back(idx+1);
+    indices_tri.push_back(idx+2);
+    return idx;
+}
+
+// Coarse geometry for tasks that have been read but not yet sorted. Rows are
+// assigned in order of appearance and tasks closer than a fraction of the
+// chunk's time span are merged, so a chunk costs far fewer triangles than the
+// tasks it covers. The full geometry replaces all preview chunks when loading
+// is done.
+struct Preview {
+    struct Span {
+        uint64_t start;
+        uint64_t end;
+        uint32_t name_index;
+        bool open = false;
     };
+    std::unordered_map<uint64_t, uint32_t> rows;
+    std::vector<Span> spans;
+    uint64_t origin = 0;
+    bool has_origin = false;
+};
+
+static void generate_preview(const std::vector<Entry> & tasks, Preview & preview, size_t begin, size_t end, geometry_t & geometry) {
+    const float rowheight = 1.0f;
+    const float barheight = 0.8f;
 
-    const size_t idx = e.name_index % (sizeof(cols)/sizeof(cols[0]));
-    c = cols[idx];
+    if (begin == end)
+        return;
+
+    uint64_t t0 = tasks[begin].start;
+    uint64_t t1 = tasks[begin].start + tasks[begin].length;
+    for (size_t i = begin; i < end; ++i) {
+        t0 = std::min(t0, tasks[i].start);
+        t1 = std::max(t1, tasks[i].start + tasks[i].length);
+    }
+    if (!preview.has_origin) {
+        preview.origin = t0;
+        preview.has_origin = true;
+    }
+    const uint64_t merge_gap = (t1 - t0) / 2048;
+
+    auto flush = [&](size_t row, Preview::Span & span) {
+        if (!span.open)
+            return;
+        span.open = false;
+        const uint64_t s = span.start > preview.origin ? span.start - preview.origin : 0;
+        const uint64_t e = span.end > preview.origin ? span.end - preview.origin : 0;
+        const float y = row * rowheight + 0.5f;
+        // processes are not known before sorting
+        push_task(geometry.vertices, geometry.indices_line, geometry.indices_tri,
+                  1e-3f * (float) s, 1e-3f * (float) e, y - barheight / 2.0f, y + barheight / 2.0f, span.name_index, 0, NO_SLOT);
+    };
+
+    for (size_t i = begin; i < end; ++i) {
+        const Entry & e = tasks[i];
+        auto it = preview.rows.find(e.thread);
+        if (it == preview.rows.end()) {
+            it = preview.rows.emplace(e.thread, (uint32_t) preview.rows.size()).first;
+            preview.spans.push_back(Preview::Span());
+        }
+        const uint32_t row = it->second;
+        Preview::Span & span = preview.spans[row];
+        const uint64_t task_end = e.start + e.length;
+        if (span.open && e.start + merge_gap >= span.start && e.start <= span.end + merge_gap) {
+            span.start = std::min(span.start, e.start);
+            span.end = std::max(span.end, task_end);
+            continue;
+        }
+        flush(row, span);
+        span = Preview::Span{ e.start, task_end, e.name_index, true };
+    }
+    for (size_t row = 0; row < preview.spans.size(); ++row) {
+        flush(row, preview.spans[row]);
+    }
 }
 
 bool generate_triangles(std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri) {
     if (false) {
         vertices.clear();
-        vertices.push_back({{ 0.0f, 0.5f }, { 1.0f, 0.0f, 0.0f }});
-        vertices.push_back({{ 0.5f, 0.0f }, { 0.0f, 1.0f, 0.0f }});
-        vertices.push_back({{ 0.0f,-0.5f }, { 0.0f, 0.0f, 1.0f }});
+        vertices.push_back({{ 0.0f, 0.5f }, 0, 0, NO_SLOT });
+        vertices.push_back({{ 0.5f, 0.0f }, 1, 0, NO_SLOT });
+        vertices.push_back({{ 0.0f,-0.5f }, 2, 0, NO_SLOT });
 
         indices_line.push_back(0);
         indices_line.push_back(1);
@@ -70,52 +160,95 @@ bool generate_triangles(std::vector<vertex_t> & vertices, std::vector<uint32_t>
         return true;
     }
 
-    size_t row = 0;
-    const float rowheight = 1.0f;
+    g_name_tasks.assign(g_names.size(), std::vector<TaskRef>());
+
+    // y is relative to the row's centre line, the GPU adds the layout's offset
     const float barheight = 0.8f;
-    const float proc_distance = 2.5f;
-    float extra_height = 0.0f;
+    const float y0 = -barheight / 2.0f;
+    const float y1 = barheight / 2.0f;
 
     for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
-        for (size_t thread = 0; thread < g_tasksperproc[proc].size(); ++thread, ++row) {
-
-            const float y = extra_height + row * rowheight + 0.5f;
-            const float y0 = y - barheight / 2.0f;
-            const float y1 = y + barheight / 2.0f;
-            rowpos.push_back(y);
-            rowdata.push_back(std::make_pair(proc, thread));
-
-            for (size_t i = 0; i < g_tasksperproc[proc][thread].size(); ++i) {
-                const float start = 1e-3f * (float) (g_tasksperproc[proc][thread][i]->start);
-                const float end = 1e-3f * (float) (g_tasksperproc[proc][thread][i]->start + g_tasksperproc[proc][thread][i]->length);
-
-                color_t col;
-                get_color(*g_tasksperproc[proc][thread][i], col);
-
-                const uint32_t idx = (uint32_t) vertices.size();
-                vertices.push_back({ {start, y0}, col });
-                vertices.push_back({ {end, (y0 + y1) / 2.0f}, col });
-                vertices.push_back({ {start, y1}, col });
-
-                g_tasksperproc[proc][thread][i]->vert_index = idx;
-
-                indices_line.push_back(idx);
-                indices_line.push_back(idx+1);
-                indices_line.push_back(idx+1);
-                indices_line.push_back(idx+2);
-                indices_line.push_back(idx+2);
-                indices_line.push_back(idx);
-
-                indices_tri.push_back(idx);
-                indices_tri.push_back(idx+1);
-                indices_tri.push_back(idx+2);
+        for (size_t thread = 0; thread < g_tasksperproc[proc].size(); ++thread) {
+
+            // flame chart lane: one row per depth, outermost scopes on top
+            const size_t first_row = g_rowtasks.size();
+            for (Entry * e : g_tasksperproc[proc][thread]) {
+                if (first_row + e->depth >= g_rowtasks.size()) {
+                    g_rowtasks.resize(first_row + e->depth + 1);
+                }
+                g_rowtasks[first_row + e->depth].push_back(e);
+            }
+
+            for (size_t row = first_row; row < g_rowtasks.size(); ++row) {
+                // placed by update_layout()
+                rowpos.push_back(0.0f);
+                g_slot_tasks.push_back((uint32_t) (vertices.size() / 3));
+                rowdata.push_back(std::make_pair(proc, thread));
+                rowdepth.push_back((uint32_t) (row - first_row));
+
+                const std::vector<Entry *> & tasks = g_rowtasks[row];
+                for (size_t i = 0; i < tasks.size(); ++i) {
+                    const float start = 1e-3f * (float) (tasks[i]->start);
+                    const float end = 1e-3f * (float) (tasks[i]->start + tasks[i]->length);
+
+                    tasks[i]->vert_index = push_task(vertices, indices_line, indices_tri, start, end, y0, y1, tasks[i]->name_index, (uint32_t) proc, (uint32_t) row);
+                    g_name_tasks[tasks[i]->name_index].push_back({ (uint32_t) row, (uint32_t) i });
+                }
             }
         }
-        extra_height += proc_distance;
     }
+
+    // Summary rows: the union of the outermost tasks of all threads of a
+    // process, shown instead of the threads while it is collapsed.
+    std::vector< std::vector< std::pair<uint64_t, uint64_t> > > busy(g_tasksperproc.size());
+    parallel_for(0, g_tasksperproc.size(), [&](size_t proc) {
+        std::vector< std::pair<uint64_t, uint64_t> > intervals;
+        for (const std::vector<Entry *> & thread : g_tasksperproc[proc]) {
+            for (const Entry * e : thread) {
+                if (e->depth == 0) {
+                    intervals.push_back(std::make_pair(e->start, e->start + e->length));
+                }
+            }
+        }
+        std::sort(intervals.begin(), intervals.end());
+        std::vector< std::pair<uint64_t, uint64_t> > & merged = busy[proc];
+        for (const auto & interval : intervals) {
+            if (!merged.empty() && interval.first <= merged.back().second) {
+                merged.back().second = std::max(merged.back().second, interval.second);
+            } else {
+                merged.push_back(interval);
+            }
+        }
+    });
+    for (size_t proc = 0; proc < busy.size(); ++proc) {
+        g_slot_tasks.push_back((uint32_t) (vertices.size() / 3));
+        for (const auto & interval : busy[proc]) {
+            push_task(vertices, indices_line, indices_tri, 1e-3f * (float) interval.first, 1e-3f * (float) interval.second,
+                      y0, y1, SUMMARY_NAME, (uint32_t) proc, summary_slot(proc));
+        }
+    }
+    g_slot_tasks.push_back((uint32_t) (vertices.size() / 3));
+
+    g_collapsed.assign(g_tasksperproc.size(), 0);
+    update_layout();
     return true;
 }
 
+// Stack sweep over one thread's tasks, sorted by start with enclosing
+// tasks first. A task is as deep as the number of tasks still open when it
+// starts; a partially overlapping task simply goes one deeper, so the tasks
+// of one depth never overlap.
+static void assign_depths(std::vector<Entry *> & tasks) {
+    std::vector<uint64_t> open_ends;
+    for (Entry * e : tasks) {
+        while (!open_ends.empty() && open_ends.back() <= e->start) {
+            open_ends.pop_back();
+        }
+        e->depth = (uint32_t) open_ends.size();
+        open_ends.push_back(e->start + e->length);
+    }
+}
+
 static void ReadUntilNewline(const char *& ptr) {
     while (*ptr != '\n' && *ptr != '\r') {
         ++ptr;
@@ -154,7 +287,73 @@ std::string format(uint64_t a) {
     return r;
 }
 
-bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri) {
+// Name ids and counter tracks of a native log seen so far.
+struct LogState {
+    std::unordered_map<uint64_t, int> name_index;
+    // counter tracks by name id
+    std::unordered_map<uint64_t, size_t> counter_index;
+};
+
+// One line of a native log: a name, a comment, a counter sample or a task.
+static bool read_line(const char *& ptr, LogState & state, std::vector<Entry> & tasks, std::vector<std::string> & names,
+                      std::vector<CounterTrack> & counters, LongestTasks & longest) {
+    char * next;
+    if (*ptr == '.') { // name
+        ++ptr;
+        uint64_t val = strtoull(ptr, &next, 16);
+        if (*next != ' ') {
+            std::cerr << "Parse error!" << std::endl;
+            return false;
+        }
+        ptr = next + 1;
+        ReadUntilNewline(ptr);
+        if (state.name_index.find(val) == state.name_index.end()) {
+            names.push_back(std::string((const char *) next + 1, ptr));
+            state.name_index[val] = (int) names.size() - 1;
+        }
+        ReadNewline(ptr);
+        return true;
+    }
+    if (*ptr == '#') {
+        SkipLine(ptr);
+        return true;
+    }
+    if (*ptr == '$') { // counter sample: name, time, value
+        const uint64_t name = strtoull(ptr + 1, &next, 16);
+        const uint64_t time = strtoull(next + 1, &next, 10);
+        const double value = strtod(next + 1, &next);
+        auto it = state.counter_index.emplace(name, counters.size()).first;
+        if (it->second == counters.size()) {
+            counters.emplace_back();
+            auto name_it = state.name_index.find(name);
+            counters.back().name = name_it != state.name_index.end() ? names[name_it->second] : "counter";
+        }
+        counters[it->second].times.push_back(time);
+        counters[it->second].values.push_back(value);
+        ptr = next;
+        ReadNewline(ptr);
+        return true;
+    }
+
+    Entry e;
+    e.thread = strtoull(ptr, &next, 10);
+    e.start = strtoull(next + 1, &next, 10);
+    e.length = strtoull(next + 1, &next, 10);
+    const uint64_t name = strtoull(next + 1, &next, 16);
+    e.name_index = state.name_index[name];
+    longest.add(e);
+    tasks.push_back(e);
+
+    ptr = next;
+    ReadNewline(ptr);
+    return true;
+}
+
+// Reads the tasks, names and counters of a log as they appear in the file;
+// every task is also offered to longest. Loading progress is only reported
+// if report_progress is set.
+static bool read_log(const char * filename, std::vector<Entry> & tasks, std::vector<std::string> & names, std::vector<CounterTrack> & counters,
+                     LongestTasks & longest, const std::function<void(geometry_t &&)> & publish_preview, bool report_progress) {
     std::ifstream infile(filename, std::ios::binary | std::ios::ate);
     std::cout << filename << std::endl;
     if (infile.fail()) {
@@ -165,6 +364,9 @@ bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<
     std::streamsize size = infile.tellg();
     infile.seekg(0, std::ios::beg);
 
+    if (report_progress) {
+        g_load_stage = "reading";
+    }
     std::vector<char> buffer(size);
     if (!infile.read(buffer.data(), size)) {
         std::cerr << "Read failed" << std::endl;
@@ -175,6 +377,23 @@ bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<
     const char * ptr = buffer.data();
     const char * end = buffer.data() + size;
 
+    if (is_chrome_trace(ptr, end)) {
+        if (report_progress) {
+            g_load_stage = "parsing";
+        }
+        const bool ok = read_chrome_trace(ptr, end, tasks, names, counters, longest, [&](const char * position) {
+            if (report_progress) {
+                g_load_progress = (int) (90 * (position - buffer.data()) / size);
+            }
+            return !g_load_cancel;
+        });
+        if (ok && tasks.empty()) {
+            std::cerr << "Empty log" << std::endl;
+            return false;
+        }
+        return ok;
+    }
+
     int numLines = 0;
     for (const char * i = ptr; i < end; ++i) {
         if (*i == '\n') {
@@ -184,52 +403,142 @@ bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<
 
     std::cout << "numLines=" << numLines << std::endl;
 
-    g_alltasks.reserve(numLines);
-    std::unordered_map<uint64_t, int> name_index;
+    tasks.reserve(numLines);
+    LogState state;
 
+    // publish a first preview quickly, then about once a second
+    Preview preview;
+    size_t preview_begin = 0;
+    auto preview_time = std::chrono::steady_clock::now();
+    auto preview_interval = std::chrono::milliseconds(250);
+
+    if (report_progress) {
+        g_load_stage = "parsing";
+    }
+    size_t lines_since_progress = 0;
     while (ptr < end) {
-        char * next;
-        if (*ptr == '.') { // name
-            ++ptr;
-            uint64_t val = strtoull(ptr, &next, 16);
-            if (*next != ' ') {
-                std::cerr << "Parse error!" << std::endl;
+        if (++lines_since_progress == 0x10000) {
+            lines_since_progress = 0;
+            if (report_progress) {
+                g_load_progress = (int) (90 * (ptr - buffer.data()) / size);
+            }
+            if (g_load_cancel) {
                 return false;
             }
-            ptr = next + 1;
-            ReadUntilNewline(ptr);
-            if (name_index.find(val) == name_index.end()) {
-                g_names.push_back(std::string((const char *) next + 1, ptr));
-                name_index[val] = (int) g_names.size() - 1;
+            const auto now = std::chrono::steady_clock::now();
+            if (publish_preview && now - preview_time >= preview_interval) {
+                geometry_t geometry;
+                generate_preview(tasks, preview, preview_begin, tasks.size(), geometry);
+                preview_begin = tasks.size();
+                if (!geometry.vertices.empty()) {
+                    publish_preview(std::move(geometry));
+                }
+                preview_time = now;
+                preview_interval = std::chrono::milliseconds(1000);
             }
-            ReadNewline(ptr);
-            continue;
         }
-        if (*ptr == '#') {
-            SkipLine(ptr);
-            continue;
+        if (!read_line(ptr, state, tasks, names, counters, longest)) {
+            return false;
         }
-
-        Entry e;
-        e.thread = strtoull(ptr, &next, 10);
-        e.start = strtoull(next + 1, &next, 10);
-        e.length = strtoull(next + 1, &next, 10);
-        const uint64_t name = strtoull(next + 1, &next, 16);
-        e.name_index = name_index[name];
-        g_alltasks.push_back(e);
-
-        ptr = next;
-        ReadNewline(ptr);
     }
 
     infile.close();
 
-    if (g_alltasks.empty()) {
+    if (tasks.empty()) {
         std::cerr << "Empty log" << std::endl;
         return false;
     }
+    return true;
+}
+
+// Reads a log a piece at a time and hands the tasks of each piece to sink,
+// which takes them out of the vector, so that only the names and counters
+// are kept. For logs larger than memory; see convert_tiles().
+bool stream_log(const char * filename, std::vector<std::string> & names, std::vector<CounterTrack> & counters,
+                const std::function<bool(std::vector<Entry> &)> & sink) {
+    const size_t PIECE = 64 << 20;
+    std::ifstream infile(filename, std::ios::binary);
+    std::cout << filename << std::endl;
+    if (infile.fail()) {
+        std::cerr << "Read failed" << std::endl;
+        return false;
+    }
+
+    // one byte beyond the text stops the line reader's look-ahead
+    std::vector<char> buffer(PIECE + 1);
+    size_t filled = 0;
+    bool chrome = false;
+    bool first = true;
+    LogState state;
+    LongestTasks longest;
+    ChromeReader chrome_reader(names, counters, longest);
+    std::vector<Entry> tasks;
+    for (;;) {
+        infile.read(buffer.data() + filled, buffer.size() - 1 - filled);
+        filled += (size_t) infile.gcount();
+        const bool last = !infile;
+        if (infile.bad()) {
+            std::cerr << "Read failed" << std::endl;
+            return false;
+        }
+        if (first) {
+            chrome = is_chrome_trace(buffer.data(), buffer.data() + filled);
+            first = false;
+        }
+
+        size_t used = 0;
+        if (chrome) {
+            if (!chrome_reader.read(buffer.data(), buffer.data() + filled, last, tasks, used)) {
+                return false;
+            }
+        } else {
+            // whole lines only, unless the log ends without a newline
+            if (last && filled > 0 && buffer[filled - 1] != '\n') {
+                buffer.resize(std::max(buffer.size(), filled + 2));
+                buffer[filled++] = '\n';
+            }
+            buffer[filled] = 0;
+            while (used < filled && buffer[filled - used - 1] != '\n') {
+                ++used;
+            }
+            used = filled - used;
+            const char * ptr = buffer.data();
+            while (ptr < buffer.data() + used) {
+                if (!read_line(ptr, state, tasks, names, counters, longest)) {
+                    return false;
+                }
+            }
+            used = ptr - buffer.data();
+        }
+        if (!tasks.empty() && !sink(tasks)) {
+            return false;
+        }
+        tasks.clear();
+        if (last) {
+            break;
+        }
+
+        // the unread rest goes first; a piece without a single whole line
+        // or event gets more room
+        std::copy(buffer.begin() + used, buffer.begin() + filled, buffer.begin());
+        filled -= used;
+        if (filled == buffer.size() - 1) {
+            buffer.resize(2 * buffer.size() - 1);
+        }
+    }
+    if (chrome) {
+        chrome_reader.finish();
+    }
+    return true;
+}
 
+// Sorts g_alltasks into processes, threads and rows and generates the
+// geometry. longest_keys are the candidates the readers kept, see
+// Longest.h.
+static bool build_trace(const std::vector<TaskKey> & longest_keys, std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri) {
     std::cout << "parsed." << std::endl;
+    g_load_stage = "sorting";
+    g_load_progress = 90;
 
     // fix process ids
     std::sort(g_alltasks.begin(), g_alltasks.end(), [](const Entry & a, const Entry & b) -> bool {
@@ -239,15 +548,25 @@ bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<
         if (a.thread != b.thread) {
             return a.thread < b.thread;
         }
-        return a.start < b.start;
+        if (a.start != b.start) {
+            return a.start < b.start;
+        }
+        // enclosing scope before the scopes nested in it
+        return a.length > b.length;
     });
 
     std::cout << "sorted." << std::endl;
 
+    // while proc and thread still are the readers'
+    const std::vector<Entry *> longest = find_tasks(g_alltasks, longest_keys);
+
     uint64_t currentProc = g_alltasks[0].proc;
     uint64_t currentThread = g_alltasks[0].thread;
     uint64_t procCounter = 0;
     uint64_t threadCounter = 0;
+    // original process id -> dense one, for the counters
+    std::unordered_map<uint64_t, uint64_t> proc_ids;
+    proc_ids[currentProc] = 0;
     g_tasksperproc.resize(1);
     g_tasksperproc[0].resize(1);
     g_tasksperproc[procCounter][threadCounter].push_back(&g_alltasks[0]);
@@ -268,6 +587,7 @@ bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<
         else {
             currentProc = g_alltasks[i].proc;
             g_alltasks[i].proc = ++procCounter;
+            proc_ids[currentProc] = procCounter;
             currentThread = g_alltasks[i].thread;
             threadCounter = 0;
             g_alltasks[i].thread = threadCounter;
@@ -277,6 +597,19 @@ bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<
         g_tasksperproc[procCounter][threadCounter].push_back(&g_alltasks[i]);
     }
 
+    // nesting depth; threads are independent, so they are swept in parallel
+    std::vector< std::vector< Entry * > * > threads;
+    for (std::vector< std::vector< Entry * > > & proc_tasks : g_tasksperproc) {
+        for (std::vector< Entry * > & thread_tasks : proc_tasks) {
+            threads.push_back(&thread_tasks);
+        }
+    }
+    parallel_for(0, threads.size(), [&threads](size_t i) {
+        assign_depths(*threads[i]);
+    });
+
+    std::cout << "nested." << std::endl;
+
     std::vector<int> numtasks;
     numtasks.resize(g_names.size(), 0);
     std::vector<uint64_t > totaltimes;
@@ -309,6 +642,19 @@ bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<
         starttimes[i] = start;
     }
 
+    // counters of processes without tasks have no place to go
+    g_counters.erase(std::remove_if(g_counters.begin(), g_counters.end(), [&proc_ids](const CounterTrack & track) {
+        return proc_ids.find(track.proc) == proc_ids.end();
+    }), g_counters.end());
+    for (CounterTrack & track : g_counters) {
+        track.proc = proc_ids[track.proc];
+        const uint64_t start = starttimes[track.proc];
+        for (uint64_t & time : track.times) {
+            time = time > start ? time - start : 0;
+        }
+    }
+    build_counter_pyramids();
+
     std::cout << "normalized." << std::endl;
 
     uint64_t endtime = 0;
@@ -346,5 +692,92 @@ bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<
     }
 
     std::cout << "generating." << std::endl;
-    return generate_triangles(vertices, indices_line, indices_tri);
+    g_load_stage = "generating";
+    g_load_progress = 95;
+    const bool result = generate_triangles(vertices, indices_line, indices_tri);
+    build_longest(longest);
+    build_range_index();
+    build_gap_stats();
+    print_gap_stats(std::cout, false);
+    g_load_progress = 100;
+    return result;
+}
+
+bool parse(const char * filename, std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri,
+           const std::function<void(geometry_t &&)> & publish_preview) {
+    LongestTasks longest;
+    if (!read_log(filename, g_alltasks, g_names, g_counters, longest, publish_preview, true)) {
+        return false;
+    }
+    return build_trace(longest.candidates(), vertices, indices_line, indices_tri);
+}
+
+// Both logs are read and summarised concurrently, without previews. The
+// candidate's processes are numbered after the baseline's highest one, so
+// the two timelines are stacked, each starting at 0, and share one name
+// table.
+bool parse_diff(const char * baseline, const char * candidate, std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri) {
+    std::vector<Entry> tasks[2];
+    std::vector<std::string> names[2];
+    std::vector<CounterTrack> counters[2];
+    std::vector<NameSummary> summaries[2];
+    LongestTasks longest[2];
+    bool ok[2] = { false, false };
+    auto ingest = [&](size_t i, const char * filename) {
+        ok[i] = read_log(filename, tasks[i], names[i], counters[i], longest[i], nullptr, i == 0);
+        if (ok[i]) {
+            summaries[i] = summarize_names(tasks[i], names[i]);
+        }
+    };
+    std::thread candidate_thread(ingest, 1, candidate);
+    ingest(0, baseline);
+    candidate_thread.join();
+    if (!ok[0] || !ok[1]) {
+        return false;
+    }
+
+    g_name_diff = diff_names(summaries[0], summaries[1]);
+    print_name_diff(g_name_diff, 40, std::cout);
+
+    g_names = std::move(names[0]);
+    std::unordered_map<std::string, uint32_t> name_index;
+    for (size_t i = 0; i < g_names.size(); ++i) {
+        name_index.emplace(g_names[i], (uint32_t) i);
+    }
+    std::vector<uint32_t> remap(names[1].size());
+    for (size_t i = 0; i < names[1].size(); ++i) {
+        auto it = name_index.emplace(names[1][i], (uint32_t) g_names.size()).first;
+        if (it->second == g_names.size()) {
+            g_names.push_back(names[1][i]);
+        }
+        remap[i] = it->second;
+    }
+
+    // Chrome traces keep their pids, which the two logs may share
+    uint64_t proc_offset = 0;
+    for (const Entry & e : tasks[0]) {
+        proc_offset = std::max(proc_offset, e.proc + 1);
+    }
+    for (const CounterTrack & track : counters[0]) {
+        proc_offset = std::max(proc_offset, track.proc + 1);
+    }
+
+    g_alltasks = std::move(tasks[0]);
+    g_alltasks.reserve(g_alltasks.size() + tasks[1].size());
+    for (Entry e : tasks[1]) {
+        e.proc += proc_offset;
+        e.name_index = remap[e.name_index];
+        g_alltasks.push_back(e);
+    }
+    g_counters = std::move(counters[0]);
+    for (CounterTrack & track : counters[1]) {
+        track.proc += proc_offset;
+        g_counters.push_back(std::move(track));
+    }
+    std::vector<TaskKey> longest_keys = longest[0].candidates();
+    for (TaskKey key : longest[1].candidates()) {
+        key.proc += proc_offset;
+        longest_keys.push_back(key);
+    }
+    return build_trace(longest_keys, vertices, indices_line, indices_tri);
 }
@@ -0,0 +1,62 @@
+#include "Picking.h"
+#include "Layout.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <cmath>
+
+size_t pick_row(float y) {
+    if (rowpos.empty()) {
+        return NO_ROW;
+    }
+    const auto it = std::lower_bound(rowpos.begin(), rowpos.end(), y);
+    if (it == rowpos.begin()) {
+        return row_visible(0) ? 0 : NO_ROW;
+    }
+    if (it == rowpos.end()) {
+        return row_visible(rowpos.size() - 1) ? rowpos.size() - 1 : NO_ROW;
+    }
+    const size_t row = it - rowpos.begin();
+    const size_t closest = *it - y < y - *(it - 1) ? row : row - 1;
+    // rows of collapsed processes sit on the summary row, which has no tasks to pick
+    return row_visible(closest) ? closest : NO_ROW;
+}
+
+float row_distance(size_t row, float y) {
+    return std::fabs(rowpos[row] - y);
+}
+
+uint64_t x_to_time(float x) {
+    if (x <= 0.0f) {
+        return 0;
+    }
+    return (uint64_t) std::llround(1e3 * (double) x);
+}
+
+bool pick_task(size_t row, uint64_t time, size_t & pos) {
+    if (row >= rowdata.size()) {
+        return false;
+    }
+    const std::vector<Entry *> & tasks = g_rowtasks[row];
+    if (tasks.empty()) {
+        return false;
+    }
+
+    // first task starting after time; the one before it is the candidate
+    const auto it = std::upper_bound(tasks.begin(), tasks.end(), time, [](uint64_t t, const Entry * e) {
+        return t < e->start;
+    });
+    if (it == tasks.begin()) {
+        pos = 0;
+        return true;
+    }
+    const size_t before = (it - tasks.begin()) - 1;
+    const uint64_t end = tasks[before]->start + tasks[before]->length;
+    if (time < end || it == tasks.end()) {
+        pos = before;
+        return true;
+    }
+    // in the gap between two tasks
+    pos = (*it)->start - time < time - end ? before + 1 : before;
+    return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Hit testing in trace coordinates, as returned by get_coords(). Rows are
+// found by binary search over rowpos and tasks by binary search over the
+// start times of a row, so both are logarithmic and cheap enough to run on
+// every mouse move.
+
+const size_t NO_ROW = SIZE_MAX;
+
+// Row whose centre line is closest to y, NO_ROW if there are no rows or
+// that row is collapsed.
+size_t pick_row(float y);
+
+// Vertical distance from y to the centre line of row.
+float row_distance(size_t row, float y);
+
+// Task time for an x coordinate; tasks are placed at 1e-3 * time.
+uint64_t x_to_time(float x);
+
+// The task of row that contains time, or else the task whose start or end
+// is closest to it, compared in exact integer time. false for an empty row.
+bool pick_task(size_t row, uint64_t time, size_t & pos);
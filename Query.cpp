@@ -0,0 +1,463 @@
+#include "Query.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <regex>
+#include <thread>
+
+// * matches any run of characters, ? any one
+static bool glob_match(const char * pattern, const char * text) {
+    const char * star = nullptr;
+    const char * resume = nullptr;
+    while (*text) {
+        if (*pattern == '*') {
+            star = pattern++;
+            resume = text;
+        } else if (*pattern == '?' || *pattern == *text) {
+            ++pattern;
+            ++text;
+        } else if (star != nullptr) {
+            pattern = star + 1;
+            text = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (*pattern == '*') {
+        ++pattern;
+    }
+    return *pattern == '\0';
+}
+
+namespace {
+
+struct Token {
+    enum Kind { END, WORD, NUMBER, STRING, OP, OPEN, CLOSE };
+    Kind kind = END;
+    std::string text;
+};
+
+class Parser {
+public:
+    Parser(const std::string & text, Query & query) : m_text(text), m_query(query) {
+        next();
+    }
+
+    bool parse(std::string & error) {
+        m_query.root = expression();
+        if (m_ok && m_token.kind == Token::WORD && m_token.text == "group") {
+            m_query.group = true;
+            next();
+        }
+        if (m_ok && m_token.kind != Token::END) {
+            fail("unexpected " + m_token.text);
+        }
+        error = m_error;
+        return m_ok;
+    }
+
+private:
+    void next() {
+        while (m_pos < m_text.size() && isspace((unsigned char) m_text[m_pos])) {
+            ++m_pos;
+        }
+        m_token = Token();
+        if (m_pos == m_text.size()) {
+            return;
+        }
+        const size_t begin = m_pos;
+        const char c = m_text[m_pos];
+        if (isalpha((unsigned char) c)) {
+            while (m_pos < m_text.size() && (isalnum((unsigned char) m_text[m_pos]) || m_text[m_pos] == '_')) {
+                ++m_pos;
+            }
+            m_token.kind = Token::WORD;
+        } else if (isdigit((unsigned char) c) || c == '.') {
+            while (m_pos < m_text.size() && (isdigit((unsigned char) m_text[m_pos]) || m_text[m_pos] == '.')) {
+                ++m_pos;
+            }
+            m_token.kind = Token::NUMBER;
+        } else if (c == '"') {
+            const size_t close = m_text.find('"', m_pos + 1);
+            if (close == std::string::npos) {
+                fail("unterminated string");
+                m_pos = m_text.size();
+                return;
+            }
+            m_token.kind = Token::STRING;
+            m_token.text = m_text.substr(m_pos + 1, close - m_pos - 1);
+            m_pos = close + 1;
+            return;
+        } else if (c == '(' || c == ')') {
+            ++m_pos;
+            m_token.kind = c == '(' ? Token::OPEN : Token::CLOSE;
+        } else {
+            while (m_pos < m_text.size() && strchr("=!<>~", m_text[m_pos]) != nullptr) {
+                ++m_pos;
+            }
+            if (m_pos == begin) {
+                ++m_pos;
+            }
+            m_token.kind = Token::OP;
+        }
+        m_token.text = m_text.substr(begin, m_pos - begin);
+    }
+
+    void fail(const std::string & message) {
+        if (m_ok) {
+            m_error = message;
+            m_ok = false;
+        }
+    }
+
+    bool keyword(const char * word) {
+        if (m_token.kind == Token::WORD && m_token.text == word) {
+            next();
+            return true;
+        }
+        return false;
+    }
+
+    int add(const QueryNode & node) {
+        m_query.nodes.push_back(node);
+        return (int) m_query.nodes.size() - 1;
+    }
+
+    int binary(QueryNode::Kind kind, int left, int right) {
+        QueryNode node;
+        node.kind = kind;
+        node.left = left;
+        node.right = right;
+        return add(node);
+    }
+
+    int expression() {
+        int left = conjunction();
+        while (m_ok && keyword("or")) {
+            left = binary(QueryNode::OR, left, conjunction());
+        }
+        return left;
+    }
+
+    int conjunction() {
+        int left = unary();
+        while (m_ok && keyword("and")) {
+            left = binary(QueryNode::AND, left, unary());
+        }
+        return left;
+    }
+
+    int unary() {
+        if (keyword("not")) {
+            return binary(QueryNode::NOT, unary(), -1);
+        }
+        if (m_token.kind == Token::OPEN) {
+            next();
+            const int node = expression();
+            if (m_token.kind != Token::CLOSE) {
+                fail("missing )");
+            }
+            next();
+            return node;
+        }
+        return predicate();
+    }
+
+    int predicate() {
+        static const struct { const char * name; QueryNode::Kind kind; } fields[] = {
+            { "name", QueryNode::NAME }, { "proc", QueryNode::PROC }, { "thread", QueryNode::THREAD },
+            { "depth", QueryNode::DEPTH }, { "start", QueryNode::START }, { "length", QueryNode::LENGTH },
+        };
+        QueryNode node;
+        bool found = false;
+        for (const auto & field : fields) {
+            if (m_token.kind == Token::WORD && m_token.text == field.name) {
+                node.kind = field.kind;
+                found = true;
+            }
+        }
+        if (!found) {
+            fail("expected a field instead of " + (m_token.kind == Token::END ? std::string("the end") : m_token.text));
+            return -1;
+        }
+        const std::string field = m_token.text;
+        next();
+        const std::string op = m_token.text;
+        if (m_token.kind != Token::OP) {
+            fail("expected an operator after " + field);
+            return -1;
+        }
+        next();
+
+        if (node.kind == QueryNode::NAME) {
+            if ((op != "~" && op != "=~") || m_token.kind != Token::STRING) {
+                fail("expected name ~ \"glob\" or name =~ \"regex\"");
+                return -1;
+            }
+            if (!resolve_names(node, m_token.text, op == "=~")) {
+                return -1;
+            }
+            next();
+            return add(node);
+        }
+
+        static const struct { const char * text; QueryNode::Op op; } ops[] = {
+            { "=", QueryNode::EQ }, { "!=", QueryNode::NE }, { "<", QueryNode::LT },
+            { "<=", QueryNode::LE }, { ">", QueryNode::GT }, { ">=", QueryNode::GE },
+        };
+        found = false;
+        for (const auto & o : ops) {
+            if (op == o.text) {
+                node.op = o.op;
+                found = true;
+            }
+        }
+        if (!found || m_token.kind != Token::NUMBER) {
+            fail("expected a comparison with a number");
+            return -1;
+        }
+        const double value = strtod(m_token.text.c_str(), nullptr);
+        const bool time = node.kind == QueryNode::START || node.kind == QueryNode::LENGTH;
+        node.value = (uint64_t) llround(time ? value * 1e6 : value);
+        next();
+        return add(node);
+    }
+
+    // one byte per name, filled in parallel
+    bool resolve_names(QueryNode & node, const std::string & pattern, bool regex) {
+        node.names.assign(g_names.size(), 0);
+        std::regex re;
+        if (regex) {
+            try {
+                re = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+            } catch (const std::regex_error &) {
+                fail("invalid regex " + pattern);
+                return false;
+            }
+        }
+        const size_t chunk = 1024;
+        parallel_for(0, (g_names.size() + chunk - 1) / chunk, [&](size_t c) {
+            const size_t end = std::min(g_names.size(), (c + 1) * chunk);
+            for (size_t i = c * chunk; i < end; ++i) {
+                node.names[i] = regex ? std::regex_search(g_names[i], re) : glob_match(pattern.c_str(), g_names[i].c_str());
+            }
+        });
+        return true;
+    }
+
+    const std::string & m_text;
+    Query & m_query;
+    size_t m_pos = 0;
+    Token m_token;
+    bool m_ok = true;
+    std::string m_error;
+};
+
+}
+
+bool parse_query(const std::string & text, Query & query, std::string & error) {
+    query = Query();
+    return Parser(text, query).parse(error);
+}
+
+// Blocks of tasks are evaluated node by node into byte masks: every
+// kernel is one tight loop over a column that the compiler vectorizes.
+static constexpr size_t BLOCK = 4096;
+
+template <typename T>
+static void compare(const T * column, size_t n, QueryNode::Op op, T value, uint8_t * mask) {
+    switch (op) {
+        case QueryNode::EQ: for (size_t i = 0; i < n; ++i) mask[i] = column[i] == value; break;
+        case QueryNode::NE: for (size_t i = 0; i < n; ++i) mask[i] = column[i] != value; break;
+        case QueryNode::LT: for (size_t i = 0; i < n; ++i) mask[i] = column[i] < value; break;
+        case QueryNode::LE: for (size_t i = 0; i < n; ++i) mask[i] = column[i] <= value; break;
+        case QueryNode::GT: for (size_t i = 0; i < n; ++i) mask[i] = column[i] > value; break;
+        case QueryNode::GE: for (size_t i = 0; i < n; ++i) mask[i] = column[i] >= value; break;
+    }
+}
+
+// proc, thread and depth are rarely queried and only gathered into a
+// block-sized column when a node needs them
+template <typename Get>
+static void compare_field(size_t begin, size_t n, const QueryNode & node, Get get, uint64_t * column, uint8_t * mask) {
+    for (size_t i = 0; i < n; ++i) {
+        column[i] = get(g_alltasks[begin + i]);
+    }
+    compare<uint64_t>(column, n, node.op, node.value, mask);
+}
+
+namespace {
+
+// The start, length and name of every block are gathered from g_alltasks
+// into block-sized columns, which every node of the query then streams
+// over; nothing outlives the query.
+struct Evaluator {
+    const Query & query;
+    std::vector< std::vector<uint8_t> > masks;
+    std::vector<uint64_t> column = std::vector<uint64_t>(BLOCK);
+    std::vector<uint64_t> starts = std::vector<uint64_t>(BLOCK);
+    std::vector<uint64_t> lengths = std::vector<uint64_t>(BLOCK);
+    std::vector<uint32_t> names = std::vector<uint32_t>(BLOCK);
+
+    explicit Evaluator(const Query & q) : query(q), masks(q.nodes.size(), std::vector<uint8_t>(BLOCK)) {}
+
+    void load(size_t begin, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            const Entry & e = g_alltasks[begin + i];
+            starts[i] = e.start;
+            lengths[i] = e.length;
+            names[i] = e.name_index;
+        }
+    }
+
+    // result in masks[index]
+    void eval(int index, size_t begin, size_t n) {
+        const QueryNode & node = query.nodes[index];
+        uint8_t * mask = masks[index].data();
+        switch (node.kind) {
+            case QueryNode::AND:
+            case QueryNode::OR: {
+                eval(node.left, begin, n);
+                const uint8_t * left = masks[node.left].data();
+                // skip the right side if the left one decides the block
+                const bool is_and = node.kind == QueryNode::AND;
+                if (std::all_of(left, left + n, [is_and](uint8_t m) { return m == (is_and ? 0 : 1); })) {
+                    std::copy(left, left + n, mask);
+                    return;
+                }
+                eval(node.right, begin, n);
+                const uint8_t * right = masks[node.right].data();
+                if (is_and) {
+                    for (size_t i = 0; i < n; ++i) mask[i] = left[i] & right[i];
+                } else {
+                    for (size_t i = 0; i < n; ++i) mask[i] = left[i] | right[i];
+                }
+                return;
+            }
+            case QueryNode::NOT: {
+                eval(node.left, begin, n);
+                const uint8_t * left = masks[node.left].data();
+                for (size_t i = 0; i < n; ++i) mask[i] = left[i] ^ 1;
+                return;
+            }
+            case QueryNode::NAME: {
+                const uint8_t * bits = node.names.data();
+                for (size_t i = 0; i < n; ++i) mask[i] = bits[names[i]];
+                return;
+            }
+            case QueryNode::START:
+                compare<uint64_t>(starts.data(), n, node.op, node.value, mask);
+                return;
+            case QueryNode::LENGTH:
+                compare<uint64_t>(lengths.data(), n, node.op, node.value, mask);
+                return;
+            case QueryNode::PROC:
+                compare_field(begin, n, node, [](const Entry & e) { return e.proc; }, column.data(), mask);
+                return;
+            case QueryNode::THREAD:
+                compare_field(begin, n, node, [](const Entry & e) { return e.thread; }, column.data(), mask);
+                return;
+            case QueryNode::DEPTH:
+                compare_field(begin, n, node, [](const Entry & e) { return (uint64_t) e.depth; }, column.data(), mask);
+                return;
+        }
+    }
+};
+
+}
+
+static constexpr size_t MAX_LISTED = 20;
+
+// One contiguous partition of the tasks per core, each with its own
+// partial result, merged at the end.
+QueryResult run_query(const Query & query) {
+    const size_t task_count = g_alltasks.size();
+    const size_t partitions = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), (task_count + BLOCK - 1) / BLOCK));
+    std::vector<QueryResult> partial(partitions);
+
+    parallel_for(0, partitions, [&](size_t p) {
+        QueryResult & result = partial[p];
+        if (query.group) {
+            result.groups.resize(g_names.size());
+        }
+        Evaluator evaluator(query);
+        const size_t begin = task_count * p / partitions;
+        const size_t end = task_count * (p + 1) / partitions;
+        for (size_t block = begin; block < end; block += BLOCK) {
+            const size_t n = std::min(BLOCK, end - block);
+            evaluator.load(block, n);
+            evaluator.eval(query.root, block, n);
+            const uint8_t * mask = evaluator.masks[query.root].data();
+            for (size_t i = 0; i < n; ++i) {
+                if (!mask[i]) {
+                    continue;
+                }
+                const uint64_t length = evaluator.lengths[i];
+                ++result.count;
+                result.total += length;
+                if (query.group) {
+                    QueryGroup & group = result.groups[evaluator.names[i]];
+                    ++group.count;
+                    group.total += length;
+                    group.min = std::min(group.min, length);
+                    group.max = std::max(group.max, length);
+                } else if (result.first.size() < MAX_LISTED) {
+                    result.first.push_back(block + i);
+                }
+            }
+        }
+    });
+
+    QueryResult result;
+    if (query.group) {
+        result.groups.resize(g_names.size());
+        for (size_t i = 0; i < result.groups.size(); ++i) {
+            result.groups[i].name_index = (uint32_t) i;
+        }
+    }
+    for (const QueryResult & p : partial) {
+        result.count += p.count;
+        result.total += p.total;
+        for (size_t i = 0; i < p.first.size() && result.first.size() < MAX_LISTED; ++i) {
+            result.first.push_back(p.first[i]);
+        }
+        for (size_t i = 0; i < p.groups.size(); ++i) {
+            QueryGroup & group = result.groups[i];
+            group.count += p.groups[i].count;
+            group.total += p.groups[i].total;
+            group.min = std::min(group.min, p.groups[i].min);
+            group.max = std::max(group.max, p.groups[i].max);
+        }
+    }
+    result.groups.erase(std::remove_if(result.groups.begin(), result.groups.end(), [](const QueryGroup & group) {
+        return group.count == 0;
+    }), result.groups.end());
+    std::sort(result.groups.begin(), result.groups.end(), [](const QueryGroup & a, const QueryGroup & b) {
+        return a.total > b.total;
+    });
+    return result;
+}
+
+void print_query_result(const Query & query, const QueryResult & result, std::ostream & out) {
+    out << result.count << " tasks, total " << format(result.total) << std::endl;
+    if (query.group) {
+        out << std::left << std::setw(40) << "name" << std::right << std::setw(12) << "count"
+            << std::setw(10) << "total" << std::setw(10) << "mean" << std::setw(10) << "min" << std::setw(10) << "max" << std::endl;
+        for (size_t i = 0; i < result.groups.size() && i < 40; ++i) {
+            const QueryGroup & group = result.groups[i];
+            out << std::left << std::setw(40) << g_names[group.name_index]
+                << std::right << std::setw(12) << group.count << std::setw(10) << format(group.total)
+                << std::setw(10) << format(group.total / group.count)
+                << std::setw(10) << format(group.min) << std::setw(10) << format(group.max) << std::endl;
+        }
+        return;
+    }
+    for (uint64_t index : result.first) {
+        const Entry & e = g_alltasks[index];
+        out << "  " << g_names[e.name_index] << " (" << e.proc << ", " << e.thread << ") depth " << e.depth
+            << " [ " << format(e.start) << ", " << format(e.length) << " ]" << std::endl;
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "Trace.h"
+
+// Filter expressions over all tasks, e.g.
+//
+//   name ~ "Render*" and length > 0.5 and not (depth = 0 or proc = 1) group
+//
+// Predicates: name ~ "glob" (* and ?), name =~ "regex", and proc, thread,
+// depth, start and length compared with = != < <= > >=. Times are in the
+// units format() prints. Terms combine with and, or, not and parentheses;
+// a trailing "group" aggregates the matches by name.
+
+struct QueryNode {
+    enum Kind { AND, OR, NOT, NAME, PROC, THREAD, DEPTH, START, LENGTH };
+    enum Op { EQ, NE, LT, LE, GT, GE };
+    Kind kind = AND;
+    Op op = EQ;
+    uint64_t value = 0;
+    std::vector<uint8_t> names;     // NAME: one byte per name in g_names
+    int left = -1;                  // AND, OR, NOT
+    int right = -1;                 // AND, OR
+};
+
+struct Query {
+    std::vector<QueryNode> nodes;
+    int root = -1;
+    bool group = false;
+};
+
+struct QueryGroup {
+    uint32_t name_index = 0;
+    uint64_t count = 0;
+    uint64_t total = 0;
+    uint64_t min = UINT64_MAX;
+    uint64_t max = 0;
+};
+
+struct QueryResult {
+    uint64_t count = 0;
+    uint64_t total = 0;
+    std::vector<uint64_t> first;        // indices into g_alltasks of the first matches
+    std::vector<QueryGroup> groups;     // largest total first
+};
+
+// false with a message in error if the text does not parse. Name
+// predicates are resolved against g_names here, once.
+bool parse_query(const std::string & text, Query & query, std::string & error);
+
+QueryResult run_query(const Query & query);
+
+void print_query_result(const Query & query, const QueryResult & result, std::ostream & out);
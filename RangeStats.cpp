@@ -0,0 +1,260 @@
+#include "RangeStats.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+// The tasks of each name in a row: positions[begin[k], begin[k + 1]) are
+// the indices of names[k]'s tasks in the row, ascending, and
+// prefix[begin[k] + k + j] is the total length of the first j of them.
+struct RowNames {
+    std::vector<uint32_t> names;
+    std::vector<uint32_t> begin;
+    std::vector<uint32_t> positions;
+    std::vector<uint64_t> prefix;
+};
+
+// The union of a thread's tasks as disjoint spans by start time; prefix[i]
+// is the total length of the first i spans.
+struct Coverage {
+    std::vector<uint64_t> starts;
+    std::vector<uint64_t> ends;
+    std::vector<uint64_t> prefix;
+};
+
+static std::vector<RowNames> g_rownames;
+static std::vector<Coverage> g_coverage;
+// rows of each thread, threads numbered as in g_tasksperproc
+static std::vector< std::vector<size_t> > g_threadrows;
+
+static void build_row_names(size_t row) {
+    const std::vector<Entry *> & tasks = g_rowtasks[row];
+    RowNames & index = g_rownames[row];
+    index.positions.resize(tasks.size());
+    for (uint32_t i = 0; i < (uint32_t) tasks.size(); ++i) {
+        index.positions[i] = i;
+    }
+    std::stable_sort(index.positions.begin(), index.positions.end(), [&tasks](uint32_t a, uint32_t b) {
+        return tasks[a]->name_index < tasks[b]->name_index;
+    });
+    index.prefix.reserve(tasks.size() + 1);
+    for (uint32_t i = 0; i < (uint32_t) index.positions.size(); ++i) {
+        const uint32_t name = tasks[index.positions[i]]->name_index;
+        if (index.names.empty() || index.names.back() != name) {
+            index.names.push_back(name);
+            index.begin.push_back(i);
+            index.prefix.push_back(0);
+        }
+        index.prefix.push_back(index.prefix.back() + tasks[index.positions[i]]->length);
+    }
+    index.begin.push_back((uint32_t) index.positions.size());
+}
+
+static void build_coverage(const std::vector<Entry *> & tasks, Coverage & coverage) {
+    for (const Entry * e : tasks) {
+        const uint64_t end = e->start + e->length;
+        if (!coverage.ends.empty() && e->start <= coverage.ends.back()) {
+            coverage.ends.back() = std::max(coverage.ends.back(), end);
+            continue;
+        }
+        coverage.starts.push_back(e->start);
+        coverage.ends.push_back(end);
+    }
+    coverage.prefix.resize(coverage.starts.size() + 1);
+    coverage.prefix[0] = 0;
+    for (size_t i = 0; i < coverage.starts.size(); ++i) {
+        coverage.prefix[i + 1] = coverage.prefix[i] + coverage.ends[i] - coverage.starts[i];
+    }
+}
+
+void build_range_index() {
+    g_rownames.assign(g_rowtasks.size(), RowNames());
+    parallel_for(0, g_rowtasks.size(), build_row_names);
+
+    std::vector<size_t> thread_base(1, 0);
+    for (const auto & threads : g_tasksperproc) {
+        thread_base.push_back(thread_base.back() + threads.size());
+    }
+    g_threadrows.assign(thread_base.back(), std::vector<size_t>());
+    for (size_t row = 0; row < rowdata.size() && row < g_rowtasks.size(); ++row) {
+        g_threadrows[thread_base[rowdata[row].first] + rowdata[row].second].push_back(row);
+    }
+    g_coverage.assign(thread_base.back(), Coverage());
+    parallel_for(0, g_tasksperproc.size(), [&thread_base](size_t proc) {
+        for (size_t thread = 0; thread < g_tasksperproc[proc].size(); ++thread) {
+            build_coverage(g_tasksperproc[proc][thread], g_coverage[thread_base[proc] + thread]);
+        }
+    });
+}
+
+void row_window(size_t row, uint64_t t0, uint64_t t1, size_t & first, size_t & last) {
+    const std::vector<Entry *> & tasks = g_rowtasks[row];
+    // ends are sorted as well, because the tasks of a row do not overlap
+    first = std::upper_bound(tasks.begin(), tasks.end(), t0, [](uint64_t t, const Entry * e) {
+        return t < e->start + e->length;
+    }) - tasks.begin();
+    last = std::lower_bound(tasks.begin() + first, tasks.end(), t1, [](const Entry * e, uint64_t t) {
+        return e->start < t;
+    }) - tasks.begin();
+}
+
+static uint64_t clipped(uint64_t start, uint64_t end, uint64_t t0, uint64_t t1) {
+    start = std::max(start, t0);
+    end = std::min(end, t1);
+    return end > start ? end - start : 0;
+}
+
+static uint64_t busy_time(const Coverage & coverage, uint64_t t0, uint64_t t1) {
+    const size_t first = std::upper_bound(coverage.ends.begin(), coverage.ends.end(), t0) - coverage.ends.begin();
+    const size_t last = std::lower_bound(coverage.starts.begin() + first, coverage.starts.end(), t1) - coverage.starts.begin();
+    if (first >= last) {
+        return 0;
+    }
+    if (last - first == 1) {
+        return clipped(coverage.starts[first], coverage.ends[first], t0, t1);
+    }
+    // whole spans in between, clipped ends at both sides
+    return coverage.prefix[last - 1] - coverage.prefix[first + 1] +
+           clipped(coverage.starts[first], coverage.ends[first], t0, t1) +
+           clipped(coverage.starts[last - 1], coverage.ends[last - 1], t0, t1);
+}
+
+// Adds the tasks [first, last) of the row to names, indexed by name.
+static void add_row_names(size_t row, size_t first, size_t last, uint64_t t0, uint64_t t1, std::vector<NameStats> & names) {
+    const RowNames & index = g_rownames[row];
+    for (size_t k = 0; k < index.names.size(); ++k) {
+        const auto begin = index.positions.begin() + index.begin[k];
+        const auto end = index.positions.begin() + index.begin[k + 1];
+        const size_t lo = std::lower_bound(begin, end, (uint32_t) first) - begin;
+        const size_t hi = std::lower_bound(begin, end, (uint32_t) last) - begin;
+        if (lo == hi) {
+            continue;
+        }
+        const size_t base = index.begin[k] + k;
+        NameStats & name = names[index.names[k]];
+        name.total += index.prefix[base + hi] - index.prefix[base + lo];
+        name.count += hi - lo;
+    }
+    // the first and last task were counted whole
+    const std::vector<Entry *> & tasks = g_rowtasks[row];
+    for (size_t i : { first, last - 1 }) {
+        const Entry * e = tasks[i];
+        names[e->name_index].total -= e->length - clipped(e->start, e->start + e->length, t0, t1);
+        if (last - first == 1) {
+            break;
+        }
+    }
+}
+
+static void collect_names(const std::vector<NameStats> & table, std::vector<NameStats> & names) {
+    for (uint32_t i = 0; i < (uint32_t) table.size(); ++i) {
+        if (table[i].count > 0) {
+            names.push_back(table[i]);
+            names.back().name_index = i;
+        }
+    }
+    std::sort(names.begin(), names.end(), [](const NameStats & a, const NameStats & b) {
+        return a.total > b.total;
+    });
+}
+
+RangeStats range_stats(uint64_t t0, uint64_t t1, bool with_names) {
+    RangeStats stats;
+    stats.t0 = t0;
+    stats.t1 = t1;
+    if (t1 <= t0 || g_rownames.size() != g_rowtasks.size()) {
+        return stats;
+    }
+
+    size_t index = 0;
+    for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
+        for (size_t thread = 0; thread < g_tasksperproc[proc].size(); ++thread, ++index) {
+            if (g_tasksperproc[proc][thread].empty()) {
+                continue;
+            }
+            ThreadStats stat;
+            stat.proc = proc;
+            stat.thread = thread;
+            stat.busy = busy_time(g_coverage[index], t0, t1);
+            stats.threads.push_back(stat);
+        }
+    }
+
+    if (!with_names) {
+        return stats;
+    }
+    std::vector<NameStats> names(g_names.size());
+    std::vector<NameStats> thread_names(g_names.size());
+    index = 0;
+    size_t listed = 0;
+    for (size_t proc = 0; proc < g_tasksperproc.size(); ++proc) {
+        for (size_t thread = 0; thread < g_tasksperproc[proc].size(); ++thread, ++index) {
+            if (g_tasksperproc[proc][thread].empty()) {
+                continue;
+            }
+            std::fill(thread_names.begin(), thread_names.end(), NameStats());
+            for (size_t row : g_threadrows[index]) {
+                size_t first, last;
+                row_window(row, t0, t1, first, last);
+                if (first < last) {
+                    add_row_names(row, first, last, t0, t1, thread_names);
+                }
+            }
+            ThreadStats & stat = stats.threads[listed++];
+            collect_names(thread_names, stat.names);
+            for (const NameStats & name : stat.names) {
+                names[name.name_index].total += name.total;
+                names[name.name_index].count += name.count;
+            }
+        }
+    }
+    collect_names(names, stats.names);
+    return stats;
+}
+
+// Formats into a local stream, so the caller's keeps its flags.
+void print_range_stats(const RangeStats & stats, std::ostream & out) {
+    const uint64_t duration = stats.t1 - stats.t0;
+    if (duration == 0) {
+        return;
+    }
+    uint64_t busy = 0;
+    for (const ThreadStats & thread : stats.threads) {
+        busy += thread.busy;
+    }
+
+    std::ostringstream text;
+    text << "range [ " << format(stats.t0) << ", " << format(stats.t1) << " ] duration=" << format(duration)
+         << " busy=" << std::setprecision(3) << std::fixed
+         << (stats.threads.empty() ? 0.0 : 100.0 * busy / ((double) duration * stats.threads.size())) << "%"
+         << " parallelism=" << busy / (double) duration << "\n";
+
+    // busiest threads first, each with its largest names
+    std::vector<const ThreadStats *> threads;
+    for (const ThreadStats & thread : stats.threads) {
+        threads.push_back(&thread);
+    }
+    std::sort(threads.begin(), threads.end(), [](const ThreadStats * a, const ThreadStats * b) {
+        return a->busy > b->busy;
+    });
+    for (size_t i = 0; i < threads.size() && i < 16; ++i) {
+        text << "  (" << threads[i]->proc << ", " << threads[i]->thread << ")"
+             << std::right << std::setw(10) << format(threads[i]->busy)
+             << std::setw(8) << std::setprecision(1) << 100.0 * threads[i]->busy / duration << "%" << "\n";
+        for (size_t j = 0; j < threads[i]->names.size() && j < 5; ++j) {
+            const NameStats & name = threads[i]->names[j];
+            text << "    " << std::left << std::setw(36) << g_names[name.name_index]
+                 << std::right << std::setw(10) << format(name.total)
+                 << std::setw(10) << name.count << "\n";
+        }
+    }
+
+    for (const NameStats & name : stats.names) {
+        text << std::left << std::setw(40) << g_names[name.name_index]
+             << std::right << std::setw(10) << format(name.total)
+             << std::setw(10) << name.count << "\n";
+    }
+    out << text.str() << std::flush;
+}
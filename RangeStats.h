@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Aggregates over a time window [t0, t1). As the tasks of a row never
+// overlap, the tasks that intersect the window are one contiguous run found
+// by binary search, and only the first and last of the run need clipping.
+// Every row keeps, per name it contains, the positions of that name's tasks
+// and prefix sums of their lengths, so a name's total and count inside the
+// run take two more binary searches. Busy time comes from the union of all
+// of a thread's tasks, kept as sorted spans with prefix sums, so tasks that
+// only partly overlap their neighbours and were pushed to deeper rows
+// count as well.
+
+struct NameStats {
+    uint32_t name_index = 0;
+    uint64_t total = 0;     // time inside the window
+    uint64_t count = 0;     // tasks intersecting the window
+};
+
+struct ThreadStats {
+    uint64_t proc = 0;
+    uint64_t thread = 0;
+    uint64_t busy = 0;      // time covered by any of the thread's tasks
+    std::vector<NameStats> names;   // as RangeStats::names, for this thread
+};
+
+struct RangeStats {
+    uint64_t t0 = 0;
+    uint64_t t1 = 0;
+    std::vector<ThreadStats> threads;
+    std::vector<NameStats> names;   // largest total first, names without tasks left out
+};
+
+// Prefix sums for every row and thread; call once the rows have been
+// generated.
+void build_range_index();
+
+// Tasks [first, last) of g_rowtasks[row] intersect [t0, t1); two binary
+// searches.
+void row_window(size_t row, uint64_t t0, uint64_t t1, size_t & first, size_t & last);
+
+// Busy time per thread in O(threads * log n); the per-name tables in
+// O(log n) per name of every row, however many tasks the window holds.
+RangeStats range_stats(uint64_t t0, uint64_t t1, bool with_names);
+
+void print_range_stats(const RangeStats & stats, std::ostream & out);
@@ -11,7 +11,10 @@
 #pragma comment( lib, "C:\\proj\\VulkanSDK\\1.3.239.0\\Lib\\shaderc_combined.lib" )
 #endif
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <vector>
 
@@ -65,6 +68,30 @@ static uint32_t get_queue_family_index(VkPhysicalDevice physical_device, VkSurfa
     return -1;
 }
 
+// A transfer-only family is usually backed by a dedicated copy engine.
+static uint32_t get_transfer_queue_family_index(VkPhysicalDevice physical_device, uint32_t fallback) {
+    std::vector<VkQueueFamilyProperties> queue_family_properties;
+    uint32_t count;
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, nullptr);
+    queue_family_properties.resize(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &count, queue_family_properties.data());
+
+    for (uint32_t i = 0; i < (uint32_t) queue_family_properties.size(); ++i) {
+        if (queue_family_properties[i].queueCount == 0) {
+            continue;
+        }
+        const VkQueueFlags flags = queue_family_properties[i].queueFlags;
+        if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+            return i;
+        }
+    }
+    return fallback;
+}
+
+static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////
 
 Render::~Render() {
@@ -80,6 +107,13 @@ Render::~Render() {
     vkDestroyCommandPool(m_device, m_command_pool, nullptr);
     vkDestroyPipeline(m_device, m_pipeline[0], nullptr);
     vkDestroyPipeline(m_device, m_pipeline[1], nullptr);
+    vkDestroyPipeline(m_device, m_pipeline[2], nullptr);
+    vkDestroyPipeline(m_device, m_pipeline[3], nullptr);
+    vkDestroyPipeline(m_device, m_pipeline[4], nullptr);
+    vkDestroyPipeline(m_device, m_pipeline[5], nullptr);
+    vkDestroyPipeline(m_device, m_pipeline[6], nullptr);
+    vkDestroyPipeline(m_device, m_heat_pipelines[0], nullptr);
+    vkDestroyPipeline(m_device, m_heat_pipelines[1], nullptr);
     vkDestroyPipelineLayout(m_device, m_pipeline_layout, nullptr);
 
     vkUnmapMemory(m_device, m_uniform_buffer_memory);
@@ -97,8 +131,42 @@ Render::~Render() {
     for (VkSemaphore semaphore : m_swapchain_release_semaphore) {
         vkDestroySemaphore(m_device, semaphore, nullptr);
     }
-    vkDestroyBuffer(m_device, m_vertex_buffer, nullptr);
-    vkFreeMemory(m_device, m_vertex_buffer_memory, nullptr);
+    destroy_geometry(m_geometry);
+    for (Geometry & geometry : m_retired) {
+        destroy_geometry(geometry);
+    }
+    for (Geometry & geometry : m_preview) {
+        destroy_geometry(geometry);
+    }
+    for (StorageBinding * storage : { &m_highlight, &m_palette, &m_slots, &m_minimap, &m_gaps }) {
+        for (StorageBuffer & version : storage->versions) {
+            destroy_storage_buffer(version);
+        }
+    }
+    for (CounterSlot & slot : m_counter_slots) {
+        destroy_counter_slot(slot);
+    }
+    for (IndexList & index_list : m_index_lists) {
+        destroy_index_list(index_list);
+    }
+    for (StagingSlot & slot : m_staging_slots) {
+        vkDestroyFence(m_device, slot.fence, nullptr);
+    }
+    vkDestroyCommandPool(m_device, m_transfer_command_pool, nullptr);
+    vkDestroyQueryPool(m_device, m_query_pool, nullptr);
+    vkUnmapMemory(m_device, m_overlay_memory);
+    vkDestroyBuffer(m_device, m_overlay_buffer, nullptr);
+    vkFreeMemory(m_device, m_overlay_memory, nullptr);
+    vkUnmapMemory(m_device, m_indirect_memory);
+    vkDestroyBuffer(m_device, m_indirect_buffer, nullptr);
+    vkFreeMemory(m_device, m_indirect_memory, nullptr);
+    vkDestroyBuffer(m_device, m_heat_buffer, nullptr);
+    vkFreeMemory(m_device, m_heat_memory, nullptr);
+    vkDestroyBuffer(m_device, m_tile_buffer, nullptr);
+    vkFreeMemory(m_device, m_tile_memory, nullptr);
+    vkUnmapMemory(m_device, m_staging_memory);
+    vkDestroyBuffer(m_device, m_staging_buffer, nullptr);
+    vkFreeMemory(m_device, m_staging_memory, nullptr);
     vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
     vkDestroyDevice(m_device, nullptr);
     vkDestroyInstance(m_instance, nullptr);
@@ -119,6 +187,45 @@ bool Render::resize() {
         return false;
     }
 
+    return recreate_swapchain(surface_capabilities);
+}
+
+bool Render::set_present_mode(VkPresentModeKHR present_mode) {
+    m_present_mode = present_mode;
+    if (!m_init) {
+        return true;
+    }
+
+    VkSurfaceCapabilitiesKHR surface_capabilities;
+    VkResult res = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physical_device, m_surface, &surface_capabilities);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    return recreate_swapchain(surface_capabilities);
+}
+
+void Render::set_overlay(bool overlay) {
+    if (overlay != m_overlay) {
+        m_overlay = overlay;
+        ++m_draw_version;
+    }
+}
+
+void Render::show_minimap(bool show) {
+    if (show != m_minimap_shown) {
+        m_minimap_shown = show;
+        ++m_draw_version;
+    }
+}
+
+void Render::set_heatmap(bool heatmap) {
+    if (heatmap != m_heatmap) {
+        m_heatmap = heatmap;
+        ++m_draw_version;
+    }
+}
+
+bool Render::recreate_swapchain(VkSurfaceCapabilitiesKHR & surface_capabilities) {
     vkDeviceWaitIdle(m_device);
 
     m_extent = surface_capabilities.currentExtent;
@@ -128,9 +235,13 @@ bool Render::resize() {
         return false;
     }
 
-    // apparently command buffers can reference the old swap chain, so they need to be recreated here? source?
-    vkFreeCommandBuffers(m_device, m_command_pool, static_cast<uint32_t>(m_command_buffers.size()), m_command_buffers.data());
-    create_command_buffers();
+    // the new swapchain may have more images than the old one
+    while (m_swapchain_release_semaphore.size() < m_images.size()) {
+        m_swapchain_release_semaphore.push_back(create_semaphore(m_device, VkSemaphoreCreateFlags()));
+    }
+
+    // the recorded draw commands bake in the viewport
+    ++m_draw_version;
 
     m_frame = 0;
 
@@ -139,16 +250,20 @@ bool Render::resize() {
 
 VkResult Render::acquire_next_image(uint32_t frame, uint32_t & image_index) {
 
-    VkResult res = vkAcquireNextImageKHR(m_device, m_swapchain, UINT64_MAX, m_swapchain_acquire_semaphore[frame], VK_NULL_HANDLE, &image_index);
+    // the frame that last used this slot must have finished on the GPU; never
+    // wait for it, the caller retries later instead
+    VkResult res = vkGetFenceStatus(m_device, m_queue_submit_fence[frame]);
     if (res != VK_SUCCESS) {
         return res;
     }
 
-    res = vkWaitForFences(m_device, 1, &m_queue_submit_fence[image_index], true, UINT64_MAX);
-    if (res != VK_SUCCESS) {
+    res = vkAcquireNextImageKHR(m_device, m_swapchain, 0, m_swapchain_acquire_semaphore[frame], VK_NULL_HANDLE, &image_index);
+    if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR) {
         return res;
     }
-    res = vkResetFences(m_device, 1, &m_queue_submit_fence[image_index] );
+
+    // a suboptimal image is still acquired; present reports it again and triggers the resize
+    res = vkResetFences(m_device, 1, &m_queue_submit_fence[frame] );
     if (res != VK_SUCCESS) {
         return res;
     }
@@ -156,28 +271,42 @@ VkResult Render::acquire_next_image(uint32_t frame, uint32_t & image_index) {
     return VK_SUCCESS;
 }
 
-void Render::draw() {
+bool Render::draw() {
+    if (!has_geometry()) {
+        return true;
+    }
+
+    const std::chrono::steady_clock::time_point acquire_start = std::chrono::steady_clock::now();
     uint32_t index;
     VkResult res = acquire_next_image(m_frame, index);
-    m_frame += 1;
-    m_frame %= IMAGE_COUNT;
 
     // Handle outdated error in acquire.
-    if (res == VK_SUBOPTIMAL_KHR || res == VK_ERROR_OUT_OF_DATE_KHR) {
+    if (res == VK_ERROR_OUT_OF_DATE_KHR) {
         resize();
         res = acquire_next_image(m_frame, index);
     }
 
+    if (res == VK_NOT_READY || res == VK_TIMEOUT) {
+        return false;
+    }
     if (res != VK_SUCCESS) {
         vkQueueWaitIdle(m_queue);
-        return;
+        return true;
     }
 
-    if (!render(index)) {
-        return;
+    const double acquire_ms = elapsed_ms(acquire_start);
+
+    const uint32_t frame = m_frame;
+    m_frame += 1;
+    m_frame %= IMAGE_COUNT;
+    m_frame_id += 1;
+
+    if (!render(frame, index)) {
+        return true;
     }
 
     // present
+    const std::chrono::steady_clock::time_point present_start = std::chrono::steady_clock::now();
     VkPresentInfoKHR present_info{
         VK_STRUCTURE_TYPE_PRESENT_INFO_KHR, nullptr,
         1, &m_swapchain_release_semaphore[index],   // wait semaphores
@@ -187,14 +316,23 @@ void Render::draw() {
     };
     res = vkQueuePresentKHR(m_queue, &present_info);
 
+    // GPU times are filled in by read_timestamps() once the frame slot comes around again
+    if (m_stats != nullptr) {
+        FrameRecord & record = m_stats->add(m_frame_id);
+        record.acquire_ms = acquire_ms;
+        record.record_ms = m_record_ms;
+        record.submit_ms = m_submit_ms;
+        record.present_ms = elapsed_ms(present_start);
+    }
+
     // Handle Outdated error in present.
     if (res == VK_SUBOPTIMAL_KHR || res == VK_ERROR_OUT_OF_DATE_KHR) {
         resize();
     } else if (res != VK_SUCCESS) {
         // Failed to present swapchain image.
         vkQueueWaitIdle(m_queue);
-        return;
     }
+    return true;
 }
 
 VkInstance Render::create_instance() {
@@ -356,15 +494,25 @@ VkDeviceMemory Render::alloc(VkBuffer buffer, VkMemoryPropertyFlags properties)
     return memory;
 }
 
-VkDevice Render::create_device(VkPhysicalDevice physical_device, uint32_t queue_family_index) {
+VkDevice Render::create_device(VkPhysicalDevice physical_device, uint32_t queue_family_index, uint32_t transfer_queue_family_index) {
     float const priorities[1] = {1.0};
-    VkDeviceQueueCreateInfo queue_create_info{
-        VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr,
-        VkDeviceQueueCreateFlags{},
-        queue_family_index,
-        1, // queueCount
-        priorities
+    VkDeviceQueueCreateInfo queue_create_info[2] = {
+        {
+            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr,
+            VkDeviceQueueCreateFlags{},
+            queue_family_index,
+            1, // queueCount
+            priorities
+        },
+        {
+            VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, nullptr,
+            VkDeviceQueueCreateFlags{},
+            transfer_queue_family_index,
+            1, // queueCount
+            priorities
+        }
     };
+    const uint32_t queue_create_info_count = transfer_queue_family_index != queue_family_index ? 2 : 1;
 
     VkPhysicalDeviceDynamicRenderingFeaturesKHR dynamic_rendering_feature {
         VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR,
@@ -372,14 +520,20 @@ VkDevice Render::create_device(VkPhysicalDevice physical_device, uint32_t queue_
         VK_TRUE
     };
 
+    // the ranges in view go out in one indirect call where the device allows it
+    VkPhysicalDeviceFeatures supported_features;
+    vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+    VkPhysicalDeviceFeatures features{};
+    features.multiDrawIndirect = supported_features.multiDrawIndirect;
+
     VkDeviceCreateInfo device_create_info{
         VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         &dynamic_rendering_feature,
         VkDeviceCreateFlags{},
-        1, &queue_create_info,
+        queue_create_info_count, queue_create_info,
         0, nullptr, // ppEnabledLayerNames
         static_cast<uint32_t>(sizeof(DEVICE_EXTENSIONS)/sizeof(DEVICE_EXTENSIONS[0])), DEVICE_EXTENSIONS,
-        nullptr // pEnabledFeatures
+        &features // pEnabledFeatures
     };
 
     VkDevice device;
@@ -404,6 +558,20 @@ bool Render::create_swapchain(VkSwapchainKHR old_swapchain, VkSurfaceCapabilitie
         return false;
     }
 
+    // FIFO is the only mode every surface has to support
+    uint32_t present_mode_count;
+    VkResult res = vkGetPhysicalDeviceSurfacePresentModesKHR(m_physical_device, m_surface, &present_mode_count, nullptr);
+    if (res == VK_SUCCESS) {
+        m_present_modes.resize(present_mode_count);
+        res = vkGetPhysicalDeviceSurfacePresentModesKHR(m_physical_device, m_surface, &present_mode_count, m_present_modes.data());
+    }
+    if (res != VK_SUCCESS) {
+        m_present_modes.assign(1, VK_PRESENT_MODE_FIFO_KHR);
+    }
+    if (std::find(m_present_modes.begin(), m_present_modes.end(), m_present_mode) == m_present_modes.end()) {
+        m_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+    }
+
     VkSwapchainCreateInfoKHR swapchain_create_info{
         VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR, nullptr,
         VkSwapchainCreateFlagsKHR(),                // Flags
@@ -419,11 +587,11 @@ bool Render::create_swapchain(VkSwapchainKHR old_swapchain, VkSurfaceCapabilitie
         nullptr,                                    // Queue family indices
         VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,      // Pre transform
         VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,          // Composite alpha
-        VK_PRESENT_MODE_MAILBOX_KHR,                // Present mode
+        m_present_mode,                             // Present mode
         VK_TRUE,                                    // Clipped
         old_swapchain};                              // Old swapchain
 
-    VkResult res = vkCreateSwapchainKHR(m_device, &swapchain_create_info, nullptr, &m_swapchain);
+    res = vkCreateSwapchainKHR(m_device, &swapchain_create_info, nullptr, &m_swapchain);
     if (old_swapchain != VK_NULL_HANDLE) {
         vkDestroySwapchainKHR(m_device, old_swapchain, nullptr);
     }
@@ -481,31 +649,257 @@ bool Render::create_command_buffers() {
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
         m_command_pool,                   // commandPool
         VK_COMMAND_BUFFER_LEVEL_PRIMARY,  // level
-        1                                 // commandBufferCount
-    };                               
+        IMAGE_COUNT                       // commandBufferCount
+    };
 
-    m_command_buffers.resize(m_image_views.size());
-    for (int i = 0; i < m_image_views.size(); ++i) {
-        VkResult res = vkAllocateCommandBuffers(m_device, &allocate_info, &m_command_buffers[i]);
-        if (res != VK_SUCCESS) {
-            return false;
+    // one primary per frame in flight, re-recorded every frame
+    VkResult res = vkAllocateCommandBuffers(m_device, &allocate_info, m_command_buffers);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+
+    // one secondary per frame in flight holding the draws, re-recorded only when they change
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    res = vkAllocateCommandBuffers(m_device, &allocate_info, m_draw_command_buffers);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    return true;
+}
+
+// Picks the geometry to draw. Geometry is drawn once the transfer queue has
+// finished copying it; bumps m_draw_version whenever the selection changes.
+void Render::update_draw_list() {
+    const uint64_t completed = poll_uploads();
+    const bool final_ready = m_uploaded && m_geometry.upload_serial <= completed;
+    if (final_ready && !m_preview.empty()) {
+        // frames in flight may still draw the previews, so they go once those are done
+        for (Geometry & geometry : m_preview) {
+            geometry.retired_frame = m_frame_id;
+            m_retired.push_back(geometry);
+        }
+        m_preview.clear();
+    }
+    for (size_t i = 0; i < m_retired.size();) {
+        if (m_frame_id <= m_retired[i].retired_frame + IMAGE_COUNT) {
+            ++i;
+            continue;
+        }
+        destroy_geometry(m_retired[i]);
+        m_retired.erase(m_retired.begin() + i);
+    }
+
+    size_t preview_count = final_ready ? 0 : m_preview.size();
+    while (preview_count > 0 && m_preview[preview_count - 1].upload_serial > completed) {
+        --preview_count;
+    }
+
+    std::vector<uint32_t> tile_draws;
+    for (uint32_t slot : m_tile_requested) {
+        if (m_tile_slots[slot].upload_serial <= completed) {
+            tile_draws.push_back(slot);
+        }
+    }
+
+    if (final_ready != m_draw_final || preview_count != m_draw_preview_count || tile_draws != m_tile_draws) {
+        m_draw_final = final_ready;
+        m_draw_preview_count = preview_count;
+        m_tile_draws.swap(tile_draws);
+        ++m_draw_version;
+    }
+    // this frame draws them, so they stay untouched until it is done
+    for (uint32_t slot : m_tile_draws) {
+        m_tile_slots[slot].drawn_frame = m_frame_id;
+    }
+}
+
+bool Render::record_draw_commands(uint32_t frame) {
+    if (m_draw_recorded_version[frame] == m_draw_version) {
+        return true;
+    }
+
+    VkCommandBuffer command_buffer = m_draw_command_buffers[frame];
+
+    VkCommandBufferInheritanceRenderingInfoKHR inheritance_rendering_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR, nullptr,
+        VkRenderingFlagsKHR(),
+        0,                          // viewMask
+        1, &COLOR_FORMAT,           // color attachment formats
+        VK_FORMAT_UNDEFINED,        // depthAttachmentFormat
+        VK_FORMAT_UNDEFINED,        // stencilAttachmentFormat
+        SAMPLES                     // rasterizationSamples
+    };
+    VkCommandBufferInheritanceInfo inheritance_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO, &inheritance_rendering_info,
+        VK_NULL_HANDLE, 0,          // renderPass, subpass
+        VK_NULL_HANDLE,             // framebuffer
+        VK_FALSE, 0, 0              // queries
+    };
+    VkCommandBufferBeginInfo begin_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+        VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        &inheritance_info
+    };
+    VkResult res = vkBeginCommandBuffer(command_buffer, &begin_info);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+
+    VkViewport vp{ 0.0f, 0.0f, static_cast<float>(m_extent.width), static_cast<float>(m_extent.height), 0.0f, 1.0f };
+    vkCmdSetViewport(command_buffer, 0, 1, &vp);
+
+    VkRect2D scissor{ { 0, 0 }, { m_extent.width, m_extent.height } };
+    vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 0, 1, &m_descriptor_sets[frame], 0, nullptr);
+
+    const uint32_t query = frame * QUERIES_PER_FRAME;
+    if (m_query_pool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_query_pool, query);
+    }
+
+    const Geometry * geometries = m_draw_final ? &m_geometry : m_preview.data();
+    const size_t geometry_count = m_draw_final ? 1 : m_draw_preview_count;
+    VkDeviceSize offsets[] = {0};
+
+    // the index lists of a filter only apply to the final geometry
+    Geometry filtered;
+    const IndexList & indices = m_bound_indices[frame];
+    if (m_draw_final && indices.buffer != VK_NULL_HANDLE) {
+        filtered = m_geometry;
+        filtered.index_count_line = indices.index_count_line;
+        filtered.index_count_tri = indices.index_count_tri;
+        filtered.index_offset_line = 0;
+        filtered.index_offset_tri = indices.index_offset_tri;
+        geometries = &filtered;
+    }
+    const VkBuffer index_buffer = geometries == &filtered ? indices.buffer : VK_NULL_HANDLE;
+    const bool culled = m_draw_final && m_culling;
+
+    // the heatmap replaces the lines and triangles of the final geometry
+    const bool heatmap = m_heatmap && m_draw_final;
+    if (heatmap) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[4]);
+        vkCmdDraw(command_buffer, 6, 1, 0, 0);
+    }
+
+    // idle gaps behind the tasks, one instance each
+    if (m_draw_final && m_gaps.count[frame] > 0) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[5]);
+        vkCmdDraw(command_buffer, 6, m_gaps.count[frame], 0, 0);
+    }
+
+    // counter graphs, one segment per pair of points
+    if (m_draw_final && m_counter_slots[frame].count > 1) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[6]);
+        vkCmdDraw(command_buffer, 2 * (m_counter_slots[frame].count - 1), 1, 0, 0);
+    }
+
+    // lines
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[1]);
+    for (size_t i = 0; i < geometry_count && !heatmap; ++i) {
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, &geometries[i].buffer, offsets);
+        vkCmdBindIndexBuffer(command_buffer, index_buffer != VK_NULL_HANDLE ? index_buffer : geometries[i].buffer, geometries[i].index_offset_line, VK_INDEX_TYPE_UINT32);
+        if (culled) {
+            draw_visible(command_buffer, frame, false);
+        } else {
+            vkCmdDrawIndexed(command_buffer, geometries[i].index_count_line, 1, 0, 0, 0);
+        }
+    }
+    draw_tiles(command_buffer, false);
+    if (m_query_pool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_query_pool, query + 1);
+    }
+
+    // triangles
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[0]);
+    for (size_t i = 0; i < geometry_count && !heatmap; ++i) {
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, &geometries[i].buffer, offsets);
+        vkCmdBindIndexBuffer(command_buffer, index_buffer != VK_NULL_HANDLE ? index_buffer : geometries[i].buffer, geometries[i].index_offset_tri, VK_INDEX_TYPE_UINT32);
+        if (culled) {
+            draw_visible(command_buffer, frame, true);
+        } else {
+            vkCmdDrawIndexed(command_buffer, geometries[i].index_count_tri, 1, 0, 0, 0);
         }
     }
+    draw_tiles(command_buffer, true);
+    if (m_query_pool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_query_pool, query + 2);
+    }
+
+    // overview strip, positioned by the vertex shader
+    if (m_minimap_shown && m_draw_final) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[3]);
+        vkCmdDraw(command_buffer, 6, 1, 0, 0);
+    }
+
+    // frame time graph; the vertices are rewritten every frame by update_overlay()
+    if (m_overlay) {
+        const VkDeviceSize overlay_offset = frame * OVERLAY_VERTICES * sizeof(overlay_vertex_t);
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[2]);
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, &m_overlay_buffer, &overlay_offset);
+        vkCmdDraw(command_buffer, OVERLAY_VERTICES, 1, 0, 0);
+    }
+
+    res = vkEndCommandBuffer(command_buffer);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_draw_recorded_version[frame] = m_draw_version;
     return true;
 }
 
-bool Render::render(uint32_t swapchain_index) {
+bool Render::render(uint32_t frame, uint32_t swapchain_index) {
+    const std::chrono::steady_clock::time_point record_start = std::chrono::steady_clock::now();
+
+    // the fence for this frame has been waited for, so its uniform slot,
+    // queries and draw commands are no longer in use by the GPU
+    read_timestamps(frame);
+    update_draw_list();
+    bind_storage(m_highlight, frame);
+    bind_storage(m_palette, frame);
+    bind_indices(frame);
+    bind_storage(m_slots, frame);
+    bind_storage(m_minimap, frame);
+    bind_storage(m_gaps, frame);
+    if (!update_counter_slot(frame)) {
+        return false;
+    }
+    // the draw commands of the visible ranges, which the heatmap bins as well
+    update_indirect(frame);
+    bind_heat_sources(frame);
+    if (!update_uniform_buffer(frame)) {
+        return false;
+    }
+    if (m_overlay) {
+        update_overlay(frame);
+    }
+    if (!record_draw_commands(frame)) {
+        return false;
+    }
+
+    VkCommandBuffer command_buffer = m_command_buffers[frame];
 
     VkCommandBufferBeginInfo begin_info{
         VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
         VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, // flags
         nullptr                                      // pInheritanceInfo
     };
-    VkResult res = vkBeginCommandBuffer(m_command_buffers[swapchain_index], &begin_info);
+    VkResult res = vkBeginCommandBuffer(command_buffer, &begin_info);
     if (res != VK_SUCCESS) {
         return false;
     }
 
+    if (m_query_pool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(command_buffer, m_query_pool, frame * QUERIES_PER_FRAME, QUERIES_PER_FRAME);
+        m_query_frame[frame] = m_frame_id;
+    }
+
+    // the heatmap is binned before rendering starts
+    if (m_heatmap && m_draw_final) {
+        record_heatmap(command_buffer, frame);
+    }
+
     // transition image to VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
     {
         const VkImageMemoryBarrier image_memory_barrier{
@@ -526,7 +920,7 @@ bool Render::render(uint32_t swapchain_index) {
             }
         };
         vkCmdPipelineBarrier(
-            m_command_buffers[swapchain_index],
+            command_buffer,
             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,              // srcStageMask
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // dstStageMask
             0,                                              // dependencyFlags
@@ -552,35 +946,13 @@ bool Render::render(uint32_t swapchain_index) {
     rendering_info.pColorAttachments = &color_attachment;
     rendering_info.pDepthAttachment = VK_NULL_HANDLE;
     rendering_info.pStencilAttachment = VK_NULL_HANDLE;
+    rendering_info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR;
 
-    vkCmdBeginRenderingKHR(m_command_buffers[swapchain_index], &rendering_info);
-
-    VkViewport vp{ 0.0f, 0.0f, static_cast<float>(m_extent.width), static_cast<float>(m_extent.height), 0.0f, 1.0f };
-    vkCmdSetViewport(m_command_buffers[swapchain_index], 0, 1, &vp);
-
-    VkRect2D scissor{ { 0, 0 }, { m_extent.width, m_extent.height } };
-    vkCmdSetScissor(m_command_buffers[swapchain_index], 0, 1, &scissor);
-
-    vkCmdBindDescriptorSets(m_command_buffers[swapchain_index], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline_layout, 0, 1, &m_descriptor_set, 0, nullptr);
-
-    if (!update_uniform_buffer()) {
-        return false;
-    }
-
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(m_command_buffers[swapchain_index], 0, 1, &m_vertex_buffer, offsets);
-
-    // lines
-    vkCmdBindPipeline(m_command_buffers[swapchain_index], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[1]);
-    vkCmdBindIndexBuffer(m_command_buffers[swapchain_index], m_vertex_buffer, m_vertex_buffer_index_offset_line, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(m_command_buffers[swapchain_index], m_index_count_line, 1, 0, 0, 0);
+    vkCmdBeginRenderingKHR(command_buffer, &rendering_info);
 
-    // triangles
-    vkCmdBindPipeline(m_command_buffers[swapchain_index], VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline[0]);
-    vkCmdBindIndexBuffer(m_command_buffers[swapchain_index], m_vertex_buffer, m_vertex_buffer_index_offset_tri, VK_INDEX_TYPE_UINT32);
-    vkCmdDrawIndexed(m_command_buffers[swapchain_index], m_index_count_tri, 1, 0, 0, 0);
+    vkCmdExecuteCommands(command_buffer, 1, &m_draw_command_buffers[frame]);
 
-    vkCmdEndRenderingKHR(m_command_buffers[swapchain_index]);
+    vkCmdEndRenderingKHR(command_buffer);
 
     // transition image to VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
     {
@@ -602,7 +974,7 @@ bool Render::render(uint32_t swapchain_index) {
             }
         };
         vkCmdPipelineBarrier(
-            m_command_buffers[swapchain_index],
+            command_buffer,
             VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,  // srcStageMask
             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,           // dstStageMask
             0,                                              // dependencyFlags
@@ -612,74 +984,224 @@ bool Render::render(uint32_t swapchain_index) {
         );
     }
 
-    res = vkEndCommandBuffer(m_command_buffers[swapchain_index]);
+    res = vkEndCommandBuffer(command_buffer);
     if (res != VK_SUCCESS) {
         return false;
     }
+    m_record_ms = elapsed_ms(record_start);
 
     // Submit command buffer to graphics queue
+    const std::chrono::steady_clock::time_point submit_start = std::chrono::steady_clock::now();
     VkPipelineStageFlags wait_stage{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
     VkSubmitInfo submit_info{
         VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
-        1, &m_swapchain_acquire_semaphore[swapchain_index],
+        1, &m_swapchain_acquire_semaphore[frame],
         &wait_stage,
-        1, &m_command_buffers[swapchain_index],
+        1, &command_buffer,
         1, &m_swapchain_release_semaphore[swapchain_index]
     };
     res = vkQueueSubmit(m_queue,
         1, &submit_info,
-        m_queue_submit_fence[swapchain_index]);
+        m_queue_submit_fence[frame]);
     if (res != VK_SUCCESS) {
         return false;
     }
+    m_submit_ms = elapsed_ms(submit_start);
     return true;
 }
 
+// Timestamps of the frame that last used this slot. Its fence has signalled,
+// so the results are available without waiting.
+void Render::read_timestamps(uint32_t frame) {
+    if (m_query_pool == VK_NULL_HANDLE || m_query_frame[frame] == 0) {
+        return;
+    }
+    const uint64_t frame_id = m_query_frame[frame];
+    m_query_frame[frame] = 0;
+
+    uint64_t ticks[QUERIES_PER_FRAME];
+    VkResult res = vkGetQueryPoolResults(m_device, m_query_pool, frame * QUERIES_PER_FRAME, QUERIES_PER_FRAME,
+        sizeof(ticks), ticks, sizeof(ticks[0]), VK_QUERY_RESULT_64_BIT);
+    if (res != VK_SUCCESS || m_stats == nullptr) {
+        return;
+    }
+    FrameRecord * record = m_stats->find(frame_id);
+    if (record == nullptr) {
+        return;
+    }
+    const double ms_per_tick = m_timestamp_period * 1e-6;
+    record->gpu_lines_ms = (ticks[1] - ticks[0]) * ms_per_tick;
+    record->gpu_triangles_ms = (ticks[2] - ticks[1]) * ms_per_tick;
+}
+
+// Bar graph of the last OVERLAY_BARS frames in the bottom left corner, newest
+// on the right: CPU time in blue with GPU time stacked on top in red.
+void Render::update_overlay(uint32_t frame) {
+    overlay_vertex_t * vertices = m_overlay_data + frame * OVERLAY_VERTICES;
+    uint32_t count = 0;
+    auto quad = [&](float x0, float y0, float x1, float y1, color_t color) {
+        vertices[count++] = { { x0, y0 }, color };
+        vertices[count++] = { { x1, y0 }, color };
+        vertices[count++] = { { x1, y1 }, color };
+        vertices[count++] = { { x0, y0 }, color };
+        vertices[count++] = { { x1, y1 }, color };
+        vertices[count++] = { { x0, y1 }, color };
+    };
+
+    const float left = -0.98f;
+    const float bottom = 0.98f;
+    const float bar_width = 0.6f / OVERLAY_BARS;
+    const float ms_height = 0.01f;
+    const double max_ms = 50.0;
+    const float budget = bottom - 16.667f * ms_height;
+    quad(left, budget - 0.004f, left + OVERLAY_BARS * bar_width, budget, { 0.0f, 0.6f, 0.0f });
+
+    const size_t bars = m_stats != nullptr ? std::min<size_t>(OVERLAY_BARS, m_stats->size()) : 0;
+    for (size_t i = 0; i < bars; ++i) {
+        const FrameRecord & record = m_stats->recent(i);
+        const double cpu_ms = std::max(record.acquire_ms, 0.0) + std::max(record.record_ms, 0.0)
+            + std::max(record.submit_ms, 0.0) + std::max(record.present_ms, 0.0);
+        const double gpu_ms = std::max(record.gpu_lines_ms, 0.0) + std::max(record.gpu_triangles_ms, 0.0);
+
+        const float x1 = left + (OVERLAY_BARS - i) * bar_width;
+        const float x0 = x1 - bar_width * 0.8f;
+        const float y_cpu = bottom - (float) std::min(cpu_ms, max_ms) * ms_height;
+        const float y_gpu = y_cpu - (float) std::min(gpu_ms, max_ms) * ms_height;
+        quad(x0, y_cpu, x1, bottom, { 0.2f, 0.3f, 0.9f });
+        quad(x0, y_gpu, x1, y_cpu, { 0.9f, 0.2f, 0.2f });
+    }
+
+    // bars that have no frame yet collapse to degenerate triangles
+    memset(vertices + count, 0, (OVERLAY_VERTICES - count) * sizeof(overlay_vertex_t));
+}
+
 bool Render::setup_descriptors() {
-    VkDescriptorSetLayoutBinding set_layout_binding{
-        0,                                  // binding
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
-        1,                                  // descriptorCount
-        VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
-        nullptr                             // pImmutableSamplers
+    VkDescriptorSetLayoutBinding set_layout_bindings[11] = {
+        {
+            0,                                  // binding
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_COMPUTE_BIT, // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            1,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            2,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            3,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT, // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            4,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_FRAGMENT_BIT,       // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            5,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            6,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            7,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            8,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            9,                                  // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_VERTEX_BIT,         // stageFlags
+            nullptr                             // pImmutableSamplers
+        },
+        {
+            10,                                 // binding
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            1,                                  // descriptorCount
+            VK_SHADER_STAGE_COMPUTE_BIT,        // stageFlags
+            nullptr                             // pImmutableSamplers
+        }
     };
     VkDescriptorSetLayoutCreateInfo set_layout_create_info{
         VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, nullptr,
         VkDescriptorSetLayoutCreateFlags{},
-        1, &set_layout_binding              // bindings
+        11, set_layout_bindings             // bindings
     };
     VkResult res = vkCreateDescriptorSetLayout(m_device, &set_layout_create_info, nullptr, &m_descriptor_set_layout);
     if (res != VK_SUCCESS) {
         return false;
     }
 
-    VkDescriptorPoolSize descriptor_pool_size{
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-        1                           // descriptorCount
+    VkDescriptorPoolSize descriptor_pool_sizes[2] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, IMAGE_COUNT },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10 * IMAGE_COUNT }
     };
     VkDescriptorPoolCreateInfo descriptor_pool_create_info{
         VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, nullptr,
         VkDescriptorPoolCreateFlags{},
-        1,                          // maxSets
-        1, &descriptor_pool_size    // pool sizes
+        IMAGE_COUNT,                // maxSets
+        2, descriptor_pool_sizes    // pool sizes
     };
     res = vkCreateDescriptorPool(m_device, &descriptor_pool_create_info, nullptr, &m_descriptor_pool);
     if (res != VK_SUCCESS) {
         return false;
     }
 
+    // one descriptor set and uniform slot per frame in flight, so the CPU
+    // never writes view state that an earlier frame is still reading
+    VkDescriptorSetLayout set_layouts[IMAGE_COUNT];
+    for (VkDescriptorSetLayout & set_layout : set_layouts) {
+        set_layout = m_descriptor_set_layout;
+    }
     VkDescriptorSetAllocateInfo descriptor_set_alloc_info{
         VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, nullptr,
         m_descriptor_pool,              // descriptorPool
-        1, &m_descriptor_set_layout     // descriptor set layouts
+        IMAGE_COUNT, set_layouts        // descriptor set layouts
     };
-    res = vkAllocateDescriptorSets(m_device, &descriptor_set_alloc_info, &m_descriptor_set);
+    res = vkAllocateDescriptorSets(m_device, &descriptor_set_alloc_info, m_descriptor_sets);
     if (res != VK_SUCCESS) {
         return false;
     }
 
     // create uniform buffer
-    VkDeviceSize uniform_buffer_size = 0x80; //  4*4*sizeof(float)+sizeof(uint32_t);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physical_device, &properties);
+    VkDeviceSize alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.nonCoherentAtomSize);
+    m_uniform_slot_size = (UNIFORM_SIZE + alignment - 1) / alignment * alignment;
+    VkDeviceSize uniform_buffer_size = m_uniform_slot_size * IMAGE_COUNT;
     VkBufferCreateInfo uniform_buffer_create_info{
         VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
         VkBufferCreateFlags(),
@@ -701,27 +1223,40 @@ bool Render::setup_descriptors() {
         return false;
     }
 
-    VkDescriptorBufferInfo uniform_buffer_info{
-        m_uniform_buffer,   // buffer
-        0,                  // offset
-        uniform_buffer_size // range
-    };
-    VkWriteDescriptorSet write_descriptor_set{
-        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr,
-        m_descriptor_set,                   // dstSet
-        0,                                  // dstBinding
-        0,                                  // dstArrayElement
-        1,                                  // descriptorCount
-        VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
-        nullptr,                            // pImageInfo
-        &uniform_buffer_info,               // pBufferInfo
-        nullptr,                            // pTexelBufferView
-    };
-    vkUpdateDescriptorSets(m_device, 1, &write_descriptor_set, 0, nullptr);
+    for (uint32_t frame = 0; frame < IMAGE_COUNT; ++frame) {
+        VkDescriptorBufferInfo uniform_buffer_info{
+            m_uniform_buffer,                   // buffer
+            frame * m_uniform_slot_size,        // offset
+            UNIFORM_SIZE                        // range
+        };
+        VkWriteDescriptorSet write_descriptor_set{
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr,
+            m_descriptor_sets[frame],           // dstSet
+            0,                                  // dstBinding
+            0,                                  // dstArrayElement
+            1,                                  // descriptorCount
+            VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,  // descriptorType
+            nullptr,                            // pImageInfo
+            &uniform_buffer_info,               // pBufferInfo
+            nullptr,                            // pTexelBufferView
+        };
+        vkUpdateDescriptorSets(m_device, 1, &write_descriptor_set, 0, nullptr);
+
+        if (!update_uniform_buffer(frame)) {
+            return false;
+        }
+    }
 
-    if (!update_uniform_buffer()) {
+    // highlight bitset, palette, slot offsets, minimap and gaps
+    if (!setup_storage_binding(m_highlight) || !setup_storage_binding(m_palette) || !setup_storage_binding(m_slots) ||
+        !setup_storage_binding(m_minimap) || !setup_storage_binding(m_gaps)) {
         return false;
     }
+    for (uint32_t frame = 0; frame < IMAGE_COUNT; ++frame) {
+        if (!create_counter_slot(frame, COUNTER_SLOT_POINTS)) {
+            return false;
+        }
+    }
 
     return true;
 }
@@ -744,16 +1279,43 @@ bool Render::create_pipeline() {
         sizeof(vertex_t),
         VK_VERTEX_INPUT_RATE_VERTEX
     };
-    VkVertexInputAttributeDescription input_attribute_descriptions[2] = {
+    VkVertexInputAttributeDescription input_attribute_descriptions[4] = {
         { 0, 0, VK_FORMAT_R32G32_SFLOAT,    offsetof(vertex_t, pos) },
-        { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(vertex_t, color) }
+        { 1, 0, VK_FORMAT_R32_UINT,         offsetof(vertex_t, name_index) },
+        { 2, 0, VK_FORMAT_R32_UINT,         offsetof(vertex_t, proc) },
+        { 3, 0, VK_FORMAT_R32_UINT,         offsetof(vertex_t, slot) }
     };
 
     VkPipelineVertexInputStateCreateInfo vertex_input_create_info{ 
         VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, nullptr,
         VkPipelineVertexInputStateCreateFlags(),
         1, &binding_description,                    // vertex binding descriptions
-        2, input_attribute_descriptions             // vertex attribute descriptions
+        4, input_attribute_descriptions             // vertex attribute descriptions
+    };
+
+    VkVertexInputBindingDescription overlay_binding_description{
+        0,
+        sizeof(overlay_vertex_t),
+        VK_VERTEX_INPUT_RATE_VERTEX
+    };
+    VkVertexInputAttributeDescription overlay_input_attribute_descriptions[2] = {
+        { 0, 0, VK_FORMAT_R32G32_SFLOAT,    offsetof(overlay_vertex_t, pos) },
+        { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(overlay_vertex_t, color) }
+    };
+
+    VkPipelineVertexInputStateCreateInfo overlay_vertex_input_create_info{
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, nullptr,
+        VkPipelineVertexInputStateCreateFlags(),
+        1, &overlay_binding_description,            // vertex binding descriptions
+        2, overlay_input_attribute_descriptions     // vertex attribute descriptions
+    };
+
+    // the minimap makes its quad from the vertex index
+    VkPipelineVertexInputStateCreateInfo minimap_vertex_input_create_info{
+        VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, nullptr,
+        VkPipelineVertexInputStateCreateFlags(),
+        0, nullptr,                                 // vertex binding descriptions
+        0, nullptr                                  // vertex attribute descriptions
     };
 
     // Specify we will use triangle lists to draw geometry.
@@ -806,6 +1368,34 @@ bool Render::create_pipeline() {
     if (shader_module_frag == VK_NULL_HANDLE) {
         return false;
     }
+    VkShaderModule shader_module_overlay = load_shader_module(m_device, "overlay.vert");
+    if (shader_module_overlay == VK_NULL_HANDLE) {
+        return false;
+    }
+    VkShaderModule shader_module_minimap_vert = load_shader_module(m_device, "minimap.vert");
+    if (shader_module_minimap_vert == VK_NULL_HANDLE) {
+        return false;
+    }
+    VkShaderModule shader_module_minimap_frag = load_shader_module(m_device, "minimap.frag");
+    if (shader_module_minimap_frag == VK_NULL_HANDLE) {
+        return false;
+    }
+    VkShaderModule shader_module_heat_vert = load_shader_module(m_device, "heat.vert");
+    if (shader_module_heat_vert == VK_NULL_HANDLE) {
+        return false;
+    }
+    VkShaderModule shader_module_heat_frag = load_shader_module(m_device, "heat.frag");
+    if (shader_module_heat_frag == VK_NULL_HANDLE) {
+        return false;
+    }
+    VkShaderModule shader_module_gap_vert = load_shader_module(m_device, "gap.vert");
+    if (shader_module_gap_vert == VK_NULL_HANDLE) {
+        return false;
+    }
+    VkShaderModule shader_module_counter_vert = load_shader_module(m_device, "counter.vert");
+    if (shader_module_counter_vert == VK_NULL_HANDLE) {
+        return false;
+    }
 
     VkPipelineShaderStageCreateInfo shader_stages[2] = {
         {
@@ -826,16 +1416,79 @@ bool Render::create_pipeline() {
         }
     };
 
-    VkPipelineInputAssemblyStateCreateInfo input_assembly_create_info_filled{
-        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO, nullptr,
-        VkPipelineInputAssemblyStateCreateFlags{},
+    // the overlay is given in normalized device coordinates and ignores the view
+    VkPipelineShaderStageCreateInfo overlay_shader_stages[2] = {
+        shader_stages[0],
+        shader_stages[1]
+    };
+    overlay_shader_stages[0].module = shader_module_overlay;
+
+    VkPipelineShaderStageCreateInfo minimap_shader_stages[2] = {
+        shader_stages[0],
+        shader_stages[1]
+    };
+    minimap_shader_stages[0].module = shader_module_minimap_vert;
+    minimap_shader_stages[1].module = shader_module_minimap_frag;
+
+    VkPipelineShaderStageCreateInfo heat_shader_stages[2] = {
+        shader_stages[0],
+        shader_stages[1]
+    };
+    heat_shader_stages[0].module = shader_module_heat_vert;
+    heat_shader_stages[1].module = shader_module_heat_frag;
+
+    // gap quads share the triangles' fragment shader
+    VkPipelineShaderStageCreateInfo gap_shader_stages[2] = {
+        shader_stages[0],
+        shader_stages[1]
+    };
+    gap_shader_stages[0].module = shader_module_gap_vert;
+
+    // so do the counter graphs, drawn as lines
+    VkPipelineShaderStageCreateInfo counter_shader_stages[2] = {
+        shader_stages[0],
+        shader_stages[1]
+    };
+    counter_shader_stages[0].module = shader_module_counter_vert;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_create_info_filled{
+        VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO, nullptr,
+        VkPipelineInputAssemblyStateCreateFlags{},
         VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,        // topology
         VK_FALSE                                    // primitiveRestartEnable
     };
 
-    VkGraphicsPipelineCreateInfo pipe_create_info[2] = {
+    VkPipelineColorBlendAttachmentState blend_attachment_state{};
+    blend_attachment_state.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+    VkPipelineColorBlendStateCreateInfo blend_create_info{
+        VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO, nullptr,
+        VkPipelineColorBlendStateCreateFlags{},
+        VK_FALSE, VK_LOGIC_OP_CLEAR,    // logic op
+        1, &blend_attachment_state,     // attachments
+        { 0.0f, 0.0f, 0.0f, 0.0f }      // blendConstants
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisample_create_info{
+        VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO, nullptr,
+        VkPipelineMultisampleStateCreateFlags{},
+        SAMPLES,                        // rasterizationSamples
+        VK_FALSE, 0.0f, nullptr,        // sample shading
+        VK_FALSE, VK_FALSE              // alpha to coverage / one
+    };
+
+    // must match the attachment the draw command buffers are recorded for
+    VkPipelineRenderingCreateInfoKHR rendering_create_info{
+        VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR, nullptr,
+        0,                              // viewMask
+        1, &COLOR_FORMAT,               // color attachment formats
+        VK_FORMAT_UNDEFINED,            // depthAttachmentFormat
+        VK_FORMAT_UNDEFINED             // stencilAttachmentFormat
+    };
+
+    VkGraphicsPipelineCreateInfo pipe_create_info[7] = {
     {
-        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, nullptr,
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, &rendering_create_info,
         VkPipelineCreateFlags(),
         sizeof(shader_stages)/sizeof(shader_stages[0]),
         shader_stages,                  // pStages
@@ -844,9 +1497,9 @@ bool Render::create_pipeline() {
         nullptr,                        // pTessellationState
         &viewport_create_info,          // pViewportState
         &raster_create_info,            // pRasterizationState
-        nullptr,                        // pMultisampleState
+        &multisample_create_info,       // pMultisampleState
         nullptr,                        // pDepthStencilState
-        nullptr,                        // pColorBlendState
+        &blend_create_info,             // pColorBlendState
         &dynamic_create_info,           // pDynamicState
         m_pipeline_layout,              // layout
         nullptr,                        // renderPass
@@ -855,7 +1508,7 @@ bool Render::create_pipeline() {
         0,                              // basePipelineIndex
     },
     {
-        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, nullptr,
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, &rendering_create_info,
         VkPipelineCreateFlags(),
         sizeof(shader_stages)/sizeof(shader_stages[0]),
         shader_stages,                  // pStages
@@ -864,9 +1517,109 @@ bool Render::create_pipeline() {
         nullptr,                        // pTessellationState
         &viewport_create_info,          // pViewportState
         &raster_create_info,            // pRasterizationState
-        nullptr,                        // pMultisampleState
+        &multisample_create_info,       // pMultisampleState
+        nullptr,                        // pDepthStencilState
+        &blend_create_info,             // pColorBlendState
+        &dynamic_create_info,           // pDynamicState
+        m_pipeline_layout,              // layout
+        nullptr,                        // renderPass
+        0,                              // subpass
+        VkPipeline(),                   // basePipelineHandle
+        0,                              // basePipelineIndex
+    },
+    {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, &rendering_create_info,
+        VkPipelineCreateFlags(),
+        sizeof(overlay_shader_stages)/sizeof(overlay_shader_stages[0]),
+        overlay_shader_stages,          // pStages
+        &overlay_vertex_input_create_info, // pVertexInputState
+        &input_assembly_create_info_filled,    // pInputAssemblyState
+        nullptr,                        // pTessellationState
+        &viewport_create_info,          // pViewportState
+        &raster_create_info,            // pRasterizationState
+        &multisample_create_info,       // pMultisampleState
+        nullptr,                        // pDepthStencilState
+        &blend_create_info,             // pColorBlendState
+        &dynamic_create_info,           // pDynamicState
+        m_pipeline_layout,              // layout
+        nullptr,                        // renderPass
+        0,                              // subpass
+        VkPipeline(),                   // basePipelineHandle
+        0,                              // basePipelineIndex
+    },
+    {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, &rendering_create_info,
+        VkPipelineCreateFlags(),
+        sizeof(minimap_shader_stages)/sizeof(minimap_shader_stages[0]),
+        minimap_shader_stages,          // pStages
+        &minimap_vertex_input_create_info, // pVertexInputState
+        &input_assembly_create_info_filled,    // pInputAssemblyState
+        nullptr,                        // pTessellationState
+        &viewport_create_info,          // pViewportState
+        &raster_create_info,            // pRasterizationState
+        &multisample_create_info,       // pMultisampleState
         nullptr,                        // pDepthStencilState
-        nullptr,                        // pColorBlendState
+        &blend_create_info,             // pColorBlendState
+        &dynamic_create_info,           // pDynamicState
+        m_pipeline_layout,              // layout
+        nullptr,                        // renderPass
+        0,                              // subpass
+        VkPipeline(),                   // basePipelineHandle
+        0,                              // basePipelineIndex
+    },
+    {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, &rendering_create_info,
+        VkPipelineCreateFlags(),
+        sizeof(heat_shader_stages)/sizeof(heat_shader_stages[0]),
+        heat_shader_stages,             // pStages
+        &minimap_vertex_input_create_info, // pVertexInputState
+        &input_assembly_create_info_filled,    // pInputAssemblyState
+        nullptr,                        // pTessellationState
+        &viewport_create_info,          // pViewportState
+        &raster_create_info,            // pRasterizationState
+        &multisample_create_info,       // pMultisampleState
+        nullptr,                        // pDepthStencilState
+        &blend_create_info,             // pColorBlendState
+        &dynamic_create_info,           // pDynamicState
+        m_pipeline_layout,              // layout
+        nullptr,                        // renderPass
+        0,                              // subpass
+        VkPipeline(),                   // basePipelineHandle
+        0,                              // basePipelineIndex
+    },
+    {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, &rendering_create_info,
+        VkPipelineCreateFlags(),
+        sizeof(gap_shader_stages)/sizeof(gap_shader_stages[0]),
+        gap_shader_stages,              // pStages
+        &minimap_vertex_input_create_info, // pVertexInputState
+        &input_assembly_create_info_filled,    // pInputAssemblyState
+        nullptr,                        // pTessellationState
+        &viewport_create_info,          // pViewportState
+        &raster_create_info,            // pRasterizationState
+        &multisample_create_info,       // pMultisampleState
+        nullptr,                        // pDepthStencilState
+        &blend_create_info,             // pColorBlendState
+        &dynamic_create_info,           // pDynamicState
+        m_pipeline_layout,              // layout
+        nullptr,                        // renderPass
+        0,                              // subpass
+        VkPipeline(),                   // basePipelineHandle
+        0,                              // basePipelineIndex
+    },
+    {
+        VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO, &rendering_create_info,
+        VkPipelineCreateFlags(),
+        sizeof(counter_shader_stages)/sizeof(counter_shader_stages[0]),
+        counter_shader_stages,          // pStages
+        &minimap_vertex_input_create_info, // pVertexInputState
+        &input_assembly_create_info,    // pInputAssemblyState
+        nullptr,                        // pTessellationState
+        &viewport_create_info,          // pViewportState
+        &raster_create_info,            // pRasterizationState
+        &multisample_create_info,       // pMultisampleState
+        nullptr,                        // pDepthStencilState
+        &blend_create_info,             // pColorBlendState
         &dynamic_create_info,           // pDynamicState
         m_pipeline_layout,              // layout
         nullptr,                        // renderPass
@@ -875,7 +1628,7 @@ bool Render::create_pipeline() {
         0,                              // basePipelineIndex
     } };
 
-    res = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 2, pipe_create_info, nullptr, m_pipeline);
+    res = vkCreateGraphicsPipelines(m_device, VK_NULL_HANDLE, 7, pipe_create_info, nullptr, m_pipeline);
     if (res != VK_SUCCESS) {
         return false;
     }
@@ -884,23 +1637,365 @@ bool Render::create_pipeline() {
     // Pipeline is baked, we can delete the shader modules now.
     vkDestroyShaderModule(m_device, shader_stages[0].module, nullptr);
     vkDestroyShaderModule(m_device, shader_stages[1].module, nullptr);
+    vkDestroyShaderModule(m_device, overlay_shader_stages[0].module, nullptr);
+    vkDestroyShaderModule(m_device, minimap_shader_stages[0].module, nullptr);
+    vkDestroyShaderModule(m_device, minimap_shader_stages[1].module, nullptr);
+    vkDestroyShaderModule(m_device, heat_shader_stages[0].module, nullptr);
+    vkDestroyShaderModule(m_device, heat_shader_stages[1].module, nullptr);
+    vkDestroyShaderModule(m_device, gap_shader_stages[0].module, nullptr);
+    vkDestroyShaderModule(m_device, counter_shader_stages[0].module, nullptr);
+
+    return true;
+}
+
+bool Render::setup_timestamps() {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_physical_device, &properties);
+    m_timestamp_period = properties.limits.timestampPeriod;
+
+    std::vector<VkQueueFamilyProperties> queue_family_properties;
+    uint32_t count;
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physical_device, &count, nullptr);
+    queue_family_properties.resize(count);
+    vkGetPhysicalDeviceQueueFamilyProperties(m_physical_device, &count, queue_family_properties.data());
+
+    // without timestamp support the GPU columns just stay unknown
+    if (queue_family_properties[m_queue_family_index].timestampValidBits == 0) {
+        return true;
+    }
+
+    VkQueryPoolCreateInfo query_pool_create_info{
+        VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, nullptr,
+        VkQueryPoolCreateFlags(),
+        VK_QUERY_TYPE_TIMESTAMP,
+        IMAGE_COUNT * QUERIES_PER_FRAME,    // queryCount
+        0                                   // pipelineStatistics
+    };
+    VkResult res = vkCreateQueryPool(m_device, &query_pool_create_info, nullptr, &m_query_pool);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    return true;
+}
+
+bool Render::setup_overlay() {
+    const VkDeviceSize overlay_size = IMAGE_COUNT * OVERLAY_VERTICES * sizeof(overlay_vertex_t);
+    VkBufferCreateInfo overlay_buffer_create_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
+        VkBufferCreateFlags(),
+        overlay_size,
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+        VK_SHARING_MODE_EXCLUSIVE,
+        0, nullptr
+    };
+    VkResult res = vkCreateBuffer(m_device, &overlay_buffer_create_info, nullptr, &m_overlay_buffer);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_overlay_memory = alloc(m_overlay_buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (m_overlay_memory == VK_NULL_HANDLE) {
+        return false;
+    }
+    void * data;
+    res = vkMapMemory(m_device, m_overlay_memory, 0, overlay_size, 0, &data);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_overlay_data = (overlay_vertex_t *) data;
+    memset(m_overlay_data, 0, (size_t) overlay_size);
+    return true;
+}
+
+// Per frame slot, MAX_DRAW_RANGES commands for the lines followed by as
+// many for the triangles; unused commands draw nothing.
+bool Render::setup_indirect() {
+    const VkDeviceSize indirect_size = IMAGE_COUNT * 2 * MAX_DRAW_RANGES * sizeof(VkDrawIndexedIndirectCommand);
+    VkBufferCreateInfo indirect_buffer_create_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
+        VkBufferCreateFlags(),
+        indirect_size,
+        // the heatmap reads the triangle commands to bin the visible tasks only
+        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        VK_SHARING_MODE_EXCLUSIVE,
+        0, nullptr
+    };
+    VkResult res = vkCreateBuffer(m_device, &indirect_buffer_create_info, nullptr, &m_indirect_buffer);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_indirect_memory = alloc(m_indirect_buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (m_indirect_memory == VK_NULL_HANDLE) {
+        return false;
+    }
+    void * data;
+    res = vkMapMemory(m_device, m_indirect_memory, 0, indirect_size, 0, &data);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_indirect_data = (VkDrawIndexedIndirectCommand *) data;
+    memset(m_indirect_data, 0, (size_t) indirect_size);
+    return true;
+}
+
+void Render::set_visible_tasks(const std::vector< std::pair<uint32_t, uint32_t> > & ranges) {
+    m_visible_tasks = ranges;
+    if (!m_culling) {
+        m_culling = true;
+        ++m_draw_version;
+    }
+}
+
+// Writes the draw commands of this frame for the visible task ranges. The
+// ranges refer to the newest index lists; while those are still uploading,
+// or before any ranges have been set, the frame draws everything it has.
+void Render::update_indirect(uint32_t frame) {
+    VkDrawIndexedIndirectCommand * lines = m_indirect_data + frame * 2 * MAX_DRAW_RANGES;
+    VkDrawIndexedIndirectCommand * triangles = lines + MAX_DRAW_RANGES;
+    memset(lines, 0, 2 * MAX_DRAW_RANGES * sizeof(VkDrawIndexedIndirectCommand));
+
+    const IndexList & indices = m_bound_indices[frame];
+    const uint32_t task_count = (indices.buffer != VK_NULL_HANDLE ? indices.index_count_tri : m_geometry.index_count_tri) / 3;
+    const bool pending = !m_culling || (!m_index_lists.empty() && m_index_lists.back().buffer != indices.buffer);
+
+    std::vector< std::pair<uint32_t, uint32_t> > all;
+    const std::vector< std::pair<uint32_t, uint32_t> > & ranges = pending ? all : m_visible_tasks;
+    if (pending) {
+        all.push_back(std::make_pair(0u, task_count));
+    }
+    const size_t count = std::min<size_t>(ranges.size(), MAX_DRAW_RANGES);
+    for (size_t i = 0; i < count; ++i) {
+        const uint32_t first = std::min(ranges[i].first, task_count);
+        const uint32_t tasks = std::min(ranges[i].second, task_count - first);
+        lines[i] = { tasks * 6, 1, first * 6, 0, 0 };
+        triangles[i] = { tasks * 3, 1, first * 3, 0, 0 };
+    }
+}
+
+void Render::draw_visible(VkCommandBuffer command_buffer, uint32_t frame, bool triangles) {
+    const VkDeviceSize stride = sizeof(VkDrawIndexedIndirectCommand);
+    const VkDeviceSize offset = (frame * 2 + (triangles ? 1 : 0)) * MAX_DRAW_RANGES * stride;
+    if (m_multi_draw_indirect) {
+        vkCmdDrawIndexedIndirect(command_buffer, m_indirect_buffer, offset, MAX_DRAW_RANGES, (uint32_t) stride);
+        return;
+    }
+    for (uint32_t i = 0; i < MAX_DRAW_RANGES; ++i) {
+        vkCmdDrawIndexedIndirect(command_buffer, m_indirect_buffer, offset + i * stride, 1, (uint32_t) stride);
+    }
+}
+
+// Every slot starts with its vertices, followed by the line and triangle
+// indices; the pipeline bound is the caller's.
+void Render::draw_tiles(VkCommandBuffer command_buffer, bool triangles) {
+    for (uint32_t slot : m_tile_draws) {
+        const TileSlot & tile = m_tile_slots[slot];
+        const VkDeviceSize base = slot * m_tile_slot_size;
+        vkCmdBindVertexBuffers(command_buffer, 0, 1, &m_tile_buffer, &base);
+        vkCmdBindIndexBuffer(command_buffer, m_tile_buffer, base + (triangles ? tile.index_offset_tri : tile.index_offset_line), VK_INDEX_TYPE_UINT32);
+        vkCmdDrawIndexed(command_buffer, triangles ? tile.index_count_tri : tile.index_count_line, 1, 0, 0, 0);
+    }
+}
+
+// The accumulation buffer is shared by all frame slots; barriers order
+// each frame's clear after the previous frames' reads on the queue.
+bool Render::setup_heatmap() {
+    const VkDeviceSize heat_size = 2 * (VkDeviceSize) HEAT_MAX_COLUMNS * HEAT_MAX_BINS * sizeof(int32_t);
+    VkBufferCreateInfo heat_buffer_create_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
+        VkBufferCreateFlags(),
+        heat_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_SHARING_MODE_EXCLUSIVE,
+        0, nullptr
+    };
+    VkResult res = vkCreateBuffer(m_device, &heat_buffer_create_info, nullptr, &m_heat_buffer);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_heat_memory = alloc(m_heat_buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (m_heat_memory == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    for (uint32_t frame = 0; frame < IMAGE_COUNT; ++frame) {
+        VkDescriptorBufferInfo heat_buffer_info{
+            m_heat_buffer,                      // buffer
+            0,                                  // offset
+            VK_WHOLE_SIZE                       // range
+        };
+        VkWriteDescriptorSet write_descriptor_set{
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr,
+            m_descriptor_sets[frame],           // dstSet
+            7,                                  // dstBinding
+            0,                                  // dstArrayElement
+            1,                                  // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            nullptr,                            // pImageInfo
+            &heat_buffer_info,                  // pBufferInfo
+            nullptr,                            // pTexelBufferView
+        };
+        vkUpdateDescriptorSets(m_device, 1, &write_descriptor_set, 0, nullptr);
+
+        // this frame's triangle draw commands; 2 * MAX_DRAW_RANGES commands
+        // per frame keep the offset a multiple of 256 bytes
+        const VkDeviceSize commands_size = MAX_DRAW_RANGES * sizeof(VkDrawIndexedIndirectCommand);
+        VkDescriptorBufferInfo ranges_buffer_info{
+            m_indirect_buffer,                  // buffer
+            (frame * 2 + 1) * commands_size,    // offset
+            commands_size                       // range
+        };
+        write_descriptor_set.dstBinding = 10;
+        write_descriptor_set.pBufferInfo = &ranges_buffer_info;
+        vkUpdateDescriptorSets(m_device, 1, &write_descriptor_set, 0, nullptr);
+    }
 
+    const char * shaders[2] = { "heat_bin.comp", "heat_scan.comp" };
+    for (uint32_t i = 0; i < 2; ++i) {
+        VkShaderModule shader_module = load_shader_module(m_device, shaders[i]);
+        if (shader_module == VK_NULL_HANDLE) {
+            return false;
+        }
+        VkComputePipelineCreateInfo pipe_create_info{
+            VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO, nullptr,
+            VkPipelineCreateFlags(),
+            {
+                VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr,
+                VkPipelineShaderStageCreateFlags{},
+                VK_SHADER_STAGE_COMPUTE_BIT,    // stage
+                shader_module,                  // module
+                "main",                         // pName
+                nullptr                         // pSpecializationInfo
+            },
+            m_pipeline_layout,              // layout
+            VkPipeline(),                   // basePipelineHandle
+            0                               // basePipelineIndex
+        };
+        res = vkCreateComputePipelines(m_device, VK_NULL_HANDLE, 1, &pipe_create_info, nullptr, &m_heat_pipelines[i]);
+        vkDestroyShaderModule(m_device, shader_module, nullptr);
+        if (res != VK_SUCCESS) {
+            return false;
+        }
+    }
     return true;
 }
 
-bool Render::update_uniform_buffer() {
+// Points bindings 5 and 6 at the vertices and the triangle indices the
+// heatmap bins this frame: the filtered lists if there are any. Binding 10,
+// the frame's triangle draw commands, says which of them are visible.
+void Render::bind_heat_sources(uint32_t frame) {
+    if (!m_heatmap || !m_draw_final) {
+        m_heat_task_count[frame] = 0;
+        return;
+    }
+    const IndexList & indices = m_bound_indices[frame];
+    const bool filtered = indices.buffer != VK_NULL_HANDLE;
+    const VkBuffer index_buffer = filtered ? indices.buffer : m_geometry.buffer;
+    m_heat_index_offset[frame] = (uint32_t) ((filtered ? indices.index_offset_tri : m_geometry.index_offset_tri) / sizeof(uint32_t));
+    // only the visible ranges written by update_indirect() are binned
+    const VkDrawIndexedIndirectCommand * triangles = m_indirect_data + (frame * 2 + 1) * MAX_DRAW_RANGES;
+    m_heat_task_count[frame] = 0;
+    for (uint32_t i = 0; i < MAX_DRAW_RANGES; ++i) {
+        m_heat_task_count[frame] += triangles[i].indexCount / 3;
+    }
+
+    if (m_heat_vertices[frame] == m_geometry.buffer && m_heat_indices[frame] == index_buffer) {
+        return;
+    }
+    VkDescriptorBufferInfo buffer_infos[2] = {
+        { m_geometry.buffer, 0, m_geometry.index_offset_line },     // the vertices lead the buffer
+        { index_buffer, 0, VK_WHOLE_SIZE }
+    };
+    VkWriteDescriptorSet write_descriptor_sets[2];
+    for (uint32_t i = 0; i < 2; ++i) {
+        write_descriptor_sets[i] = {
+            VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr,
+            m_descriptor_sets[frame],           // dstSet
+            5 + i,                              // dstBinding
+            0,                                  // dstArrayElement
+            1,                                  // descriptorCount
+            VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+            nullptr,                            // pImageInfo
+            &buffer_infos[i],                   // pBufferInfo
+            nullptr,                            // pTexelBufferView
+        };
+    }
+    vkUpdateDescriptorSets(m_device, 2, write_descriptor_sets, 0, nullptr);
+    m_heat_vertices[frame] = m_geometry.buffer;
+    m_heat_indices[frame] = index_buffer;
+
+    // updating the set invalidates draw commands recorded with it
+    m_draw_recorded_version[frame] = 0;
+}
+
+// Clear, bin every visible task with one or two atomic adds, then a running
+// sum along each bin. The fragment shader of pipeline 4 reads the result.
+void Render::record_heatmap(VkCommandBuffer command_buffer, uint32_t frame) {
+    const uint32_t columns = std::min(m_extent.width, HEAT_MAX_COLUMNS);
+    const uint32_t bins = std::min(m_extent.height, HEAT_MAX_BINS);
+    const VkDeviceSize cells = (VkDeviceSize) columns * bins;
+
+    auto barrier = [command_buffer](VkPipelineStageFlags src_stage, VkAccessFlags src_access, VkPipelineStageFlags dst_stage, VkAccessFlags dst_access) {
+        const VkMemoryBarrier memory_barrier{
+            VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr,
+            src_access, dst_access
+        };
+        vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 1, &memory_barrier, 0, nullptr, 0, nullptr);
+    };
+
+    // earlier frames may still be reading the buffer
+    barrier(VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+    vkCmdFillBuffer(command_buffer, m_heat_buffer, 0, 2 * cells * sizeof(int32_t), 0);
+    barrier(VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline_layout, 0, 1, &m_descriptor_sets[frame], 0, nullptr);
+
+    // the shader strides over the tasks beyond the dispatch limit
+    const uint32_t task_groups = std::min<uint32_t>((m_heat_task_count[frame] + 63) / 64, 65535);
+    if (task_groups > 0) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_heat_pipelines[0]);
+        vkCmdDispatch(command_buffer, task_groups, 1, 1);
+    }
+    barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+
+    vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_heat_pipelines[1]);
+    vkCmdDispatch(command_buffer, (bins + 63) / 64, 1, 1);
+    barrier(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+}
+
+bool Render::update_uniform_buffer(uint32_t frame) {
     const float mat[] = {
         m_sx, 0.0f, 0.0f, 0.0f,
         0.0f, m_sy, 0.0f, 0.0f,
         0.0f, 0.0f, 1.0f, 0.0f,
         m_x,  m_y,  0.0f, 1.0f
     };
-    memcpy(m_uniform_memory_data, mat, sizeof(mat));
-    memcpy((char*)m_uniform_memory_data+sizeof(mat), &m_selected_index, sizeof(uint32_t));
+    UniformBlock block{};
+    memcpy(block.matrix, mat, sizeof(mat));
+    block.selected_index = m_selected_index;
+    // preview geometry does not follow the task numbering of the highlight
+    block.highlight_count = m_draw_final ? m_highlight.count[frame] : 0;
+    block.palette_count = m_palette.count[frame];
+    block.palette_mode = m_palette.mode[frame];
+    block.slot_count = m_slots.count[frame];
+    block.minimap_width = m_minimap.mode[frame];
+    block.minimap_height = m_minimap.mode[frame] != 0 ? m_minimap.count[frame] / m_minimap.mode[frame] : 0;
+    memcpy(block.minimap_view, m_minimap_view, sizeof(m_minimap_view));
+
+    block.heat_index_offset = m_heat_index_offset[frame];
+    block.heat_task_count = m_heat_task_count[frame];
+    block.heat_columns = std::min(m_extent.width, HEAT_MAX_COLUMNS);
+    block.heat_bins = std::min(m_extent.height, HEAT_MAX_BINS);
+    // rows are about one unit apart
+    block.heat_rows_per_bin = block.heat_bins > 0 ? 2.0f / (block.heat_bins * std::fabs(m_sy)) : 1.0f;
+    block.heat_range_count = MAX_DRAW_RANGES;
+    memcpy((char *) m_uniform_memory_data + frame * m_uniform_slot_size, &block, sizeof(block));
 
     VkMappedMemoryRange mapped_memory_range{
         VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr,
-        m_uniform_buffer_memory, 0, VK_WHOLE_SIZE
+        m_uniform_buffer_memory, frame * m_uniform_slot_size, m_uniform_slot_size
     };
     VkResult res = vkFlushMappedMemoryRanges(m_device, 1, &mapped_memory_range);
     if (res != VK_SUCCESS) {
@@ -909,134 +2004,731 @@ bool Render::update_uniform_buffer() {
     return true;
 }
 
-bool Render::setup_vertex_buffer(const std::vector<vertex_t> & vertices, const std::vector<uint32_t> & line_indices, const std::vector<uint32_t> & triangle_indices) {
+void Render::destroy_geometry(Geometry & geometry) {
+    vkDestroyBuffer(m_device, geometry.buffer, nullptr);
+    vkFreeMemory(m_device, geometry.memory, nullptr);
+    geometry = Geometry();
+}
 
-    VkDeviceSize vertex_size = vertices.size() * sizeof(vertices[0]);
-    VkDeviceSize line_index_size = line_indices.size() * sizeof(uint32_t);
-    VkDeviceSize tri_index_size = triangle_indices.size() * sizeof(uint32_t);
-    VkDeviceSize vertex_buffer_size = vertex_size + line_index_size + tri_index_size;
+bool Render::create_storage_buffer(VkDeviceSize size, StorageBuffer & storage_buffer) {
+    const uint32_t queue_family_indices[] = { m_queue_family_index, m_transfer_queue_family_index };
+    const bool concurrent = m_transfer_queue_family_index != m_queue_family_index;
+    VkBufferCreateInfo buffer_create_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
+        VkBufferCreateFlags(),
+        size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        concurrent ? 2u : 0u, concurrent ? queue_family_indices : nullptr
+    };
+    VkResult res = vkCreateBuffer(m_device, &buffer_create_info, nullptr, &storage_buffer.buffer);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    storage_buffer.memory = alloc(storage_buffer.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (storage_buffer.memory == VK_NULL_HANDLE) {
+        return false;
+    }
+    return true;
+}
 
-    m_index_count_line = (uint32_t) line_indices.size();
-    m_index_count_tri = (uint32_t) triangle_indices.size();
-    m_vertex_buffer_index_offset_line = vertex_size;
-    m_vertex_buffer_index_offset_tri = m_vertex_buffer_index_offset_line + line_index_size;
+void Render::destroy_storage_buffer(StorageBuffer & storage_buffer) {
+    vkDestroyBuffer(m_device, storage_buffer.buffer, nullptr);
+    vkFreeMemory(m_device, storage_buffer.memory, nullptr);
+    storage_buffer = StorageBuffer();
+}
 
-    // create staging buffer
-    VkBufferCreateInfo staging_buffer_create_info{
+// Empty first version, so the binding is valid from the first frame on. Its
+// contents are never read because its count is 0.
+bool Render::setup_storage_binding(StorageBinding & storage) {
+    StorageBuffer placeholder;
+    if (!create_storage_buffer(4 * sizeof(uint32_t), placeholder)) {
+        return false;
+    }
+    storage.versions.push_back(placeholder);
+    for (uint32_t frame = 0; frame < IMAGE_COUNT; ++frame) {
+        write_storage_descriptor(frame, storage.binding, placeholder.buffer);
+        storage.bound[frame] = placeholder.buffer;
+    }
+    return true;
+}
+
+void Render::write_storage_descriptor(uint32_t frame, uint32_t binding, VkBuffer buffer) {
+    VkDescriptorBufferInfo storage_buffer_info{
+        buffer,                             // buffer
+        0,                                  // offset
+        VK_WHOLE_SIZE                       // range
+    };
+    VkWriteDescriptorSet write_descriptor_set{
+        VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, nullptr,
+        m_descriptor_sets[frame],           // dstSet
+        binding,                            // dstBinding
+        0,                                  // dstArrayElement
+        1,                                  // descriptorCount
+        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,  // descriptorType
+        nullptr,                            // pImageInfo
+        &storage_buffer_info,               // pBufferInfo
+        nullptr,                            // pTexelBufferView
+    };
+    vkUpdateDescriptorSets(m_device, 1, &write_descriptor_set, 0, nullptr);
+}
+
+// A new buffer every time: frames in flight keep reading the old version.
+bool Render::update_storage(StorageBinding & storage, const void * data, VkDeviceSize size, uint32_t count, uint32_t mode) {
+    StorageBuffer version;
+    if (!create_storage_buffer(std::max<VkDeviceSize>(size, 4 * sizeof(uint32_t)), version)) {
+        destroy_storage_buffer(version);
+        return false;
+    }
+    if (size > 0) {
+        if (!stage(version.buffer, 0, data, size)) {
+            destroy_storage_buffer(version);
+            return false;
+        }
+        version.upload_serial = submit_staging();
+        if (version.upload_serial == 0) {
+            destroy_storage_buffer(version);
+            return false;
+        }
+    }
+    version.count = size > 0 ? count : 0;
+    version.mode = mode;
+    storage.versions.push_back(version);
+    return true;
+}
+
+// Binds the newest version that has finished uploading to the descriptor
+// set of this frame, and frees the versions that no frame slot refers to
+// any more. The fence of this frame has been waited for.
+void Render::bind_storage(StorageBinding & storage, uint32_t frame) {
+    size_t newest = storage.versions.size();
+    while (newest > 1 && storage.versions[newest - 1].upload_serial > m_upload_completed) {
+        --newest;
+    }
+    const StorageBuffer & version = storage.versions[newest - 1];
+    storage.count[frame] = version.count;
+    storage.mode[frame] = version.mode;
+
+    if (storage.bound[frame] != version.buffer) {
+        write_storage_descriptor(frame, storage.binding, version.buffer);
+        storage.bound[frame] = version.buffer;
+
+        // updating the set invalidates draw commands recorded with it
+        m_draw_recorded_version[frame] = 0;
+    }
+
+    for (size_t i = 0; i + 1 < newest; ) {
+        const VkBuffer buffer = storage.versions[i].buffer;
+        if (std::find(std::begin(storage.bound), std::end(storage.bound), buffer) != std::end(storage.bound)) {
+            ++i;
+            continue;
+        }
+        destroy_storage_buffer(storage.versions[i]);
+        storage.versions.erase(storage.versions.begin() + i);
+        --newest;
+    }
+}
+
+bool Render::create_counter_slot(uint32_t frame, uint32_t capacity) {
+    CounterSlot & slot = m_counter_slots[frame];
+    const VkDeviceSize size = (VkDeviceSize) capacity * sizeof(counter_point_t);
+    VkBufferCreateInfo buffer_create_info{
         VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
         VkBufferCreateFlags(),
-        vertex_buffer_size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VK_SHARING_MODE_EXCLUSIVE,
         0, nullptr
     };
-    VkBuffer vertex_buffer_staging;
-    VkResult res = vkCreateBuffer(m_device, &staging_buffer_create_info, nullptr, &vertex_buffer_staging);
+    VkResult res = vkCreateBuffer(m_device, &buffer_create_info, nullptr, &slot.buffer);
     if (res != VK_SUCCESS) {
         return false;
     }
-    VkDeviceMemory vertex_buffer_memory_staging = alloc(vertex_buffer_staging, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
-    if (vertex_buffer_memory_staging == VK_NULL_HANDLE) {
+    slot.memory = alloc(slot.buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (slot.memory == VK_NULL_HANDLE) {
         return false;
     }
+    void * data;
+    res = vkMapMemory(m_device, slot.memory, 0, size, 0, &data);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    slot.data = (counter_point_t *) data;
+    slot.capacity = capacity;
+    write_storage_descriptor(frame, COUNTER_BINDING, slot.buffer);
+
+    // updating the set invalidates draw commands recorded with it
+    m_draw_recorded_version[frame] = 0;
+    return true;
+}
+
+void Render::destroy_counter_slot(CounterSlot & slot) {
+    if (slot.data != nullptr) {
+        vkUnmapMemory(m_device, slot.memory);
+    }
+    vkDestroyBuffer(m_device, slot.buffer, nullptr);
+    vkFreeMemory(m_device, slot.memory, nullptr);
+    slot = CounterSlot();
+}
+
+// Copies the newest counter points into this frame's buffer, growing it if
+// they do not fit. The fence of this frame has been waited for, so nothing
+// reads the buffer any more.
+bool Render::update_counter_slot(uint32_t frame) {
+    CounterSlot & slot = m_counter_slots[frame];
+    if (slot.version == m_counter_version) {
+        return true;
+    }
+    const uint32_t count = (uint32_t) m_counter_points.size();
+    if (count > slot.capacity) {
+        const uint32_t capacity = std::max(count, 2 * slot.capacity);
+        destroy_counter_slot(slot);
+        if (!create_counter_slot(frame, capacity)) {
+            return false;
+        }
+    }
+    memcpy(slot.data, m_counter_points.data(), count * sizeof(counter_point_t));
+    // the vertex count is part of the recorded draw
+    if (slot.count != count) {
+        m_draw_recorded_version[frame] = 0;
+    }
+    slot.count = count;
+    slot.version = m_counter_version;
+    return true;
+}
+
+bool Render::set_highlight(const std::vector<uint32_t> & bits) {
+    if (!m_init || !m_uploaded) {
+        return false;
+    }
+    const uint32_t task_count = (uint32_t) std::min<size_t>(bits.size() * 32, UINT32_MAX);
+    return update_storage(m_highlight, bits.data(), bits.size() * sizeof(uint32_t), task_count, 0);
+}
+
+bool Render::set_palette(const std::vector<color_t> & colors, bool by_process) {
+    if (!m_init) {
+        return false;
+    }
+    // vec4 per entry, the std430 layout of a vec3 array would need padding anyway
+    std::vector<float> data;
+    data.reserve(colors.size() * 4);
+    for (const color_t & color : colors) {
+        data.insert(data.end(), { color.r, color.g, color.b, 1.0f });
+    }
+    return update_storage(m_palette, data.data(), data.size() * sizeof(float), (uint32_t) colors.size(), by_process ? 1 : 0);
+}
+
+void Render::destroy_index_list(IndexList & index_list) {
+    vkDestroyBuffer(m_device, index_list.buffer, nullptr);
+    vkFreeMemory(m_device, index_list.memory, nullptr);
+    index_list = IndexList();
+}
+
+bool Render::set_indices(const std::vector<uint32_t> & line_indices, const std::vector<uint32_t> & triangle_indices) {
+    if (!m_init || !m_uploaded) {
+        return false;
+    }
+    const VkDeviceSize line_index_size = line_indices.size() * sizeof(uint32_t);
+    const VkDeviceSize tri_index_size = triangle_indices.size() * sizeof(uint32_t);
 
-    // create vertex buffer
+    // a new buffer every time: frames in flight keep drawing the old lists
+    IndexList index_list;
+    index_list.index_count_line = (uint32_t) line_indices.size();
+    index_list.index_count_tri = (uint32_t) triangle_indices.size();
+    index_list.index_offset_tri = line_index_size;
+
+    const uint32_t queue_family_indices[] = { m_queue_family_index, m_transfer_queue_family_index };
+    const bool concurrent = m_transfer_queue_family_index != m_queue_family_index;
     VkBufferCreateInfo buffer_create_info{
         VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
         VkBufferCreateFlags(),
-        vertex_buffer_size,
-        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        VK_SHARING_MODE_EXCLUSIVE,
-        0, nullptr
+        std::max<VkDeviceSize>(line_index_size + tri_index_size, sizeof(uint32_t)),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        concurrent ? 2u : 0u, concurrent ? queue_family_indices : nullptr
     };
-    res = vkCreateBuffer(m_device, &buffer_create_info, nullptr, &m_vertex_buffer);
+    VkResult res = vkCreateBuffer(m_device, &buffer_create_info, nullptr, &index_list.buffer);
     if (res != VK_SUCCESS) {
         return false;
     }
-    m_vertex_buffer_memory = alloc(m_vertex_buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-    if (m_vertex_buffer_memory == VK_NULL_HANDLE) {
+    index_list.memory = alloc(index_list.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (index_list.memory == VK_NULL_HANDLE) {
+        destroy_index_list(index_list);
         return false;
     }
 
-    // stage vertex data
-    void * data;
-    res = vkMapMemory(m_device, vertex_buffer_memory_staging, 0, vertex_buffer_size, 0, &data);
+    if (!stage(index_list.buffer, 0, line_indices.data(), line_index_size) ||
+        !stage(index_list.buffer, index_list.index_offset_tri, triangle_indices.data(), tri_index_size)) {
+        destroy_index_list(index_list);
+        return false;
+    }
+    index_list.upload_serial = submit_staging();
+    if (index_list.upload_serial == 0) {
+        destroy_index_list(index_list);
+        return false;
+    }
+    m_index_lists.push_back(index_list);
+    return true;
+}
+
+bool Render::set_slots(const std::vector<float> & offsets) {
+    if (!m_init) {
+        return false;
+    }
+    return update_storage(m_slots, offsets.data(), offsets.size() * sizeof(float), (uint32_t) offsets.size(), 0);
+}
+
+bool Render::set_minimap(const std::vector<float> & coverage, uint32_t width) {
+    if (!m_init || width == 0) {
+        return false;
+    }
+    return update_storage(m_minimap, coverage.data(), coverage.size() * sizeof(float), (uint32_t) coverage.size(), width);
+}
+
+bool Render::set_gaps(const std::vector<gap_t> & gaps) {
+    if (!m_init) {
+        return false;
+    }
+    return update_storage(m_gaps, gaps.data(), gaps.size() * sizeof(gap_t), (uint32_t) gaps.size(), 0);
+}
+
+bool Render::set_counter_points(const std::vector<counter_point_t> & points) {
+    if (!m_init) {
+        return false;
+    }
+    m_counter_points = points;
+    ++m_counter_version;
+    return true;
+}
+
+void Render::set_minimap_view(const float view[4]) {
+    memcpy(m_minimap_view, view, sizeof(m_minimap_view));
+}
+
+bool Render::reset_indices() {
+    if (!m_init) {
+        return false;
+    }
+    m_index_lists.push_back(IndexList());
+    return true;
+}
+
+// Like bind_storage(): the newest uploaded index lists become the ones of
+// this frame, and lists no frame slot draws any more are freed.
+void Render::bind_indices(uint32_t frame) {
+    size_t newest = m_index_lists.size();
+    while (newest > 0 && m_index_lists[newest - 1].upload_serial > m_upload_completed) {
+        --newest;
+    }
+    const IndexList index_list = newest > 0 ? m_index_lists[newest - 1] : IndexList();
+    if (m_bound_indices[frame].buffer != index_list.buffer) {
+        m_bound_indices[frame] = index_list;
+        m_draw_recorded_version[frame] = 0;
+    }
+
+    for (size_t i = 0; i + 1 < newest; ) {
+        const VkBuffer buffer = m_index_lists[i].buffer;
+        const bool bound = std::any_of(std::begin(m_bound_indices), std::end(m_bound_indices), [buffer](const IndexList & l) {
+            return l.buffer == buffer;
+        });
+        if (buffer != VK_NULL_HANDLE && bound) {
+            ++i;
+            continue;
+        }
+        destroy_index_list(m_index_lists[i]);
+        m_index_lists.erase(m_index_lists.begin() + i);
+        --newest;
+    }
+}
+
+bool Render::setup_staging_ring() {
+    VkCommandPoolCreateInfo command_pool_create_info{
+        VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, nullptr,
+        VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        m_transfer_queue_family_index};
+    VkResult res = vkCreateCommandPool(m_device, &command_pool_create_info, nullptr, &m_transfer_command_pool);
     if (res != VK_SUCCESS) {
         return false;
     }
-    memcpy(data, vertices.data(), (size_t) vertex_size);
-    memcpy(((char *) data) + m_vertex_buffer_index_offset_line, line_indices.data(), (size_t) line_index_size);
-    memcpy(((char *) data) + m_vertex_buffer_index_offset_tri, triangle_indices.data(), (size_t) tri_index_size);
 
-    VkMappedMemoryRange mapped_memory_range{
-        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr,
-        vertex_buffer_memory_staging, 0, vertex_buffer_size
+    VkBufferCreateInfo staging_buffer_create_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
+        VkBufferCreateFlags(),
+        STAGING_RING_SIZE,
+        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        VK_SHARING_MODE_EXCLUSIVE,
+        0, nullptr
     };
-    res = vkFlushMappedMemoryRanges(m_device, 1, &mapped_memory_range);
+    res = vkCreateBuffer(m_device, &staging_buffer_create_info, nullptr, &m_staging_buffer);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_staging_memory = alloc(m_staging_buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+    if (m_staging_memory == VK_NULL_HANDLE) {
+        return false;
+    }
+    void * data;
+    res = vkMapMemory(m_device, m_staging_memory, 0, STAGING_RING_SIZE, 0, &data);
     if (res != VK_SUCCESS) {
         return false;
     }
-    vkUnmapMemory(m_device, vertex_buffer_memory_staging);
+    m_staging_data = (char *) data;
 
-    // copy staging buffer to device memory
-    {
-        VkCommandBufferAllocateInfo alloc_info{
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
-            m_command_pool,
-            VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-            1
-        };
-        VkCommandBuffer command_buffer;
-        res = vkAllocateCommandBuffers(m_device, &alloc_info, &command_buffer);
+    VkCommandBufferAllocateInfo allocate_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, nullptr,
+        m_transfer_command_pool,
+        VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        1
+    };
+    for (StagingSlot & slot : m_staging_slots) {
+        res = vkAllocateCommandBuffers(m_device, &allocate_info, &slot.command_buffer);
         if (res != VK_SUCCESS) {
             return false;
         }
+        slot.fence = create_fence(m_device, VkFenceCreateFlags());
+        if (slot.fence == VK_NULL_HANDLE) {
+            return false;
+        }
+    }
+    return true;
+}
 
-        VkCommandBufferBeginInfo begin_info{
-            VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
-            VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
-            nullptr
-        };
-        res = vkBeginCommandBuffer(command_buffer, &begin_info);
+bool Render::begin_staging_slot() {
+    StagingSlot & slot = m_staging_slots[m_staging_slot];
+
+    // only wait for the copy that last used this slot, not for the whole queue
+    if (slot.serial != 0) {
+        VkResult res = vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
         if (res != VK_SUCCESS) {
             return false;
         }
+        slot.serial = 0;
+    }
+    VkResult res = vkResetFences(m_device, 1, &slot.fence);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
 
-        VkBufferCopy buffer_copy{
-            0, 0, vertex_buffer_size
-        };
-        vkCmdCopyBuffer(command_buffer, vertex_buffer_staging, m_vertex_buffer, 1, &buffer_copy);
+    VkCommandBufferBeginInfo begin_info{
+        VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr,
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        nullptr
+    };
+    res = vkBeginCommandBuffer(slot.command_buffer, &begin_info);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_staging_fill = 0;
+    m_staging_recording = true;
+    return true;
+}
 
-        res = vkEndCommandBuffer(command_buffer);
-        if (res != VK_SUCCESS) {
+bool Render::stage(VkBuffer dst, VkDeviceSize dst_offset, const void * data, VkDeviceSize size) {
+    const VkDeviceSize slot_size = STAGING_RING_SIZE / STAGING_SLOTS;
+    const char * src = (const char *) data;
+
+    while (size > 0) {
+        if (!m_staging_recording && !begin_staging_slot()) {
             return false;
         }
+        StagingSlot & slot = m_staging_slots[m_staging_slot];
+        const VkDeviceSize src_offset = m_staging_slot * slot_size + m_staging_fill;
+        const VkDeviceSize count = std::min(size, slot_size - m_staging_fill);
 
-        VkSubmitInfo submit_info{
-            VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
-            0, nullptr,
-            nullptr,
-            1, &command_buffer,
-            0, nullptr
+        memcpy(m_staging_data + src_offset, src, (size_t) count);
+        VkBufferCopy buffer_copy{
+            src_offset, dst_offset, count
         };
-        res = vkQueueSubmit(m_queue, 1, &submit_info, VK_NULL_HANDLE);
-        if (res != VK_SUCCESS) {
+        vkCmdCopyBuffer(slot.command_buffer, m_staging_buffer, dst, 1, &buffer_copy);
+
+        m_staging_fill += count;
+        src += count;
+        dst_offset += count;
+        size -= count;
+
+        if (m_staging_fill == slot_size && submit_staging() == 0) {
             return false;
         }
-        res = vkQueueWaitIdle(m_queue);
-        if (res != VK_SUCCESS) {
+    }
+    return true;
+}
+
+uint64_t Render::submit_staging() {
+    if (!m_staging_recording) {
+        return m_upload_serial;
+    }
+    m_staging_recording = false;
+
+    const VkDeviceSize slot_size = STAGING_RING_SIZE / STAGING_SLOTS;
+    StagingSlot & slot = m_staging_slots[m_staging_slot];
+
+    VkMappedMemoryRange mapped_memory_range{
+        VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE, nullptr,
+        m_staging_memory, m_staging_slot * slot_size, slot_size
+    };
+    VkResult res = vkFlushMappedMemoryRanges(m_device, 1, &mapped_memory_range);
+    if (res != VK_SUCCESS) {
+        return 0;
+    }
+
+    res = vkEndCommandBuffer(slot.command_buffer);
+    if (res != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkSubmitInfo submit_info{
+        VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr,
+        0, nullptr,
+        nullptr,
+        1, &slot.command_buffer,
+        0, nullptr
+    };
+    res = vkQueueSubmit(m_transfer_queue, 1, &submit_info, slot.fence);
+    if (res != VK_SUCCESS) {
+        return 0;
+    }
+
+    slot.serial = ++m_upload_serial;
+    m_staging_slot = (m_staging_slot + 1) % STAGING_SLOTS;
+    return slot.serial;
+}
+
+uint64_t Render::poll_uploads() {
+    continue_stream();
+    uint64_t completed = m_upload_serial;
+    for (StagingSlot & slot : m_staging_slots) {
+        if (slot.serial == 0) {
+            continue;
+        }
+        if (vkGetFenceStatus(m_device, slot.fence) == VK_SUCCESS) {
+            continue;
+        }
+        completed = std::min(completed, slot.serial - 1);
+    }
+    m_upload_completed = completed;
+    return completed;
+}
+
+bool Render::create_geometry(size_t vertex_count, size_t line_index_count, size_t triangle_index_count, Geometry & geometry) {
+
+    VkDeviceSize vertex_size = vertex_count * sizeof(vertex_t);
+    VkDeviceSize line_index_size = line_index_count * sizeof(uint32_t);
+    VkDeviceSize tri_index_size = triangle_index_count * sizeof(uint32_t);
+    VkDeviceSize vertex_buffer_size = vertex_size + line_index_size + tri_index_size;
+
+    geometry.index_count_line = (uint32_t) line_index_count;
+    geometry.index_count_tri = (uint32_t) triangle_index_count;
+    geometry.index_offset_line = vertex_size;
+    geometry.index_offset_tri = geometry.index_offset_line + line_index_size;
+
+    // create vertex buffer, shared with the transfer queue if it is a separate family
+    const uint32_t queue_family_indices[] = { m_queue_family_index, m_transfer_queue_family_index };
+    const bool concurrent = m_transfer_queue_family_index != m_queue_family_index;
+    VkBufferCreateInfo buffer_create_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
+        VkBufferCreateFlags(),
+        vertex_buffer_size,
+        // the heatmap reads vertices and indices from compute shaders
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        concurrent ? 2u : 0u, concurrent ? queue_family_indices : nullptr
+    };
+    VkResult res = vkCreateBuffer(m_device, &buffer_create_info, nullptr, &geometry.buffer);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    geometry.memory = alloc(geometry.buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (geometry.memory == VK_NULL_HANDLE) {
+        return false;
+    }
+    return true;
+}
+
+bool Render::upload(std::vector<vertex_t> && vertices, std::vector<uint32_t> && line_indices, std::vector<uint32_t> && triangle_indices) {
+    if (!m_init || m_uploaded) {
+        return false;
+    }
+    if (!create_geometry(vertices.size(), line_indices.size(), triangle_indices.size(), m_geometry)) {
+        return false;
+    }
+    // not drawn before continue_stream() has queued the last copy
+    m_geometry.upload_serial = UINT64_MAX;
+    m_stream.vertices = std::move(vertices);
+    m_stream.indices_line = std::move(line_indices);
+    m_stream.indices_tri = std::move(triangle_indices);
+    m_stream.offset = 0;
+    m_streaming = true;
+    m_uploaded = true;
+    return continue_stream();
+}
+
+bool Render::staging_slot_free(uint32_t index) const {
+    const StagingSlot & slot = m_staging_slots[index];
+    return slot.serial == 0 || vkGetFenceStatus(m_device, slot.fence) == VK_SUCCESS;
+}
+
+// The geometry lies in the buffer in the order of the three arrays, so the
+// stream offset is also the destination offset. Copies only into staging
+// slots that are free, and only if the slot after them is free as well, so
+// other updates never wait behind the stream.
+bool Render::continue_stream() {
+    if (!m_streaming) {
+        return true;
+    }
+    const VkDeviceSize slot_size = STAGING_RING_SIZE / STAGING_SLOTS;
+    const struct {
+        const char * data;
+        VkDeviceSize size;
+    } parts[] = {
+        { (const char *) m_stream.vertices.data(), m_stream.vertices.size() * sizeof(vertex_t) },
+        { (const char *) m_stream.indices_line.data(), m_stream.indices_line.size() * sizeof(uint32_t) },
+        { (const char *) m_stream.indices_tri.data(), m_stream.indices_tri.size() * sizeof(uint32_t) }
+    };
+
+    VkDeviceSize budget = STREAM_BYTES_PER_POLL;
+    VkDeviceSize part_start = 0;
+    for (const auto & part : parts) {
+        while (budget > 0 && m_stream.offset < part_start + part.size) {
+            if (!m_staging_recording &&
+                (!staging_slot_free(m_staging_slot) || !staging_slot_free((m_staging_slot + 1) % STAGING_SLOTS))) {
+                return true;
+            }
+            const VkDeviceSize fill = m_staging_recording ? m_staging_fill : 0;
+            const VkDeviceSize count = std::min({ part_start + part.size - m_stream.offset, budget, slot_size - fill });
+            if (!stage(m_geometry.buffer, m_stream.offset, part.data + (m_stream.offset - part_start), count)) {
+                m_streaming = false;
+                return false;
+            }
+            m_stream.offset += count;
+            budget -= count;
+        }
+        part_start += part.size;
+    }
+    // queue what this call has copied rather than wait for the next one
+    const uint64_t serial = submit_staging();
+    if (serial == 0) {
+        m_streaming = false;
+        return false;
+    }
+    if (m_stream.offset == part_start) {
+        m_geometry.upload_serial = serial;
+        m_stream = Stream();
+        m_streaming = false;
+    }
+    return true;
+}
+
+bool Render::setup_tile_pool(uint32_t slots, VkDeviceSize slot_size) {
+    if (!m_init || m_tile_buffer != VK_NULL_HANDLE) {
+        return false;
+    }
+    const uint32_t queue_family_indices[] = { m_queue_family_index, m_transfer_queue_family_index };
+    const bool concurrent = m_transfer_queue_family_index != m_queue_family_index;
+    VkBufferCreateInfo buffer_create_info{
+        VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, nullptr,
+        VkBufferCreateFlags(),
+        slots * slot_size,
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+        concurrent ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+        concurrent ? 2u : 0u, concurrent ? queue_family_indices : nullptr
+    };
+    VkResult res = vkCreateBuffer(m_device, &buffer_create_info, nullptr, &m_tile_buffer);
+    if (res != VK_SUCCESS) {
+        return false;
+    }
+    m_tile_memory = alloc(m_tile_buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (m_tile_memory == VK_NULL_HANDLE) {
+        return false;
+    }
+    m_tile_slot_size = slot_size;
+    m_tile_slots.assign(slots, TileSlot());
+    return true;
+}
+
+bool Render::upload_tile(uint32_t slot, const geometry_t & geometry, bool & overwritten) {
+    overwritten = false;
+    if (slot >= m_tile_slots.size()) {
+        return false;
+    }
+    TileSlot & tile = m_tile_slots[slot];
+    // frames up to IMAGE_COUNT back may still be reading the slot
+    if (tile.drawn_frame != 0 && m_frame_id <= tile.drawn_frame + IMAGE_COUNT) {
+        return false;
+    }
+    const VkDeviceSize vertex_size = geometry.vertices.size() * sizeof(vertex_t);
+    const VkDeviceSize line_index_size = geometry.indices_line.size() * sizeof(uint32_t);
+    const VkDeviceSize tri_index_size = geometry.indices_tri.size() * sizeof(uint32_t);
+    const VkDeviceSize size = vertex_size + line_index_size + tri_index_size;
+    if (size > m_tile_slot_size) {
+        return false;
+    }
+    // the staging slots the copy will use must be free already, so that the
+    // window thread never waits for one
+    const VkDeviceSize slot_size = STAGING_RING_SIZE / STAGING_SLOTS;
+    VkDeviceSize room = m_staging_recording ? slot_size - m_staging_fill : 0;
+    for (uint32_t i = m_staging_recording ? 1 : 0; room < size && i < STAGING_SLOTS; ++i) {
+        if (!staging_slot_free((m_staging_slot + i) % STAGING_SLOTS)) {
             return false;
         }
+        room += slot_size;
+    }
+
+    // from here on the slot's old contents are gone; it is not drawn again
+    // until the new upload has landed
+    const VkDeviceSize base = slot * m_tile_slot_size;
+    const VkDeviceSize index_offset_line = vertex_size;
+    const VkDeviceSize index_offset_tri = vertex_size + line_index_size;
+    tile.upload_serial = UINT64_MAX;
+    tile.drawn_frame = 0;
+    overwritten = true;
+    if (!stage(m_tile_buffer, base, geometry.vertices.data(), vertex_size) ||
+        !stage(m_tile_buffer, base + index_offset_line, geometry.indices_line.data(), line_index_size) ||
+        !stage(m_tile_buffer, base + index_offset_tri, geometry.indices_tri.data(), tri_index_size)) {
+        return false;
+    }
+    const uint64_t serial = submit_staging();
+    if (serial == 0) {
+        return false;
+    }
+    tile.index_count_line = (uint32_t) geometry.indices_line.size();
+    tile.index_count_tri = (uint32_t) geometry.indices_tri.size();
+    tile.index_offset_line = index_offset_line;
+    tile.index_offset_tri = index_offset_tri;
+    tile.upload_serial = serial;
+    return true;
+}
 
-        vkFreeCommandBuffers(m_device, m_command_pool, 1, &command_buffer);
+void Render::set_tile_draws(const std::vector<uint32_t> & slots) {
+    m_tile_requested.clear();
+    for (uint32_t slot : slots) {
+        if (slot < m_tile_slots.size()) {
+            m_tile_requested.push_back(slot);
+        }
     }
+}
 
-    vkDestroyBuffer(m_device, vertex_buffer_staging, nullptr);
-    vkFreeMemory(m_device, vertex_buffer_memory_staging, nullptr);
+bool Render::upload_preview(const geometry_t & geometry) {
+    if (!m_init || m_uploaded) {
+        return false;
+    }
+    Geometry preview;
+    if (!create_geometry(geometry.vertices.size(), geometry.indices_line.size(), geometry.indices_tri.size(), preview) ||
+        !stage(preview.buffer, 0, geometry.vertices.data(), preview.index_offset_line) ||
+        !stage(preview.buffer, preview.index_offset_line, geometry.indices_line.data(), preview.index_offset_tri - preview.index_offset_line) ||
+        !stage(preview.buffer, preview.index_offset_tri, geometry.indices_tri.data(), geometry.indices_tri.size() * sizeof(uint32_t))) {
+        destroy_geometry(preview);
+        return false;
+    }
+    preview.upload_serial = submit_staging();
+    if (preview.upload_serial == 0) {
+        destroy_geometry(preview);
+        return false;
+    }
+    m_preview.push_back(preview);
     return true;
 }
 
-bool Render::init(HINSTANCE hinstance, HWND hwnd, const std::vector<vertex_t> & vertices, const std::vector<uint32_t> & line_indices, const std::vector<uint32_t> & triangle_indices) {
+bool Render::init(HINSTANCE hinstance, HWND hwnd) {
     // instance
 
     m_instance = create_instance();
@@ -1067,16 +2759,22 @@ bool Render::init(HINSTANCE hinstance, HWND hwnd, const std::vector<vertex_t> &
 
     // device
 
-    m_device = create_device(m_physical_device, m_queue_family_index);
+    m_transfer_queue_family_index = get_transfer_queue_family_index(m_physical_device, m_queue_family_index);
+
+    m_device = create_device(m_physical_device, m_queue_family_index, m_transfer_queue_family_index);
     if (m_device == VK_NULL_HANDLE) {
         return false;
     }
+    VkPhysicalDeviceFeatures features;
+    vkGetPhysicalDeviceFeatures(m_physical_device, &features);
+    m_multi_draw_indirect = features.multiDrawIndirect == VK_TRUE;
 
     vkCmdBeginRenderingKHR = reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(m_device, "vkCmdBeginRenderingKHR"));
     vkCmdEndRenderingKHR = reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(m_device, "vkCmdEndRenderingKHR"));
 
     const int queueIndex = 0;
     vkGetDeviceQueue(m_device, m_queue_family_index, queueIndex, &m_queue);
+    vkGetDeviceQueue(m_device, m_transfer_queue_family_index, queueIndex, &m_transfer_queue);
 
     VkSurfaceCapabilitiesKHR surface_capabilities;
     VkResult res = vkGetPhysicalDeviceSurfaceCapabilitiesKHR(m_physical_device, m_surface, &surface_capabilities);
@@ -1105,6 +2803,12 @@ bool Render::init(HINSTANCE hinstance, HWND hwnd, const std::vector<vertex_t> &
         return false;
     }
 
+    // staging ring for geometry uploads
+
+    if (!setup_staging_ring()) {
+        return false;
+    }
+
     // descriptors
 
     if (!setup_descriptors()) {
@@ -1123,23 +2827,37 @@ bool Render::init(HINSTANCE hinstance, HWND hwnd, const std::vector<vertex_t> &
         return false;
     }
 
+    // instrumentation
+
+    if (!setup_timestamps()) {
+        return false;
+    }
+    if (!setup_overlay()) {
+        return false;
+    }
+    if (!setup_indirect()) {
+        return false;
+    }
+    if (!setup_heatmap()) {
+        return false;
+    }
+
     // per-frame sync stuff
 
-    const size_t num_frames = m_image_views.size();
-    m_queue_submit_fence.reserve(num_frames);
-    m_swapchain_acquire_semaphore.reserve(num_frames);
-    m_swapchain_release_semaphore.reserve(num_frames);
+    // fences and acquire semaphores belong to frames in flight, release
+    // semaphores to the swapchain image they are presented with
 
-    for (size_t i = 0; i < num_frames; ++i) {
+    m_queue_submit_fence.reserve(IMAGE_COUNT);
+    m_swapchain_acquire_semaphore.reserve(IMAGE_COUNT);
+    for (size_t i = 0; i < IMAGE_COUNT; ++i) {
         m_queue_submit_fence.push_back(create_fence(m_device, VK_FENCE_CREATE_SIGNALED_BIT));
         m_swapchain_acquire_semaphore.push_back(create_semaphore(m_device, VkSemaphoreCreateFlags()));
+    }
+    m_swapchain_release_semaphore.reserve(m_images.size());
+    for (size_t i = 0; i < m_images.size(); ++i) {
         m_swapchain_release_semaphore.push_back(create_semaphore(m_device, VkSemaphoreCreateFlags()));
     }
 
-    // vertex buffer
-
-    setup_vertex_buffer(vertices, line_indices, triangle_indices);
-
     m_init = true;
     return true;
 }
@@ -4,8 +4,10 @@
 #define VULKAN_HPP_NO_EXCEPTIONS
 #define VULKAN_HPP_TYPESAFE_CONVERSION
 #include <vulkan/vulkan.h>
+#include <utility>
 #include <vector>
 
+#include "FrameStats.h"
 #include "VertexData.h"
 
 class Render {
@@ -16,9 +18,86 @@ public:
     PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR;
     PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR;
 
-    bool init(HINSTANCE hinstance, HWND hwnd, const std::vector<vertex_t> & vertices, const std::vector<uint32_t> & line_indices, const std::vector<uint32_t> & triangle_indices);
-    void draw();
+    // init() does not touch the trace, so it can run on its own thread while the trace is parsed.
+    bool init(HINSTANCE hinstance, HWND hwnd);
+    // Takes the geometry over and streams it to the GPU a bounded number of
+    // bytes per poll of the uploads, so the window thread never waits for
+    // the copies; drawn once the last one has landed.
+    bool upload(std::vector<vertex_t> && vertices, std::vector<uint32_t> && line_indices, std::vector<uint32_t> && triangle_indices);
+    // Coarse geometry drawn while loading; dropped by upload().
+    bool upload_preview(const geometry_t & geometry);
+    bool has_geometry() const { return m_uploaded || !m_preview.empty() || !m_tile_slots.empty(); }
+    // One bit per task of the uploaded geometry (task = vertex index / 3),
+    // packed into 32-bit words. Only the bitset is uploaded; an empty set
+    // clears the highlight.
+    bool set_highlight(const std::vector<uint32_t> & bits);
+    // Colour lookup table; vertices are coloured by colors[name_index % size],
+    // or by colors[proc % size] if by_process is set. Geometry is untouched.
+    bool set_palette(const std::vector<color_t> & colors, bool by_process);
+    // Draws the uploaded vertices through these index lists instead of the
+    // ones passed to upload(); the vertex data stays where it is.
+    // reset_indices() goes back to the full lists.
+    bool set_indices(const std::vector<uint32_t> & line_indices, const std::vector<uint32_t> & triangle_indices);
+    bool reset_indices();
+    // y offset of every layout slot (see Layout.h), NaN to hide the slot.
+    // Vertices whose slot is beyond the table are drawn where they are.
+    bool set_slots(const std::vector<float> & offsets);
+    // Draws only these (first task, task count) ranges of the current index
+    // lists, e.g. the rows in view. Read every frame, so following the view
+    // needs no re-recording; ranges beyond MAX_DRAW_RANGES are dropped.
+    void set_visible_tasks(const std::vector< std::pair<uint32_t, uint32_t> > & ranges);
+    static constexpr uint32_t MAX_DRAW_RANGES = 64;
+    // Overview strip along the top of the window: rows of width values in
+    // [0, 1], top row first. Drawn as one quad, however large the trace.
+    bool set_minimap(const std::vector<float> & coverage, uint32_t width);
+    // part of the trace in view, in minimap coordinates (u0, v0, u1, v1)
+    void set_minimap_view(const float view[4]);
+    void show_minimap(bool show);
+    bool minimap() const { return m_minimap_shown; }
+    // Density heatmap instead of the task geometry: a compute pass bins the
+    // tasks of the current index lists into a fixed-size buffer, which is
+    // then tone-mapped over the whole window.
+    void set_heatmap(bool heatmap);
+    // Idle gaps drawn as light red quads behind the tasks; empty for none.
+    bool set_gaps(const std::vector<gap_t> & gaps);
+    // Line graphs of the counter tracks; consecutive points of the same
+    // slot are joined. They change whenever the view pans, so they are
+    // copied into the frame's own buffer when it is rendered instead of
+    // being uploaded.
+    bool set_counter_points(const std::vector<counter_point_t> & points);
+    bool heatmap() const { return m_heatmap; }
+    // Out-of-core traces: a fixed pool of equally sized slots, each holding
+    // the geometry of one tile (see TileCache.h), drawn in addition to any
+    // other geometry.
+    bool setup_tile_pool(uint32_t slots, VkDeviceSize slot_size);
+    // Fails if the geometry does not fit a slot, frames in flight may still
+    // draw the slot or the staging ring is busy; the caller tries again
+    // later. overwritten tells whether the slot's old tile is gone, which
+    // it is after a success and after a copy that failed half way.
+    bool upload_tile(uint32_t slot, const geometry_t & geometry, bool & overwritten);
+    // Slots to draw, in order; slots whose upload has not landed yet are
+    // left out until it has.
+    void set_tile_draws(const std::vector<uint32_t> & slots);
+    bool uploads_pending() {
+        const uint64_t completed = poll_uploads();
+        return m_streaming || completed < m_upload_serial;
+    }
+    // Never blocks. Returns false if no frame slot or swapchain image is free
+    // right now; the caller should try again a little later.
+    bool draw();
     bool resize();
+    // Takes effect immediately if the swapchain already exists; modes the
+    // surface does not support fall back to FIFO.
+    bool set_present_mode(VkPresentModeKHR present_mode);
+    VkPresentModeKHR present_mode() const { return m_present_mode; }
+    // modes the surface supports, empty until the swapchain exists
+    const std::vector<VkPresentModeKHR> & present_modes() const { return m_present_modes; }
+    // Frame timings go to stats (may be nullptr); the overlay graphs them.
+    void set_stats(FrameStats * stats) { m_stats = stats; }
+    void set_overlay(bool overlay);
+    bool overlay() const { return m_overlay; }
+    // id of the last frame handed to the presentation engine
+    uint64_t frame_id() const { return m_frame_id; }
 
     float m_x =  0.0f;
     float m_y =  0.0f;
@@ -27,26 +106,178 @@ public:
     uint32_t                            m_selected_index = 999;
 
 private:
+    static constexpr uint32_t IMAGE_COUNT = 3;
+
+    struct Geometry {
+        VkBuffer        buffer = VK_NULL_HANDLE;
+        VkDeviceMemory  memory = VK_NULL_HANDLE;
+        uint32_t        index_count_line = 0;
+        uint32_t        index_count_tri = 0;
+        VkDeviceSize    index_offset_line = 0;
+        VkDeviceSize    index_offset_tri = 0;
+        uint64_t        upload_serial = 0;
+        uint64_t        retired_frame = 0;  // last frame that may draw it, once replaced
+    };
+
+    // geometry handed to upload(), copied a piece per poll_uploads()
+    struct Stream {
+        std::vector<vertex_t>   vertices;
+        std::vector<uint32_t>   indices_line;
+        std::vector<uint32_t>   indices_tri;
+        VkDeviceSize            offset = 0;     // bytes of the three arrays staged so far
+    };
+
+    // A storage buffer the vertex shader reads, replaced as a whole on
+    // every update. Frames in flight keep their version until their slot
+    // binds the next one.
+    struct StorageBuffer {
+        VkBuffer        buffer = VK_NULL_HANDLE;
+        VkDeviceMemory  memory = VK_NULL_HANDLE;
+        uint32_t        count = 0;      // elements, passed to the shader
+        uint32_t        mode = 0;       // passed to the shader
+        uint64_t        upload_serial = 0;
+    };
+
+    struct StorageBinding {
+        uint32_t                    binding;
+        std::vector<StorageBuffer>  versions;   // newest last
+        VkBuffer                    bound[IMAGE_COUNT] = {};
+        uint32_t                    count[IMAGE_COUNT] = {};
+        uint32_t                    mode[IMAGE_COUNT] = {};
+    };
+
+    // Host-visible buffer holding the counter points of one frame slot,
+    // rewritten in place and only replaced when the points outgrow it.
+    struct CounterSlot {
+        VkBuffer            buffer = VK_NULL_HANDLE;
+        VkDeviceMemory      memory = VK_NULL_HANDLE;
+        counter_point_t *   data = nullptr;
+        uint32_t            capacity = 0;   // points
+        uint32_t            count = 0;
+        uint64_t            version = 0;    // of m_counter_points
+    };
+
+    // Index lists replacing the ones of m_geometry, versioned like the
+    // storage buffers. A null buffer stands for the geometry's own lists.
+    struct IndexList {
+        VkBuffer        buffer = VK_NULL_HANDLE;
+        VkDeviceMemory  memory = VK_NULL_HANDLE;
+        uint32_t        index_count_line = 0;
+        uint32_t        index_count_tri = 0;
+        VkDeviceSize    index_offset_tri = 0;
+        uint64_t        upload_serial = 0;
+    };
+
+    // the frame time overlay keeps its own colours
+    struct overlay_vertex_t {
+        pos_t pos;
+        color_t color;
+    };
+
+    struct TileSlot {
+        uint32_t        index_count_line = 0;
+        uint32_t        index_count_tri = 0;
+        VkDeviceSize    index_offset_line = 0;
+        VkDeviceSize    index_offset_tri = 0;
+        uint64_t        upload_serial = 0;
+        uint64_t        drawn_frame = 0;    // last frame that drew it
+    };
+
+    struct StagingSlot {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VkFence         fence = VK_NULL_HANDLE;
+        uint64_t        serial = 0;     // copy in flight, 0 if none
+    };
+
     VkDeviceMemory alloc(VkImage image, VkMemoryPropertyFlags properties);
     VkDeviceMemory alloc(VkBuffer image, VkMemoryPropertyFlags properties);
     VkDeviceMemory alloc(VkMemoryRequirements requirements, VkMemoryPropertyFlags properties);
 
     static VkInstance create_instance();
     static VkPhysicalDevice select_physical_device(VkInstance instance);
-    static VkDevice create_device(VkPhysicalDevice physical_device, uint32_t queue_family_index);
+    static VkDevice create_device(VkPhysicalDevice physical_device, uint32_t queue_family_index, uint32_t transfer_queue_family_index);
 
     VkSurfaceKHR create_surface(HINSTANCE hinstance, HWND hwnd) const;
     bool create_swapchain(VkSwapchainKHR old_swapchain, VkSurfaceCapabilitiesKHR & surface_capabilities);
+    bool recreate_swapchain(VkSurfaceCapabilitiesKHR & surface_capabilities);
     bool create_command_buffers();
     bool setup_descriptors();
     bool create_pipeline();
-    bool update_uniform_buffer();
-    bool setup_vertex_buffer(const std::vector<vertex_t> & vertices, const std::vector<uint32_t> & line_indices, const std::vector<uint32_t> & triangle_indices);
-    bool render(uint32_t swapchain_index);
+    bool setup_timestamps();
+    bool setup_overlay();
+    bool setup_indirect();
+    bool setup_heatmap();
+    void read_timestamps(uint32_t frame);
+    void update_overlay(uint32_t frame);
+    void update_indirect(uint32_t frame);
+    void draw_visible(VkCommandBuffer command_buffer, uint32_t frame, bool triangles);
+    void draw_tiles(VkCommandBuffer command_buffer, bool triangles);
+    void bind_heat_sources(uint32_t frame);
+    void record_heatmap(VkCommandBuffer command_buffer, uint32_t frame);
+    bool update_uniform_buffer(uint32_t frame);
+    void update_draw_list();
+    bool record_draw_commands(uint32_t frame);
+    bool create_geometry(size_t vertex_count, size_t line_index_count, size_t triangle_index_count, Geometry & geometry);
+    void destroy_geometry(Geometry & geometry);
+    bool create_storage_buffer(VkDeviceSize size, StorageBuffer & storage_buffer);
+    void destroy_storage_buffer(StorageBuffer & storage_buffer);
+    bool setup_storage_binding(StorageBinding & storage);
+    void write_storage_descriptor(uint32_t frame, uint32_t binding, VkBuffer buffer);
+    bool update_storage(StorageBinding & storage, const void * data, VkDeviceSize size, uint32_t count, uint32_t mode);
+    void bind_storage(StorageBinding & storage, uint32_t frame);
+    bool create_counter_slot(uint32_t frame, uint32_t capacity);
+    void destroy_counter_slot(CounterSlot & slot);
+    bool update_counter_slot(uint32_t frame);
+    void destroy_index_list(IndexList & index_list);
+    void bind_indices(uint32_t frame);
+    bool setup_staging_ring();
+    bool begin_staging_slot();
+    bool staging_slot_free(uint32_t index) const;
+    bool continue_stream();
+    bool stage(VkBuffer dst, VkDeviceSize dst_offset, const void * data, VkDeviceSize size);
+    uint64_t submit_staging();
+    uint64_t poll_uploads();
+    bool render(uint32_t frame, uint32_t swapchain_index);
 
     VkResult acquire_next_image(uint32_t frame, uint32_t & image_index);
 
-    static constexpr uint32_t IMAGE_COUNT = 3;
+    // The std140 UniformBufferObject block of the shaders, field by field.
+    struct UniformBlock {
+        float       matrix[16];
+        uint32_t    selected_index;
+        uint32_t    highlight_count;
+        uint32_t    palette_count;
+        uint32_t    palette_mode;
+        uint32_t    slot_count;
+        uint32_t    minimap_width;
+        uint32_t    minimap_height;
+        uint32_t    pad0;               // minimap_view is a vec4
+        float       minimap_view[4];
+        uint32_t    heat_index_offset;
+        uint32_t    heat_task_count;
+        uint32_t    heat_columns;
+        uint32_t    heat_bins;
+        float       heat_rows_per_bin;
+        uint32_t    heat_range_count;
+        uint32_t    pad1[2];            // blocks are padded to 16 bytes
+    };
+    static_assert(sizeof(UniformBlock) % 16 == 0, "std140 blocks are multiples of 16 bytes");
+    static constexpr VkDeviceSize UNIFORM_SIZE = sizeof(UniformBlock);
+    static constexpr VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+    static constexpr uint32_t STAGING_SLOTS = 4;
+    // at most two slots' worth of copying per poll
+    static constexpr VkDeviceSize STREAM_BYTES_PER_POLL = 2 * STAGING_RING_SIZE / STAGING_SLOTS;
+    // start, after lines, after triangles
+    static constexpr uint32_t QUERIES_PER_FRAME = 3;
+    static constexpr uint32_t OVERLAY_BARS = 120;
+    // two quads per bar plus the 60 Hz budget line
+    static constexpr uint32_t OVERLAY_VERTICES = (2 * OVERLAY_BARS + 1) * 6;
+    // heatmap resolution, at most one cell per pixel
+    static constexpr uint32_t HEAT_MAX_COLUMNS = 4096;
+    static constexpr uint32_t HEAT_MAX_BINS = 1024;
+    static constexpr uint32_t COUNTER_BINDING = 9;
+    // initial points per frame slot, about two per pixel of a few tracks
+    static constexpr uint32_t COUNTER_SLOT_POINTS = 16384;
     static constexpr VkSampleCountFlagBits SAMPLES = VK_SAMPLE_COUNT_1_BIT;
     static constexpr VkFormat COLOR_FORMAT = VK_FORMAT_B8G8R8A8_UNORM;
     static constexpr const char * DEVICE_EXTENSIONS[] = {
@@ -56,10 +287,6 @@ private:
         VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME
     };
 
-    uint32_t                            m_index_count_line;
-    uint32_t                            m_index_count_tri;
-    VkDeviceSize                        m_vertex_buffer_index_offset_line;
-    VkDeviceSize                        m_vertex_buffer_index_offset_tri;
     VkInstance                          m_instance;
     VkPhysicalDevice                    m_physical_device;
     VkPhysicalDeviceMemoryProperties    m_memory_properties;
@@ -68,26 +295,93 @@ private:
     uint32_t                            m_queue_family_index;
     VkDevice                            m_device;
     VkQueue                             m_queue;
+    uint32_t                            m_transfer_queue_family_index;
+    VkQueue                             m_transfer_queue;
+    VkCommandPool                       m_transfer_command_pool = VK_NULL_HANDLE;
+    VkBuffer                            m_staging_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory                      m_staging_memory = VK_NULL_HANDLE;
+    char *                              m_staging_data = nullptr;
+    StagingSlot                         m_staging_slots[STAGING_SLOTS];
+    uint32_t                            m_staging_slot = 0;
+    VkDeviceSize                        m_staging_fill = 0;
+    bool                                m_staging_recording = false;
+    uint64_t                            m_upload_serial = 0;
+    uint64_t                            m_upload_completed = 0;
+    Stream                              m_stream;
+    bool                                m_streaming = false;
     VkCommandPool                       m_command_pool;
     VkExtent2D                          m_extent;
     VkSwapchainKHR                      m_swapchain;
-    VkPipeline                          m_pipeline[2];
+    VkPipeline                          m_pipeline[7];
+    VkPipeline                          m_heat_pipelines[2] = {};   // bin, scan
     VkPipelineLayout                    m_pipeline_layout;
-    VkBuffer                            m_vertex_buffer;
-    VkDeviceMemory                      m_vertex_buffer_memory;
+    Geometry                            m_geometry;
+    std::vector<Geometry>               m_preview;
+    std::vector<Geometry>               m_retired;          // previews waiting for their frames
+    StorageBinding                      m_highlight{ 1 };
+    StorageBinding                      m_palette{ 2 };
+    StorageBinding                      m_slots{ 3 };
+    StorageBinding                      m_minimap{ 4 };     // mode is the width
+    StorageBinding                      m_gaps{ 8 };
+    std::vector<counter_point_t>        m_counter_points;
+    uint64_t                            m_counter_version = 0;
+    CounterSlot                         m_counter_slots[IMAGE_COUNT];
+    std::vector<IndexList>              m_index_lists;      // newest last
+    IndexList                           m_bound_indices[IMAGE_COUNT];
     VkDescriptorPool                    m_descriptor_pool;
     VkDescriptorSetLayout               m_descriptor_set_layout;
-    VkDescriptorSet                     m_descriptor_set;
-    VkDescriptorBufferInfo              m_uniform_buffer_descriptor;
+    VkDescriptorSet                     m_descriptor_sets[IMAGE_COUNT];
+    VkDeviceSize                        m_uniform_slot_size;
     VkBuffer                            m_uniform_buffer;
     VkDeviceMemory                      m_uniform_buffer_memory;
     void *                              m_uniform_memory_data;
     std::vector<VkImage>                m_images;
     std::vector<VkImageView>            m_image_views;
-    std::vector<VkCommandBuffer>        m_command_buffers;
+    VkCommandBuffer                     m_command_buffers[IMAGE_COUNT];
+    VkCommandBuffer                     m_draw_command_buffers[IMAGE_COUNT];
+    uint64_t                            m_draw_recorded_version[IMAGE_COUNT] = {};
+    uint64_t                            m_draw_version = 1;
+    bool                                m_draw_final = false;
+    size_t                              m_draw_preview_count = 0;
     std::vector<VkSemaphore>            m_swapchain_acquire_semaphore;
     std::vector<VkSemaphore>            m_swapchain_release_semaphore;
     std::vector<VkFence>                m_queue_submit_fence;
     uint32_t                            m_frame = 0;
+    VkPresentModeKHR                    m_present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    std::vector<VkPresentModeKHR>       m_present_modes;
+    FrameStats *                        m_stats = nullptr;
+    uint64_t                            m_frame_id = 0;
+    VkQueryPool                         m_query_pool = VK_NULL_HANDLE;
+    float                               m_timestamp_period = 1.0f;
+    uint64_t                            m_query_frame[IMAGE_COUNT] = {};
+    double                              m_record_ms = 0.0;
+    double                              m_submit_ms = 0.0;
+    bool                                m_overlay = false;
+    VkBuffer                            m_overlay_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory                      m_overlay_memory = VK_NULL_HANDLE;
+    overlay_vertex_t *                  m_overlay_data = nullptr;
+    std::vector< std::pair<uint32_t, uint32_t> > m_visible_tasks;
+    bool                                m_culling = false;
+    bool                                m_multi_draw_indirect = false;
+    VkBuffer                            m_indirect_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory                      m_indirect_memory = VK_NULL_HANDLE;
+    VkDrawIndexedIndirectCommand *      m_indirect_data = nullptr;
+    bool                                m_minimap_shown = false;
+    float                               m_minimap_view[4] = {};
+    bool                                m_heatmap = false;
+    VkBuffer                            m_heat_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory                      m_heat_memory = VK_NULL_HANDLE;
+    // what bindings 5 and 6 of each frame's descriptor set point to
+    VkBuffer                            m_heat_vertices[IMAGE_COUNT] = {};
+    VkBuffer                            m_heat_indices[IMAGE_COUNT] = {};
+    uint32_t                            m_heat_index_offset[IMAGE_COUNT] = {};
+    uint32_t                            m_heat_task_count[IMAGE_COUNT] = {};
+    VkBuffer                            m_tile_buffer = VK_NULL_HANDLE;
+    VkDeviceMemory                      m_tile_memory = VK_NULL_HANDLE;
+    VkDeviceSize                        m_tile_slot_size = 0;
+    std::vector<TileSlot>               m_tile_slots;
+    std::vector<uint32_t>               m_tile_requested;
+    std::vector<uint32_t>               m_tile_draws;       // requested and uploaded
     bool                                m_init = false;
+    bool                                m_uploaded = false;
 };
@@ -0,0 +1,79 @@
+#include "Search.h"
+
+#include <algorithm>
+#include <regex>
+
+std::vector< std::vector<TaskRef> > g_name_tasks;
+
+std::vector<uint32_t> search_names(const std::vector<std::string> & names, const std::string & pattern, bool regex) {
+    std::vector<uint32_t> result;
+    if (regex) {
+        std::regex re;
+        try {
+            re = std::regex(pattern, std::regex::ECMAScript | std::regex::optimize);
+        } catch (const std::regex_error &) {
+            return result;
+        }
+        for (uint32_t i = 0; i < (uint32_t) names.size(); ++i) {
+            if (std::regex_search(names[i], re)) {
+                result.push_back(i);
+            }
+        }
+        return result;
+    }
+    for (uint32_t i = 0; i < (uint32_t) names.size(); ++i) {
+        if (names[i].find(pattern) != std::string::npos) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+size_t count_occurrences(const std::vector<uint32_t> & name_indices) {
+    size_t count = 0;
+    for (uint32_t name_index : name_indices) {
+        if (name_index < g_name_tasks.size()) {
+            count += g_name_tasks[name_index].size();
+        }
+    }
+    return count;
+}
+
+// One binary search per name, so the cost does not depend on the trace size.
+bool next_occurrence(const std::vector<uint32_t> & name_indices, TaskRef from, bool forward, TaskRef & result) {
+    bool found = false;
+    bool wrapped_found = false;
+    TaskRef wrapped;
+    for (uint32_t name_index : name_indices) {
+        if (name_index >= g_name_tasks.size() || g_name_tasks[name_index].empty()) {
+            continue;
+        }
+        const std::vector<TaskRef> & tasks = g_name_tasks[name_index];
+        if (forward) {
+            auto it = std::upper_bound(tasks.begin(), tasks.end(), from);
+            if (it != tasks.end() && (!found || *it < result)) {
+                result = *it;
+                found = true;
+            }
+            if (!wrapped_found || tasks.front() < wrapped) {
+                wrapped = tasks.front();
+                wrapped_found = true;
+            }
+        } else {
+            auto it = std::lower_bound(tasks.begin(), tasks.end(), from);
+            if (it != tasks.begin() && (!found || result < *(it - 1))) {
+                result = *(it - 1);
+                found = true;
+            }
+            if (!wrapped_found || wrapped < tasks.back()) {
+                wrapped = tasks.back();
+                wrapped_found = true;
+            }
+        }
+    }
+    if (!found && wrapped_found) {
+        result = wrapped;
+        found = true;
+    }
+    return found;
+}
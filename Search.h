@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Position of a task in the timeline: row index into rowdata and position
+// within that row's task list.
+struct TaskRef {
+    uint32_t row = 0;
+    uint32_t pos = 0;
+};
+
+inline bool operator<(const TaskRef & a, const TaskRef & b) {
+    return a.row < b.row || (a.row == b.row && a.pos < b.pos);
+}
+
+// Inverted index: for each name_index, every task with that name in
+// (row, pos) order. Filled while the geometry is generated.
+extern std::vector< std::vector<TaskRef> > g_name_tasks;
+
+// Indices of the names containing pattern, or matching it as an
+// ECMAScript regex. An invalid regex matches nothing.
+std::vector<uint32_t> search_names(const std::vector<std::string> & names, const std::string & pattern, bool regex);
+
+// Number of tasks carrying any of the names.
+size_t count_occurrences(const std::vector<uint32_t> & name_indices);
+
+// The nearest task after (or before) from whose name is one of
+// name_indices, wrapping around the end of the trace. false if there is none.
+bool next_occurrence(const std::vector<uint32_t> & name_indices, TaskRef from, bool forward, TaskRef & result);
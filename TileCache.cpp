@@ -0,0 +1,219 @@
+#include "TileCache.h"
+
+#include <algorithm>
+#include <iostream>
+
+void TileCache::start(const TileFile * file, size_t slots, size_t max_records, size_t threads) {
+    stop();
+    m_file = file;
+    m_max_records = max_records;
+    m_slots.assign(slots, Slot());
+    m_resident.clear();
+    m_pending.clear();
+    m_stop = false;
+    for (size_t i = 0; i < threads; ++i) {
+        m_threads.emplace_back([this]() { work(); });
+    }
+}
+
+void TileCache::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+        m_queue.clear();
+    }
+    m_wake.notify_all();
+    for (std::thread & thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+    m_loading.clear();
+    m_loaded.clear();
+}
+
+// Every worker reads through its own stream, so they only share the queue.
+void TileCache::work() {
+    std::ifstream in(m_file->filename(), std::ios::binary);
+    std::vector<TileRecord> records;
+    for (;;) {
+        uint64_t tile_key;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [this]() { return m_stop || !m_queue.empty(); });
+            if (m_stop) {
+                return;
+            }
+            tile_key = m_queue.front();
+            m_queue.pop_front();
+            m_loading.insert(tile_key);
+        }
+        Loaded loaded{ tile_key, geometry_t() };
+        if (m_file->read_tile(in, (size_t) (tile_key >> 32), (size_t) (tile_key & 0xffffffff), records)) {
+            if (records.size() > m_max_records) {
+                std::nth_element(records.begin(), records.begin() + m_max_records, records.end(), [](const TileRecord & a, const TileRecord & b) {
+                    return a.length > b.length;
+                });
+                records.resize(m_max_records);
+            }
+            tile_geometry(*m_file, records, loaded.geometry);
+        } else {
+            std::cerr << "Reading tile " << (tile_key >> 32) << "/" << (tile_key & 0xffffffff) << " failed" << std::endl;
+        }
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_loading.erase(tile_key);
+        m_loaded.push_back(std::move(loaded));
+    }
+}
+
+// Empty slots first, then the least recently used one the view does not need.
+uint32_t TileCache::free_slot(const std::unordered_set<uint64_t> & wanted) const {
+    uint32_t best = NO_TILE_SLOT;
+    for (uint32_t slot = 0; slot < m_slots.size(); ++slot) {
+        if (m_slots[slot].key != UINT64_MAX && wanted.count(m_slots[slot].key) != 0) {
+            continue;
+        }
+        if (best == NO_TILE_SLOT || m_slots[slot].used < m_slots[best].used) {
+            best = slot;
+        }
+    }
+    return best;
+}
+
+void TileCache::update(uint64_t t0, uint64_t t1, const Upload & upload, std::vector<uint32_t> & draw) {
+    draw.clear();
+    if (m_file == nullptr || m_slots.empty() || t1 <= t0) {
+        return;
+    }
+    ++m_tick;
+    if (t0 != m_last_t0) {
+        m_direction = t0 > m_last_t0 ? 1 : -1;
+        m_last_t0 = t0;
+    }
+
+    // the finest level that shows few enough tiles
+    size_t level = 0;
+    size_t first = 0;
+    size_t last = 0;
+    for (; level < m_file->levels(); ++level) {
+        m_file->tiles_in(level, t0, t1, first, last);
+        if (last - first <= VIEW_TILES || level + 1 == m_file->levels()) {
+            break;
+        }
+    }
+    if (first == last) {
+        return;
+    }
+
+    // in view from the centre outwards, the coarser level for zooming out,
+    // then the tiles ahead in the direction the view moves
+    std::vector<uint64_t> order;
+    const size_t middle = first + (last - first) / 2;
+    for (size_t i = 0; i < last - first; ++i) {
+        const size_t tile = i % 2 == 0 ? middle + i / 2 : middle - (i + 1) / 2;
+        if (tile >= first && tile < last) {
+            order.push_back(key(level, tile));
+        }
+    }
+    if (level + 1 < m_file->levels()) {
+        const size_t parent_first = TileFile::parent(level + 1, first, level);
+        const size_t parent_last = TileFile::parent(level + 1, last - 1, level);
+        for (size_t tile = parent_first; tile <= parent_last; ++tile) {
+            order.push_back(key(level + 1, tile));
+        }
+    }
+    for (size_t i = 1; i <= PREFETCH; ++i) {
+        if (m_direction >= 0 && last - 1 + i < m_file->tiles(level)) {
+            order.push_back(key(level, last - 1 + i));
+        }
+        if (m_direction <= 0 && first >= i) {
+            order.push_back(key(level, first - i));
+        }
+    }
+    // never more than fits, or the view would evict itself
+    order.resize(std::min(order.size(), m_slots.size()));
+    const std::unordered_set<uint64_t> wanted(order.begin(), order.end());
+
+    for (uint64_t tile_key : order) {
+        auto it = m_resident.find(tile_key);
+        if (it != m_resident.end()) {
+            m_slots[it->second].used = m_tick;
+        }
+    }
+
+    // place what has been loaded
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (Loaded & loaded : m_loaded) {
+            m_pending.push_back(std::move(loaded));
+        }
+        m_loaded.clear();
+    }
+    size_t uploads = 0;
+    std::vector<Loaded> waiting;
+    for (Loaded & loaded : m_pending) {
+        if (wanted.count(loaded.key) == 0 || m_resident.count(loaded.key) != 0) {
+            continue;
+        }
+        const uint32_t slot = uploads < MAX_UPLOADS_PER_FRAME ? free_slot(wanted) : NO_TILE_SLOT;
+        if (slot == NO_TILE_SLOT) {
+            waiting.push_back(std::move(loaded));
+            continue;
+        }
+        // an upload that failed before touching the slot leaves its tile
+        // resident; one that failed half way has destroyed it
+        bool overwritten = false;
+        const bool uploaded = upload(slot, loaded.geometry, overwritten);
+        if (overwritten && m_slots[slot].key != UINT64_MAX) {
+            m_resident.erase(m_slots[slot].key);
+            m_slots[slot].key = UINT64_MAX;
+        }
+        if (!uploaded) {
+            waiting.push_back(std::move(loaded));
+            continue;
+        }
+        ++uploads;
+        m_slots[slot] = { loaded.key, m_tick };
+        m_resident[loaded.key] = slot;
+    }
+    m_pending.swap(waiting);
+
+    // queue the rest, replacing requests the view has moved away from
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+        for (uint64_t tile_key : order) {
+            const bool waiting_for_slot = std::any_of(m_pending.begin(), m_pending.end(), [tile_key](const Loaded & loaded) {
+                return loaded.key == tile_key;
+            });
+            if (m_resident.count(tile_key) == 0 && m_loading.count(tile_key) == 0 && !waiting_for_slot) {
+                m_queue.push_back(tile_key);
+            }
+        }
+    }
+    m_wake.notify_all();
+
+    // coarser stand-ins first, so the finer tiles are drawn over them
+    std::vector<uint32_t> fine;
+    for (size_t tile = first; tile < last; ++tile) {
+        auto it = m_resident.find(key(level, tile));
+        if (it != m_resident.end()) {
+            fine.push_back(it->second);
+            continue;
+        }
+        for (size_t coarser = level + 1; coarser < m_file->levels(); ++coarser) {
+            it = m_resident.find(key(coarser, TileFile::parent(coarser, tile, level)));
+            if (it != m_resident.end()) {
+                if (std::find(draw.begin(), draw.end(), it->second) == draw.end()) {
+                    draw.push_back(it->second);
+                }
+                break;
+            }
+        }
+    }
+    draw.insert(draw.end(), fine.begin(), fine.end());
+}
+
+bool TileCache::busy() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_queue.empty() || !m_loading.empty() || !m_loaded.empty() || !m_pending.empty();
+}
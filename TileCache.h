@@ -0,0 +1,79 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "Tiles.h"
+#include "VertexData.h"
+
+// Keeps the tiles around the view of a TileFile in a fixed number of GPU
+// slots. Worker threads read tiles and turn them into geometry; the window
+// thread uploads the results into the least recently used slot the view
+// does not need, so memory use is bounded by the pool whatever the size of
+// the trace.
+class TileCache {
+public:
+    // most tiles of one level in view; the level is picked accordingly
+    static constexpr size_t VIEW_TILES = 8;
+    // tiles loaded ahead of the view in the direction it last moved
+    static constexpr size_t PREFETCH = 4;
+    static constexpr size_t MAX_UPLOADS_PER_FRAME = 4;
+    static constexpr uint32_t NO_TILE_SLOT = UINT32_MAX;
+
+    // writes a tile's geometry to a slot; false if the slot cannot be
+    // written yet, e.g. because frames in flight still draw it. overwritten
+    // is set when the slot no longer holds its old tile.
+    using Upload = std::function<bool(uint32_t slot, const geometry_t & geometry, bool & overwritten)>;
+
+    ~TileCache() { stop(); }
+
+    // Tiles of more than max_records records keep their longest ones.
+    void start(const TileFile * file, size_t slots, size_t max_records, size_t threads);
+    void stop();
+
+    // Called every frame with the view [t0, t1): uploads what the workers
+    // have loaded, queues the missing tiles, nearest to the centre first,
+    // and lists the slots to draw. Tiles still loading are stood in for by
+    // the closest coarser tile already resident, drawn first.
+    void update(uint64_t t0, uint64_t t1, const Upload & upload, std::vector<uint32_t> & draw);
+    // true while tiles are queued, loading or waiting for a slot
+    bool busy();
+
+private:
+    struct Slot {
+        uint64_t key = UINT64_MAX;
+        uint64_t used = 0;
+    };
+    struct Loaded {
+        uint64_t key;
+        geometry_t geometry;
+    };
+
+    static uint64_t key(size_t level, size_t tile) { return (uint64_t) level << 32 | tile; }
+    void work();
+    uint32_t free_slot(const std::unordered_set<uint64_t> & wanted) const;
+
+    const TileFile * m_file = nullptr;
+    size_t m_max_records = 0;
+    std::vector<Slot> m_slots;
+    std::unordered_map<uint64_t, uint32_t> m_resident;
+    std::vector<Loaded> m_pending;      // loaded, waiting for a slot
+    uint64_t m_tick = 0;
+    uint64_t m_last_t0 = 0;
+    int m_direction = 0;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::deque<uint64_t> m_queue;
+    std::unordered_set<uint64_t> m_loading;
+    std::vector<Loaded> m_loaded;
+    std::vector<std::thread> m_threads;
+    bool m_stop = false;
+};
@@ -0,0 +1,711 @@
+#include "Tiles.h"
+#include "Counters.h"
+#include "Gaps.h"
+#include "Layout.h"
+#include "Longest.h"
+#include "RangeStats.h"
+#include "Search.h"
+#include "Trace.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+
+extern uint32_t push_task(std::vector<vertex_t> & vertices, std::vector<uint32_t> & indices_line, std::vector<uint32_t> & indices_tri,
+                          float start, float end, float y0, float y1, uint32_t name_index, uint32_t proc, uint32_t slot);
+extern bool stream_log(const char * filename, std::vector<std::string> & names, std::vector<CounterTrack> & counters,
+                       const std::function<bool(std::vector<Entry> &)> & sink);
+
+static const char TILE_MAGIC[8] = { 'P', 'V', 'T', 'I', 'L', 'E', 'S', '2' };
+
+// Followed by the tiles, written as they are built, and at index_offset
+// the names (length, bytes), the rows, the base tile bounds, the tile
+// directory of every level and the counter tracks (name length, name,
+// proc, sample count, times, values).
+struct TileHeader {
+    char magic[8];
+    uint32_t levels;
+    uint32_t pad;
+    uint64_t end_time;
+    uint64_t max_records;
+    uint64_t proc_count;
+    uint64_t name_count;
+    uint64_t row_count;
+    uint64_t base_tiles;
+    uint64_t index_offset;
+    uint64_t counter_count;
+};
+
+// tiles of each level, from the base tiles up to a single tile
+static std::vector<uint64_t> level_sizes(uint64_t base_tiles) {
+    std::vector<uint64_t> sizes(1, base_tiles);
+    while (sizes.back() > 1) {
+        sizes.push_back((sizes.back() + TileFile::FANOUT - 1) / TileFile::FANOUT);
+    }
+    return sizes;
+}
+
+static uint64_t base_tiles_per(size_t level) {
+    uint64_t count = 1;
+    for (size_t l = 0; l < level; ++l) {
+        count *= TileFile::FANOUT;
+    }
+    return count;
+}
+
+bool is_tile_file(const char * filename) {
+    std::ifstream in(filename, std::ios::binary);
+    char magic[sizeof(TILE_MAGIC)] = {};
+    in.read(magic, sizeof(magic));
+    return in && memcmp(magic, TILE_MAGIC, sizeof(magic)) == 0;
+}
+
+bool TileFile::open(const char * filename) {
+    std::ifstream in(filename, std::ios::binary);
+    TileHeader header;
+    if (!in.read((char *) &header, sizeof(header)) || memcmp(header.magic, TILE_MAGIC, sizeof(TILE_MAGIC)) != 0) {
+        std::cerr << filename << " is not a tile file" << std::endl;
+        return false;
+    }
+    m_filename = filename;
+    m_end_time = header.end_time;
+    m_max_records = header.max_records;
+    m_proc_count = header.proc_count;
+
+    in.seekg((std::streamoff) header.index_offset);
+    m_names.resize(header.name_count);
+    for (std::string & name : m_names) {
+        uint32_t length = 0;
+        in.read((char *) &length, sizeof(length));
+        name.resize(length);
+        in.read(name.data(), length);
+    }
+    m_rows.resize(header.row_count);
+    in.read((char *) m_rows.data(), m_rows.size() * sizeof(TileRow));
+    m_bounds.resize(header.base_tiles + 1);
+    in.read((char *) m_bounds.data(), m_bounds.size() * sizeof(uint64_t));
+
+    const std::vector<uint64_t> sizes = level_sizes(header.base_tiles);
+    if (sizes.size() != header.levels) {
+        std::cerr << "Corrupt tile file" << std::endl;
+        return false;
+    }
+    m_levels.resize(sizes.size());
+    for (size_t level = 0; level < sizes.size(); ++level) {
+        m_levels[level].resize(sizes[level]);
+        in.read((char *) m_levels[level].data(), sizes[level] * sizeof(Tile));
+    }
+    m_counter_count = header.counter_count;
+    m_counter_offset = (uint64_t) in.tellg();
+    if (!in) {
+        std::cerr << "Read failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+uint64_t TileFile::tile_start(size_t level, size_t tile) const {
+    const uint64_t base = std::min<uint64_t>(tile * base_tiles_per(level), m_bounds.size() - 1);
+    return m_bounds[base];
+}
+
+void TileFile::tiles_in(size_t level, uint64_t t0, uint64_t t1, size_t & first, size_t & last) const {
+    const size_t base_tiles = m_bounds.size() - 1;
+    // base tiles [first_base, last_base) intersect the range; tiles cut
+    // between tasks of the same start share a bound, and all of them count
+    const size_t first_base = std::lower_bound(m_bounds.begin() + 1, m_bounds.end(), t0) - (m_bounds.begin() + 1);
+    const size_t last_base = std::lower_bound(m_bounds.begin(), m_bounds.end(), t1) - m_bounds.begin();
+    const uint64_t per_tile = base_tiles_per(level);
+    first = (size_t) (std::min(first_base, base_tiles) / per_tile);
+    last = (size_t) std::min<uint64_t>((std::min(last_base, base_tiles) + per_tile - 1) / per_tile, tiles(level));
+    first = std::min(first, last);
+}
+
+size_t TileFile::parent(size_t level, size_t tile, size_t lower_level) {
+    return (size_t) (tile / base_tiles_per(level - lower_level));
+}
+
+bool TileFile::read_counters(std::vector<CounterTrack> & counters) const {
+    std::ifstream in(m_filename, std::ios::binary);
+    in.seekg((std::streamoff) m_counter_offset);
+    counters.resize(m_counter_count);
+    for (CounterTrack & track : counters) {
+        uint32_t length = 0;
+        uint64_t samples = 0;
+        in.read((char *) &length, sizeof(length));
+        track.name.resize(length);
+        in.read(track.name.data(), length);
+        in.read((char *) &track.proc, sizeof(track.proc));
+        in.read((char *) &samples, sizeof(samples));
+        if (!in) {
+            break;
+        }
+        track.times.resize(samples);
+        track.values.resize(samples);
+        in.read((char *) track.times.data(), samples * sizeof(uint64_t));
+        in.read((char *) track.values.data(), samples * sizeof(double));
+    }
+    if (!in) {
+        std::cerr << "Reading the counters failed" << std::endl;
+        counters.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TileFile::read_tile(std::ifstream & in, size_t level, size_t tile, std::vector<TileRecord> & records) const {
+    const Tile & entry = m_levels[level][tile];
+    records.resize(entry.count);
+    in.clear();
+    in.seekg((std::streamoff) entry.offset);
+    return (bool) in.read((char *) records.data(), entry.count * sizeof(TileRecord));
+}
+
+// Conversion. The log is read a piece at a time and its tasks are sorted
+// on disk twice: by thread, to number the processes and threads and to
+// assign depths as build_trace() does, then by start, to cut the tiles.
+// Memory use is bounded by the sort runs, not by the size of the log.
+
+// A task between the two sorts, with the reader's proc and thread.
+struct SpillTask {
+    uint64_t proc;
+    uint64_t thread;
+    uint64_t start;
+    uint64_t length;
+    uint32_t name_index;
+    uint32_t pad;
+};
+
+struct ByThread {
+    bool operator()(const SpillTask & a, const SpillTask & b) const {
+        if (a.proc != b.proc) {
+            return a.proc < b.proc;
+        }
+        if (a.thread != b.thread) {
+            return a.thread < b.thread;
+        }
+        if (a.start != b.start) {
+            return a.start < b.start;
+        }
+        // enclosing scope before the scopes nested in it
+        return a.length > b.length;
+    }
+};
+
+struct ByStart {
+    bool operator()(const TileRecord & a, const TileRecord & b) const {
+        return a.start != b.start ? a.start < b.start : a.row < b.row;
+    }
+};
+
+// Sorts on all threads: pieces first, then neighbouring pieces merged in
+// rounds.
+template <class Record, class Less>
+static void parallel_sort(std::vector<Record> & records, Less less) {
+    const size_t PIECES = 16;
+    std::vector<size_t> bounds(PIECES + 1);
+    for (size_t i = 0; i <= PIECES; ++i) {
+        bounds[i] = records.size() * i / PIECES;
+    }
+    parallel_for(0, PIECES, [&](size_t i) {
+        std::sort(records.begin() + bounds[i], records.begin() + bounds[i + 1], less);
+    });
+    for (size_t width = 1; width < PIECES; width *= 2) {
+        parallel_for(0, (PIECES + 2 * width - 1) / (2 * width), [&](size_t i) {
+            const size_t middle = std::min((2 * i + 1) * width, PIECES);
+            const size_t end = std::min((2 * i + 2) * width, PIECES);
+            std::inplace_merge(records.begin() + bounds[2 * i * width], records.begin() + bounds[middle], records.begin() + bounds[end], less);
+        });
+    }
+}
+
+// Sorts more records than fit in memory: a run of them at a time is sorted
+// and spilled to a temporary file, and the runs are merged back in order.
+template <class Record, class Less>
+class RunSorter {
+public:
+    // runs merged at once, and records read ahead of each
+    static constexpr size_t FAN_IN = 128;
+    static constexpr size_t READ_AHEAD = 1 << 15;
+
+    RunSorter(const std::string & prefix, size_t run_records) : m_prefix(prefix), m_run_records(run_records) {}
+    ~RunSorter() {
+        for (const std::string & run : m_runs) {
+            std::remove(run.c_str());
+        }
+    }
+
+    bool add(const Record & record) {
+        if (m_buffer.empty()) {
+            m_buffer.reserve(m_run_records);
+        }
+        m_buffer.push_back(record);
+        return m_buffer.size() < m_run_records || spill();
+    }
+
+    // Calls out(record), which returns false to stop, for every record in
+    // order.
+    bool merge(const std::function<bool(const Record &)> & out) {
+        if (m_runs.empty()) {
+            parallel_sort(m_buffer, Less());
+            for (const Record & record : m_buffer) {
+                if (!out(record)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+        if (!m_buffer.empty() && !spill()) {
+            return false;
+        }
+        m_buffer = std::vector<Record>();
+
+        // more runs than can be open at once are merged into longer ones
+        while (m_runs.size() > FAN_IN) {
+            const std::vector<std::string> runs(m_runs.begin(), m_runs.begin() + FAN_IN);
+            m_runs.erase(m_runs.begin(), m_runs.begin() + FAN_IN);
+            m_runs.push_back(run_name());
+            std::ofstream file(m_runs.back(), std::ios::binary);
+            std::vector<Record> block;
+            block.reserve(READ_AHEAD);
+            auto flush = [&]() {
+                file.write((const char *) block.data(), block.size() * sizeof(Record));
+                block.clear();
+                return (bool) file;
+            };
+            const bool ok = merge_runs(runs, [&](const Record & record) {
+                block.push_back(record);
+                return block.size() < READ_AHEAD || flush();
+            }) && flush();
+            for (const std::string & run : runs) {
+                std::remove(run.c_str());
+            }
+            if (!ok) {
+                std::cerr << "Cannot write " << m_runs.back() << std::endl;
+                return false;
+            }
+        }
+        return merge_runs(m_runs, out);
+    }
+
+private:
+    std::string run_name() {
+        return m_prefix + std::to_string(m_next_run++);
+    }
+
+    bool spill() {
+        parallel_sort(m_buffer, Less());
+        m_runs.push_back(run_name());
+        std::ofstream file(m_runs.back(), std::ios::binary);
+        file.write((const char *) m_buffer.data(), m_buffer.size() * sizeof(Record));
+        m_buffer.clear();
+        if (!file) {
+            std::cerr << "Cannot write " << m_runs.back() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool merge_runs(const std::vector<std::string> & runs, const std::function<bool(const Record &)> & out) {
+        struct Cursor {
+            std::ifstream in;
+            std::vector<Record> records;
+            size_t pos = 0;
+        };
+        auto refill = [](Cursor & cursor) {
+            cursor.records.resize(READ_AHEAD);
+            cursor.in.read((char *) cursor.records.data(), READ_AHEAD * sizeof(Record));
+            cursor.records.resize((size_t) cursor.in.gcount() / sizeof(Record));
+            cursor.pos = 0;
+            return !cursor.records.empty();
+        };
+        std::vector<Cursor> cursors(runs.size());
+        // a heap of the cursors by their next record, smallest on top
+        const Less less;
+        auto later = [&](size_t a, size_t b) {
+            return less(cursors[b].records[cursors[b].pos], cursors[a].records[cursors[a].pos]);
+        };
+        std::vector<size_t> heap;
+        for (size_t i = 0; i < runs.size(); ++i) {
+            cursors[i].in.open(runs[i], std::ios::binary);
+            if (!cursors[i].in) {
+                std::cerr << "Cannot read " << runs[i] << std::endl;
+                return false;
+            }
+            if (refill(cursors[i])) {
+                heap.push_back(i);
+            }
+        }
+        std::make_heap(heap.begin(), heap.end(), later);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            Cursor & cursor = cursors[heap.back()];
+            if (!out(cursor.records[cursor.pos])) {
+                return false;
+            }
+            if (++cursor.pos == cursor.records.size() && !refill(cursor)) {
+                if (cursor.in.bad()) {
+                    std::cerr << "Read failed" << std::endl;
+                    return false;
+                }
+                heap.pop_back();
+                continue;
+            }
+            std::push_heap(heap.begin(), heap.end(), later);
+        }
+        return true;
+    }
+
+    std::string m_prefix;
+    size_t m_run_records;
+    size_t m_next_run = 0;
+    std::vector<Record> m_buffer;
+    std::vector<std::string> m_runs;
+};
+
+// Spans of a higher level from the records of the tiles below, sorted by
+// row and start: records closer than merge_gap merged, named after their
+// longest, clipped to [t0, t1) unless the tile has no width.
+static void merge_spans(const std::vector<TileRecord> & sorted, uint64_t t0, uint64_t t1, uint64_t merge_gap, std::vector<TileRecord> & spans) {
+    uint64_t start = 0;
+    uint64_t end = 0;
+    uint64_t longest = 0;
+    uint32_t name_index = 0;
+    auto flush = [&](uint32_t row) {
+        const uint64_t clipped = t1 > t0 ? std::min(end, t1) : end;
+        spans.push_back({ start, clipped > start ? clipped - start : 0, row, name_index });
+    };
+    for (size_t i = 0; i < sorted.size(); ++i) {
+        const TileRecord & r = sorted[i];
+        if (i > 0 && r.row == sorted[i - 1].row && r.start <= end + merge_gap) {
+            end = std::max(end, r.start + r.length);
+        } else {
+            if (i > 0) {
+                flush(sorted[i - 1].row);
+            }
+            start = std::max(r.start, t0);
+            end = r.start + r.length;
+            longest = 0;
+        }
+        if (r.length >= longest) {
+            longest = r.length;
+            name_index = r.name_index;
+        }
+    }
+    if (!sorted.empty()) {
+        flush(sorted.back().row);
+    }
+}
+
+// Writes the tiles as the records arrive by start: a tile of level 0 gets
+// TILE_TASKS starts, also when several tiles' worth share one time, plus
+// the tasks of earlier tiles still running. Every FANOUT tiles of a level
+// are merged into one of the level above as soon as they are complete, so
+// only a few tiles of each level are held.
+class TileWriter {
+public:
+    struct Tile {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    TileWriter(std::ofstream & out, uint64_t offset) : m_out(out), m_offset(offset) {}
+
+    bool add(const TileRecord & record) {
+        if (m_starts == TileFile::TILE_TASKS && !close_base_tile(record.start)) {
+            return false;
+        }
+        m_records.push_back(record);
+        ++m_starts;
+        return true;
+    }
+
+    // The last tiles, with end_time the end of the last task.
+    bool finish(uint64_t end_time) {
+        // exclusive, so that tasks ending last are inside
+        const uint64_t end = std::max(end_time, m_bounds.back()) + 1;
+        if (!close_base_tile(end)) {
+            return false;
+        }
+        for (size_t level = 0; m_levels[level].size() > 1; ++level) {
+            if (!m_children[level].empty() && !merge_children(level, end)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint64_t offset() const { return m_offset; }
+    uint64_t max_records() const { return m_max_records; }
+    const std::vector<uint64_t> & bounds() const { return m_bounds; }
+    const std::vector< std::vector<Tile> > & levels() const { return m_levels; }
+
+private:
+    bool close_base_tile(uint64_t next_bound) {
+        m_bounds.push_back(next_bound);
+        std::vector<TileRecord> carried;
+        for (const TileRecord & record : m_records) {
+            if (record.start + record.length > next_bound) {
+                carried.push_back(record);
+            }
+        }
+        std::vector<TileRecord> records;
+        records.swap(m_records);
+        m_records.swap(carried);
+        m_starts = 0;
+        return write(0, std::move(records), next_bound);
+    }
+
+    bool write(size_t level, std::vector<TileRecord> && records, uint64_t next_bound) {
+        if (level == m_levels.size()) {
+            m_levels.emplace_back();
+            m_children.emplace_back();
+        }
+        m_levels[level].push_back({ m_offset, records.size() });
+        m_out.write((const char *) records.data(), records.size() * sizeof(TileRecord));
+        if (!m_out) {
+            std::cerr << "Write failed" << std::endl;
+            return false;
+        }
+        m_offset += records.size() * sizeof(TileRecord);
+        m_max_records = std::max<uint64_t>(m_max_records, records.size());
+        m_children[level].push_back(std::move(records));
+        return m_children[level].size() < TileFile::FANOUT || merge_children(level, next_bound);
+    }
+
+    // Fewer, wider bins while the spans would not fit a tile of level 0.
+    bool merge_children(size_t level, uint64_t next_bound) {
+        const size_t parent = level + 1 < m_levels.size() ? m_levels[level + 1].size() : 0;
+        const uint64_t t0 = m_bounds[parent * base_tiles_per(level + 1)];
+        const uint64_t t1 = next_bound;
+        std::vector<TileRecord> sorted;
+        for (const std::vector<TileRecord> & child : m_children[level]) {
+            sorted.insert(sorted.end(), child.begin(), child.end());
+        }
+        m_children[level].clear();
+        std::sort(sorted.begin(), sorted.end(), [](const TileRecord & a, const TileRecord & b) {
+            return a.row != b.row ? a.row < b.row : a.start < b.start;
+        });
+        std::vector<TileRecord> spans;
+        for (uint32_t bins = TileFile::LOD_BINS; ; bins /= 2) {
+            spans.clear();
+            merge_spans(sorted, t0, t1, (t1 - t0) / bins, spans);
+            if (spans.size() <= TileFile::TILE_TASKS || bins == 1) {
+                break;
+            }
+        }
+        return write(level + 1, std::move(spans), next_bound);
+    }
+
+    std::ofstream & m_out;
+    uint64_t m_offset;
+    uint64_t m_max_records = 0;
+    // the bound of every base tile so far and of the one being filled
+    std::vector<uint64_t> m_bounds = std::vector<uint64_t>(1, 0);
+    std::vector< std::vector<Tile> > m_levels;
+    // per level, the tiles not yet merged into the level above
+    std::vector< std::vector< std::vector<TileRecord> > > m_children;
+    // the base tile being filled and how many of its records start in it
+    std::vector<TileRecord> m_records;
+    uint64_t m_starts = 0;
+};
+
+bool convert_tiles(const char * input, const char * output) {
+    // runs of about 1.3 and 0.8 GB
+    const size_t THREAD_RUN = 1 << 25;
+    const size_t START_RUN = 1 << 25;
+
+    std::ofstream out(output, std::ios::binary);
+    if (!out) {
+        std::cerr << "Cannot write " << output << std::endl;
+        return false;
+    }
+    const std::string temp = std::string(output) + ".run";
+
+    // read, spilling runs by thread; the first start of every process, to
+    // start its time at 0 as build_trace() does
+    std::vector<std::string> names;
+    std::vector<CounterTrack> counters;
+    std::map<uint64_t, uint64_t> proc_start;
+    RunSorter<SpillTask, ByThread> by_thread(temp + "t", THREAD_RUN);
+    uint64_t task_count = 0;
+    bool ok = stream_log(input, names, counters, [&](std::vector<Entry> & tasks) {
+        for (const Entry & e : tasks) {
+            auto it = proc_start.emplace(e.proc, e.start).first;
+            it->second = std::min(it->second, e.start);
+            if (!by_thread.add({ e.proc, e.thread, e.start, e.length, e.name_index, 0 })) {
+                return false;
+            }
+        }
+        task_count += tasks.size();
+        std::cout << "read " << task_count << " tasks" << std::endl;
+        return true;
+    });
+    if (!ok) {
+        return false;
+    }
+    if (task_count == 0) {
+        std::cerr << "Empty log" << std::endl;
+        return false;
+    }
+
+    // dense processes and threads and one row per depth of a thread, in
+    // the order generate_triangles() has them
+    std::vector<TileRow> rows;
+    RunSorter<TileRecord, ByStart> by_start(temp + "s", START_RUN);
+    uint64_t end_time = 0;
+    // the reader's ids of the current thread and the dense ones
+    uint64_t proc = 0;
+    uint64_t thread = 0;
+    uint64_t dense_proc = 0;
+    uint64_t dense_thread = 0;
+    uint64_t origin = 0;
+    size_t first_row = 0;
+    std::vector<uint64_t> open_ends;
+    ok = by_thread.merge([&](const SpillTask & task) {
+        if (rows.empty() || task.proc != proc || task.thread != thread) {
+            if (rows.empty()) {
+                origin = proc_start[task.proc];
+            } else if (task.proc != proc) {
+                origin = proc_start[task.proc];
+                ++dense_proc;
+                dense_thread = 0;
+            } else {
+                ++dense_thread;
+            }
+            proc = task.proc;
+            thread = task.thread;
+            first_row = rows.size();
+            open_ends.clear();
+        }
+        // as assign_depths() does
+        while (!open_ends.empty() && open_ends.back() <= task.start) {
+            open_ends.pop_back();
+        }
+        const uint32_t depth = (uint32_t) open_ends.size();
+        open_ends.push_back(task.start + task.length);
+        if (first_row + depth == rows.size()) {
+            rows.push_back({ dense_proc, dense_thread, depth, 0 });
+        }
+        const TileRecord record{ task.start - origin, task.length, (uint32_t) (first_row + depth), task.name_index };
+        end_time = std::max(end_time, record.start + record.length);
+        return by_start.add(record);
+    });
+    if (!ok) {
+        return false;
+    }
+    std::cout << rows.size() << " rows" << std::endl;
+
+    // counters of processes without tasks have no place to go, the others
+    // get the dense process and its time base
+    std::map<uint64_t, uint64_t> proc_ids;
+    for (const auto & start : proc_start) {
+        proc_ids.emplace(start.first, proc_ids.size());
+    }
+    counters.erase(std::remove_if(counters.begin(), counters.end(), [&proc_ids](const CounterTrack & track) {
+        return proc_ids.find(track.proc) == proc_ids.end();
+    }), counters.end());
+    for (CounterTrack & track : counters) {
+        const uint64_t start = proc_start[track.proc];
+        track.proc = proc_ids[track.proc];
+        for (uint64_t & time : track.times) {
+            time = time > start ? time - start : 0;
+        }
+    }
+
+    TileHeader header{};
+    memcpy(header.magic, TILE_MAGIC, sizeof(TILE_MAGIC));
+    out.write((const char *) &header, sizeof(header));
+    TileWriter writer(out, sizeof(header));
+    ok = by_start.merge([&](const TileRecord & record) {
+        return writer.add(record);
+    }) && writer.finish(end_time);
+    if (!ok) {
+        return false;
+    }
+    for (size_t level = 0; level < writer.levels().size(); ++level) {
+        std::cout << "level " << level << ": " << writer.levels()[level].size() << " tiles" << std::endl;
+    }
+
+    header.levels = (uint32_t) writer.levels().size();
+    header.end_time = end_time;
+    header.max_records = writer.max_records();
+    header.proc_count = proc_start.size();
+    header.name_count = names.size();
+    header.row_count = rows.size();
+    header.base_tiles = writer.bounds().size() - 1;
+    header.index_offset = writer.offset();
+    header.counter_count = counters.size();
+    for (const std::string & name : names) {
+        const uint32_t length = (uint32_t) name.size();
+        out.write((const char *) &length, sizeof(length));
+        out.write(name.data(), length);
+    }
+    out.write((const char *) rows.data(), rows.size() * sizeof(TileRow));
+    out.write((const char *) writer.bounds().data(), writer.bounds().size() * sizeof(uint64_t));
+    for (const std::vector<TileWriter::Tile> & tiles : writer.levels()) {
+        out.write((const char *) tiles.data(), tiles.size() * sizeof(TileWriter::Tile));
+    }
+    for (const CounterTrack & track : counters) {
+        const uint32_t length = (uint32_t) track.name.size();
+        const uint64_t samples = track.times.size();
+        out.write((const char *) &length, sizeof(length));
+        out.write(track.name.data(), length);
+        out.write((const char *) &track.proc, sizeof(track.proc));
+        out.write((const char *) &samples, sizeof(samples));
+        out.write((const char *) track.times.data(), samples * sizeof(uint64_t));
+        out.write((const char *) track.values.data(), samples * sizeof(double));
+    }
+    out.seekp(0);
+    out.write((const char *) &header, sizeof(header));
+    out.close();
+    if (!out) {
+        std::cerr << "Write failed" << std::endl;
+        return false;
+    }
+    return true;
+}
+void load_tile_layout(const TileFile & file) {
+    g_names = file.names();
+    g_tasksperproc.assign(file.proc_count(), std::vector< std::vector<Entry *> >());
+    rowdata.clear();
+    rowdepth.clear();
+    for (const TileRow & row : file.rows()) {
+        rowdata.push_back(std::make_pair(row.proc, row.thread));
+        rowdepth.push_back(row.depth);
+        // threads without tasks in memory, so that they are counted
+        if (row.proc < g_tasksperproc.size() && row.thread >= g_tasksperproc[row.proc].size()) {
+            g_tasksperproc[row.proc].resize(row.thread + 1);
+        }
+    }
+    rowpos.assign(rowdata.size(), 0.0f);
+    g_rowtasks.assign(rowdata.size(), std::vector<Entry *>());
+    g_name_tasks.assign(g_names.size(), std::vector<TaskRef>());
+    g_slot_tasks.clear();
+    file.read_counters(g_counters);
+    build_counter_pyramids();
+    g_thread_gaps.clear();
+    g_longest.clear();
+    g_longest_by_name.assign(g_names.size(), std::vector<TaskRef>());
+    g_collapsed.assign(g_tasksperproc.size(), 0);
+    update_layout();
+    build_range_index();
+}
+
+void tile_geometry(const TileFile & file, const std::vector<TileRecord> & records, geometry_t & geometry) {
+    // y is relative to the row's centre line, as in generate_triangles()
+    const float barheight = 0.8f;
+    const std::vector<TileRow> & rows = file.rows();
+    geometry.vertices.reserve(3 * records.size());
+    geometry.indices_line.reserve(6 * records.size());
+    geometry.indices_tri.reserve(3 * records.size());
+    for (const TileRecord & record : records) {
+        push_task(geometry.vertices, geometry.indices_line, geometry.indices_tri,
+                  1e-3f * (float) record.start, 1e-3f * (float) (record.start + record.length),
+                  -barheight / 2.0f, barheight / 2.0f, record.name_index, (uint32_t) rows[record.row].proc, record.row);
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Counters.h"
+#include "VertexData.h"
+
+// Time-tiled trace on disk, for traces that fit neither in memory nor on
+// the GPU. Level 0 cuts the trace into tiles of about TILE_TASKS tasks
+// each and stores every task with the tiles it intersects. Each higher
+// level groups FANOUT tiles of the level below and stores, instead of the
+// tasks, per row the spans left after merging tasks closer than
+// 1/LOD_BINS of the tile, or coarser if that leaves more than TILE_TASKS
+// spans, so any tile is small enough for one slot of the viewer's buffer
+// pool. Only the header, the names, the rows, the tile directory and the
+// counter tracks are kept in memory; tiles are read on demand.
+
+// A task of level 0 or a merged span of a higher level; row is an index
+// into TileFile::rows().
+struct TileRecord {
+    uint64_t start;
+    uint64_t length;
+    uint32_t row;
+    uint32_t name_index;
+};
+
+struct TileRow {
+    uint64_t proc;
+    uint64_t thread;
+    uint32_t depth;
+    uint32_t pad;
+};
+
+class TileFile {
+public:
+    static constexpr uint64_t TILE_TASKS = 1 << 16;
+    static constexpr uint32_t FANOUT = 8;
+    static constexpr uint32_t LOD_BINS = 256;
+
+    // Reads everything but the tiles; false if the file is not a tile file.
+    bool open(const char * filename);
+    const std::string & filename() const { return m_filename; }
+
+    size_t levels() const { return m_levels.size(); }
+    size_t tiles(size_t level) const { return m_levels[level].size(); }
+    // tile i of level covers [tile_start(level, i), tile_start(level, i + 1))
+    uint64_t tile_start(size_t level, size_t tile) const;
+    // tiles [first, last) of level intersect [t0, t1)
+    void tiles_in(size_t level, uint64_t t0, uint64_t t1, size_t & first, size_t & last) const;
+    // the tile of level that covers tile `tile` of a lower level
+    static size_t parent(size_t level, size_t tile, size_t lower_level);
+    uint64_t end_time() const { return m_end_time; }
+    // the most records any tile holds, to size the buffer pool
+    uint64_t max_records() const { return m_max_records; }
+    uint64_t proc_count() const { return m_proc_count; }
+    const std::vector<std::string> & names() const { return m_names; }
+    const std::vector<TileRow> & rows() const { return m_rows; }
+    // The counter tracks with dense processes and times, as build_trace()
+    // leaves them. Read on request, as the caller keeps them.
+    bool read_counters(std::vector<CounterTrack> & counters) const;
+
+    // Reads a tile through a stream of the caller's, so readers on
+    // different threads do not share a file position.
+    bool read_tile(std::ifstream & in, size_t level, size_t tile, std::vector<TileRecord> & records) const;
+
+private:
+    struct Tile {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    std::string m_filename;
+    uint64_t m_end_time = 0;
+    uint64_t m_max_records = 0;
+    uint64_t m_proc_count = 0;
+    uint64_t m_counter_count = 0;
+    uint64_t m_counter_offset = 0;
+    std::vector<std::string> m_names;
+    std::vector<TileRow> m_rows;
+    // base tile boundaries, one more than the level 0 tiles
+    std::vector<uint64_t> m_bounds;
+    std::vector< std::vector<Tile> > m_levels;
+};
+
+// true if the file starts like a tile file
+bool is_tile_file(const char * filename);
+
+// Converts a log to a tile file without loading it: the tasks are sorted
+// on disk next to output and the tiles written as the sorted tasks come
+// in, so memory use does not grow with the log.
+bool convert_tiles(const char * input, const char * output);
+
+// Fills the row tables of Trace.h from the file, without tasks, and
+// g_counters, so that the layout works as for a loaded trace.
+void load_tile_layout(const TileFile & file);
+
+// Geometry of a tile's records, laid out like generate_triangles() does.
+void tile_geometry(const TileFile & file, const std::vector<TileRecord> & records, geometry_t & geometry);
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// One task of the trace. proc and thread are dense indices into
+// g_tasksperproc once parsing has finished; depth is the number of tasks
+// of the same thread still open when it starts; vert_index is the first of
+// the task's three vertices, 0 until the geometry is generated.
+struct Entry {
+    uint64_t proc = 0;
+    uint64_t thread = 0;
+    uint64_t start = 0;
+    uint64_t length = 0;
+    uint32_t name_index = 0;
+    uint32_t vert_index = 0;
+    uint32_t depth = 0;
+};
+
+// Defined in Parse.cpp.
+extern std::vector<Entry> g_alltasks;
+// all tasks of each thread, by start time; nested tasks overlap
+extern std::vector< std::vector< std::vector< Entry * > > > g_tasksperproc;
+extern std::vector<std::string> g_names;
+// One row per depth of each thread, top to bottom: centre line,
+// (proc, thread), depth and the row's tasks by start time. The tasks of a
+// row never overlap.
+extern std::vector< float > rowpos;
+extern std::vector< std::pair< uint64_t, uint64_t > > rowdata;
+extern std::vector< uint32_t > rowdepth;
+extern std::vector< std::vector< Entry * > > g_rowtasks;
+
+std::string format(uint64_t a);
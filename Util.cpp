@@ -1,5 +1,9 @@
 #include "Util.h"
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <stdexcept>
+#include <thread>
 
 std::vector<uint8_t> read_binary_file(const std::string & filename, const uint32_t count) {
     std::ifstream file;
@@ -23,3 +27,26 @@ std::vector<uint8_t> read_binary_file(const std::string & filename, const uint32
 
     return data;
 }
+
+void parallel_for(size_t begin, size_t end, const std::function<void(size_t)> & body) {
+    if (begin >= end) {
+        return;
+    }
+    std::atomic<size_t> next = begin;
+    auto worker = [&]() {
+        for (size_t i = next++; i < end; i = next++) {
+            body(i);
+        }
+    };
+
+    const size_t count = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), end - begin);
+    std::vector<std::thread> threads;
+    threads.reserve(count - 1);
+    for (size_t i = 1; i < count; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread & thread : threads) {
+        thread.join();
+    }
+}
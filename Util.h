@@ -1,6 +1,13 @@
 #pragma once
 
+#include <cstdint>
 #include <vector>
 #include <string>
+#include <functional>
 
 std::vector<uint8_t> read_binary_file(const std::string & filename, const uint32_t count);
+
+// Calls body(i) for every i in [begin, end) on all hardware threads and
+// returns when all calls have finished. Items are handed out one at a
+// time, so uneven items balance out.
+void parallel_for(size_t begin, size_t end, const std::function<void(size_t)> & body);
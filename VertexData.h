@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <vector>
+
 struct pos_t { 
     float x;
     float y;
@@ -11,7 +14,34 @@ struct color_t {
     float b;
 };
 
+// Colours come from the palette in the vertex shader, looked up by name
+// or by process, so recolouring never touches the geometry. y is relative
+// to the layout slot's offset, see Layout.h.
 struct vertex_t {
     pos_t pos;
-    color_t color;
+    uint32_t name_index;
+    uint32_t proc;
+    uint32_t slot;
+};
+
+struct geometry_t {
+    std::vector<vertex_t> vertices;
+    std::vector<uint32_t> indices_line;
+    std::vector<uint32_t> indices_tri;
+};
+
+// Idle gap highlighted on a layout slot, drawn as one instanced quad.
+struct gap_t {
+    float x0;
+    float x1;
+    uint32_t slot;
+    uint32_t pad;
+};
+
+// Point of a counter track's line graph; consecutive points of the same
+// slot are joined.
+struct counter_point_t {
+    pos_t pos;
+    uint32_t slot;
+    uint32_t pad;
 };
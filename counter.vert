@@ -0,0 +1,53 @@
+#version 460
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 a;
+    int i;
+    uint highlight_count;
+    uint palette_count;
+    uint palette_mode;
+    uint slot_count;
+    uint minimap_width;
+    uint minimap_height;
+    vec4 minimap_view;
+    uint heat_index_offset;
+    uint heat_task_count;
+    uint heat_columns;
+    uint heat_bins;
+    float heat_rows_per_bin;
+} ubo;
+
+// y of every layout slot, NaN if the slot is hidden
+layout(binding = 3) readonly buffer SlotBuffer {
+    float y[];
+} slots;
+
+struct CounterPoint {
+    vec2 pos;
+    uint slot;
+    uint pad;
+};
+
+layout(binding = 9) readonly buffer CounterBuffer {
+    CounterPoint points[];
+} counter_data;
+
+layout(location = 0) out vec3 fragColor;
+
+// Line list over the point list: vertex v is an end of segment v / 2, which
+// joins points v / 2 and v / 2 + 1. Segments between two tracks and those
+// of hidden tracks are moved off screen.
+void main() {
+    uint segment = gl_VertexIndex / 2;
+    CounterPoint a = counter_data.points[segment];
+    CounterPoint b = counter_data.points[segment + 1];
+    CounterPoint point = (gl_VertexIndex & 1) == 0 ? a : b;
+    float offset = point.slot < ubo.slot_count ? slots.y[point.slot] : 0.0;
+    if (a.slot != b.slot || isnan(offset)) {
+        gl_Position = vec4(-2.0, -2.0, 0.0, 1.0);
+        fragColor = vec3(0.0);
+        return;
+    }
+    gl_Position = ubo.a * vec4(point.pos.x, offset + point.pos.y, 0.0, 1.0);
+    fragColor = vec3(0.1, 0.2, 0.6);
+}
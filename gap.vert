@@ -0,0 +1,54 @@
+#version 460
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 a;
+    int i;
+    uint highlight_count;
+    uint palette_count;
+    uint palette_mode;
+    uint slot_count;
+    uint minimap_width;
+    uint minimap_height;
+    vec4 minimap_view;
+    uint heat_index_offset;
+    uint heat_task_count;
+    uint heat_columns;
+    uint heat_bins;
+    float heat_rows_per_bin;
+} ubo;
+
+// y of every layout slot, NaN if the slot is hidden
+layout(binding = 3) readonly buffer SlotBuffer {
+    float y[];
+} slots;
+
+struct Gap {
+    float x0;
+    float x1;
+    uint slot;
+    uint pad;
+};
+
+layout(binding = 8) readonly buffer GapBuffer {
+    Gap gaps[];
+} gap_data;
+
+layout(location = 0) out vec3 fragColor;
+
+// one quad per instance, spanning the gap on its row
+void main() {
+    const vec2 corners[6] = vec2[](
+        vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+        vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+    Gap gap = gap_data.gaps[gl_InstanceIndex];
+    float offset = gap.slot < ubo.slot_count ? slots.y[gap.slot] : 0.0;
+    if (isnan(offset)) {
+        gl_Position = vec4(-2.0, -2.0, 0.0, 1.0);
+        fragColor = vec3(0.0);
+        return;
+    }
+    vec2 corner = corners[gl_VertexIndex];
+    vec2 p = vec2(mix(gap.x0, gap.x1, corner.x), offset - 0.45 + 0.9 * corner.y);
+    gl_Position = ubo.a * vec4(p, 0.0, 1.0);
+    fragColor = vec3(1.0, 0.8, 0.8);
+}
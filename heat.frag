@@ -0,0 +1,39 @@
+#version 460
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 a;
+    int i;
+    uint highlight_count;
+    uint palette_count;
+    uint palette_mode;
+    uint slot_count;
+    uint minimap_width;
+    uint minimap_height;
+    vec4 minimap_view;
+    uint heat_index_offset;     // first triangle index, in words
+    uint heat_task_count;
+    uint heat_columns;
+    uint heat_bins;
+    float heat_rows_per_bin;
+} ubo;
+
+layout(binding = 7) readonly buffer HeatBuffer {
+    int values[];
+} heat;
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 out_color;
+
+// Busy fraction of the rows falling into the pixel, on a light to dark
+// ramp; empty pixels keep the background.
+void main() {
+    uvec2 size = uvec2(ubo.heat_columns, ubo.heat_bins);
+    uvec2 cell = min(uvec2(uv * vec2(size)), size - 1u);
+    int value = heat.values[cell.y * size.x + cell.x];
+    if (value <= 0) {
+        discard;
+    }
+    float busy = float(value) / 256.0 / max(ubo.heat_rows_per_bin, 1.0);
+    float t = sqrt(clamp(busy, 0.0, 1.0));
+    out_color = vec4(mix(vec3(1.0, 0.85, 0.5), vec3(0.5, 0.0, 0.0), t), 1.0);
+}
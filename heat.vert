@@ -0,0 +1,12 @@
+#version 460
+
+layout(location = 0) out vec2 uv;
+
+// the whole window, two triangles made from the vertex index
+void main() {
+    const vec2 corners[6] = vec2[](
+        vec2(0.0, 0.0), vec2(1.0, 0.0), vec2(0.0, 1.0),
+        vec2(1.0, 0.0), vec2(1.0, 1.0), vec2(0.0, 1.0));
+    uv = corners[gl_VertexIndex];
+    gl_Position = vec4(-1.0 + 2.0 * uv, 0.0, 1.0);
+}
@@ -0,0 +1,46 @@
+#version 460
+
+layout(binding = 0) uniform UniformBufferObject {
+    mat4 a;
+    int i;
+    uint highlight_count;
+    uint palette_count;
+    uint palette_mode;
+    uint slot_count;
+    uint minimap_width;
+    uint minimap_height;
+    vec4 minimap_view;      // u0, v0, u1, v1
+    uint heat_index_offset;
+    uint heat_task_count;
+    uint heat_columns;
+    uint heat_bins;
+    float heat_rows_per_bin;
+} ubo;
+
+// busy fraction per texel, row-major
+layout(binding = 4) readonly buffer MinimapBuffer {
+    float coverage[];
+} minimap;
+
+layout(location = 0) in vec2 uv;
+layout(location = 0) out vec4 out_color;
+
+void main() {
+    float c = 0.0;
+    if (ubo.minimap_width != 0u && ubo.minimap_height != 0u) {
+        uvec2 size = uvec2(ubo.minimap_width, ubo.minimap_height);
+        uvec2 texel = min(uvec2(uv * vec2(size)), size - 1u);
+        c = minimap.coverage[texel.y * size.x + texel.x];
+    }
+    vec3 color = mix(vec3(0.1), vec3(0.3, 0.6, 1.0), c);
+
+    // outline of the view, about one pixel wide
+    vec2 px = fwidth(uv);
+    vec4 r = ubo.minimap_view;
+    bool outer = all(greaterThanEqual(uv, r.xy - px)) && all(lessThanEqual(uv, r.zw + px));
+    bool inner = all(greaterThan(uv, r.xy + px)) && all(lessThan(uv, r.zw - px));
+    if (outer && !inner) {
+        color = vec3(1.0, 0.9, 0.2);
+    }
+    out_color = vec4(color, 1.0);
+}
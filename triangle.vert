@@ -3,19 +3,67 @@
 layout(binding = 0) uniform UniformBufferObject {
     mat4 a;
     int i;
+    uint highlight_count;
+    uint palette_count;
+    uint palette_mode;      // 0: by name, 1: by process
+    uint slot_count;
+    uint minimap_width;
+    uint minimap_height;
+    vec4 minimap_view;      // u0, v0, u1, v1
+    uint heat_index_offset;
+    uint heat_task_count;
+    uint heat_columns;
+    uint heat_bins;
+    float heat_rows_per_bin;
 } ubo;
 
+// one bit per task, three vertices per task
+layout(binding = 1) readonly buffer HighlightBuffer {
+    uint bits[];
+} highlight;
+
+layout(binding = 2) readonly buffer PaletteBuffer {
+    vec4 colors[];
+} palette;
+
+// y of every layout slot, NaN if the slot is hidden
+layout(binding = 3) readonly buffer SlotBuffer {
+    float y[];
+} slots;
+
 layout(location = 0) in vec2 pos;
-layout(location = 1) in vec3 color;
+layout(location = 1) in uint name_index;
+layout(location = 2) in uint proc;
+layout(location = 3) in uint slot;
 
 layout(location = 0) out vec3 fragColor;
 
 void main() {
+    uint task = uint(gl_VertexIndex) / 3u;
+    vec2 p = pos;
+    // preview vertices have no slot and are placed as they are
+    if (slot < ubo.slot_count) {
+        float offset = slots.y[slot];
+        if (isnan(offset)) {
+            // all three vertices on one point outside the view
+            gl_Position = vec4(-2.0, -2.0, 0.0, 1.0);
+            fragColor = vec3(0.0);
+            return;
+        }
+        p.y += offset;
+    }
+    gl_Position = ubo.a * vec4(p, 0.0, 1.0);
     if (gl_VertexIndex == ubo.i || gl_VertexIndex == ubo.i + 1 || gl_VertexIndex == ubo.i + 2) {
-        gl_Position = ubo.a * vec4(pos, 0.0, 1.0);
         fragColor = vec3(1, 0, 0);
+    } else if (task < ubo.highlight_count && (highlight.bits[task >> 5] & (1u << (task & 31u))) != 0u) {
+        fragColor = vec3(1, 0.75, 0);
+    } else if (name_index == 0xffffffffu) {
+        // summary row of a collapsed process
+        fragColor = vec3(0.35);
+    } else if (ubo.palette_count == 0u) {
+        fragColor = vec3(0.5);
     } else {
-        gl_Position = ubo.a * vec4(pos, 0.0, 1.0);
-        fragColor = color;
+        uint key = ubo.palette_mode != 0u ? proc : name_index;
+        fragColor = palette.colors[key % ubo.palette_count].rgb;
     }
 }